@@ -20,17 +20,23 @@
 #ifndef KIWIX_BOOK_H
 #define KIWIX_BOOK_H
 
+#include <memory>
 #include <string>
 
 namespace pugi {
 class xml_node;
 }
 
+namespace zim {
+class Archive;
+}
+
 namespace kiwix
 {
 
 class OPDSDumper;
 class Reader;
+class LibrarySnapshot;
 
 /**
  * A class to store information about a book (a zim file)
@@ -43,10 +49,33 @@ class Book
 
   bool update(const Book& other);
   void update(const Reader& reader);
+  void update(const zim::Archive& archive);
   void updateFromXml(const pugi::xml_node& node, const std::string& baseDir);
   void updateFromOpds(const pugi::xml_node& node, const std::string& urlHost);
   std::string getHumanReadableIdFromPath() const;
 
+  /**
+   * Compare the content of two books.
+   *
+   * It can be used to know if a book must be updated. A favicon downloaded
+   * from the favicon url is not part of the content.
+   */
+  bool operator==(const Book& other) const;
+  bool operator!=(const Book& other) const { return !(*this == other); }
+
+  /**
+   * The result of an integrity check of the zim file (see Verifier).
+   *
+   * The result applies to the file as it was when checked (same size and
+   * modification time).
+   */
+  struct Integrity {
+    enum Status { UNKNOWN, VALID, CORRUPTED, NO_CHECKSUM };
+    Status status = UNKNOWN;
+    uint64_t fileSize = 0;
+    int64_t fileMtime = 0;
+  };
+
   bool readOnly() const { return m_readOnly; }
   const std::string& getId() const { return m_id; }
   const std::string& getPath() const { return m_path; }
@@ -72,6 +101,7 @@ class Book
   const std::string& getFaviconUrl() const { return m_faviconUrl; }
   const std::string& getFaviconMimeType() const { return m_faviconMimeType; }
   const std::string& getDownloadId() const { return m_downloadId; }
+  const Integrity& getIntegrity() const { return m_integrity; }
 
   void setReadOnly(bool readOnly) { m_readOnly = readOnly; }
   void setId(const std::string& id) { m_id = id; }
@@ -91,11 +121,15 @@ class Book
   void setArticleCount(uint64_t articleCount) { m_articleCount = articleCount; }
   void setMediaCount(uint64_t mediaCount) { m_mediaCount = mediaCount; }
   void setSize(uint64_t size) { m_size = size; }
-  void setFavicon(const std::string& favicon) { m_favicon = favicon; }
+  void setFavicon(const std::string& favicon);
   void setFaviconMimeType(const std::string& faviconMimeType) { m_faviconMimeType = faviconMimeType; }
   void setDownloadId(const std::string& downloadId) { m_downloadId = downloadId; }
+  void setIntegrity(const Integrity& integrity) { m_integrity = integrity; }
 
  private:
+  friend class Library;
+  friend class LibrarySnapshot;
+
   std::string getCategoryFromTags() const;
 
  protected:
@@ -119,9 +153,12 @@ class Book
   uint64_t m_mediaCount = 0;
   bool m_readOnly = false;
   uint64_t m_size = 0;
-  mutable std::string m_favicon;
+  // Shared between the copies of the book (and the books with the same
+  // favicon when they are in a library).
+  mutable std::shared_ptr<const std::string> m_favicon;
   std::string m_faviconUrl;
   std::string m_faviconMimeType;
+  Integrity m_integrity;
 };
 
 }
@@ -25,11 +25,17 @@
 #include <map>
 #include <memory>
 #include <stdexcept>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
 
 namespace kiwix
 {
 
 class Aria2;
+class Struct;
 struct DownloadedFile {
   DownloadedFile()
    : success(false) {}
@@ -49,6 +55,7 @@ class Download {
 
   Download() :
     m_status(K_UNKNOWN) {}
+  /* A download with an empty did is queued, until aria2 is ready. */
   Download(std::shared_ptr<Aria2> p_aria, std::string did)
     : mp_aria(p_aria),
       m_status(K_UNKNOWN),
@@ -57,14 +64,14 @@ class Download {
   void pauseDownload();
   void resumeDownload();
   void cancelDownload();
-  StatusResult getStatus()          { return m_status; }
-  std::string  getDid()             { return m_did; }
-  std::string  getFollowedBy()      { return m_followedBy; }
-  uint64_t     getTotalLength()     { return m_totalLength; }
-  uint64_t     getCompletedLength() { return m_completedLength; }
-  uint64_t     getDownloadSpeed()   { return m_downloadSpeed; }
-  uint64_t     getVerifiedLength()  { return m_verifiedLength; }
-  std::string  getPath()            { return m_path; }
+  StatusResult getStatus() const          { return m_status; }
+  std::string  getDid() const             { return m_did; }
+  std::string  getFollowedBy() const      { return m_followedBy; }
+  uint64_t     getTotalLength() const     { return m_totalLength; }
+  uint64_t     getCompletedLength() const { return m_completedLength; }
+  uint64_t     getDownloadSpeed() const   { return m_downloadSpeed; }
+  uint64_t     getVerifiedLength() const  { return m_verifiedLength; }
+  std::string  getPath() const            { return m_path; }
   std::vector<std::string>&  getUris()             { return m_uris; }
 
  protected:
@@ -72,35 +79,136 @@ class Download {
   StatusResult m_status;
   std::string m_did = "";
   std::string m_followedBy = "";
-  uint64_t m_totalLength;
-  uint64_t m_completedLength;
-  uint64_t m_downloadSpeed;
-  uint64_t m_verifiedLength;
+  uint64_t m_totalLength = 0;
+  uint64_t m_completedLength = 0;
+  uint64_t m_downloadSpeed = 0;
+  uint64_t m_verifiedLength = 0;
   std::vector<std::string> m_uris;
   std::string m_path;
+
+ private:
+  friend class Downloader;
+
+  /* The gid to read the status from. */
+  const std::string& getStatusGid(bool follow) const;
+  /* Update the download from a status struct of aria2.
+   * Return false if the download is followed by another one, whose status
+   * must be read (only if `follow` is true). */
+  bool updateStatus(const Struct& status, bool follow);
 };
 
 /**
  * A tool to download things.
  *
+ * The downloader doesn't wait for aria2 to start: the known downloads are
+ * read in background once aria2 answers (see getReadyFuture()).
  */
 class Downloader
 {
  public:
   Downloader();
+  /* Use an already started aria2 (the constructor above starts one). */
+  explicit Downloader(std::shared_ptr<Aria2> aria);
   virtual ~Downloader();
 
   void close();
 
+  /**
+   * Start a download.
+   *
+   * If aria2 is not ready yet, the download is queued and started once
+   * aria2 is ready: until then, its did is empty and its status is
+   * K_UNKNOWN. If it cannot be started, its status becomes K_ERROR.
+   */
   Download* startDownload(const std::string& uri, const std::vector<std::pair<std::string, std::string>>& options = {});
   Download* getDownload(const std::string& did);
 
-  size_t getNbDownload() { return m_knownDownloads.size(); }
+  size_t getNbDownload();
   std::vector<std::string> getDownloadIds();
 
+  /**
+   * Update the status of all the known downloads.
+   *
+   * The statuses are read with one request to aria2, whatever the number of
+   * downloads (instead of one request per download with
+   * Download::updateStatus()). Downloads followed by another one (metalinks)
+   * give the status of the download following them. The statuses are read
+   * into copies and applied to the known downloads with the lock of the
+   * downloader taken, as getDownload() does.
+   */
+  void updateDownloads();
+
+  /**
+   * Called by the poller when the status of a download changes.
+   *
+   * @param download The download, with its new status.
+   * @param previousStatus The status of the download before the change.
+   */
+  typedef std::function<void(const Download& download,
+                             Download::StatusResult previousStatus)> StatusCallback;
+
+  /**
+   * Start a thread reading the status of the known downloads periodically.
+   *
+   * The statuses read are given by getDownloadSnapshots(), without any
+   * request to aria2. The poller doesn't modify the downloads given by
+   * startDownload() or getDownload().
+   *
+   * @param intervalMs The time between two reads of the statuses.
+   * @param callback A function called (from the poller thread) each time
+   *                 the status of a download changes. It may be empty.
+   */
+  void startPolling(unsigned int intervalMs, StatusCallback callback = StatusCallback());
+  void stopPolling();
+
+  /**
+   * Get the downloads as read by the last poll (see startPolling()).
+   *
+   * @return A copy of the downloads, by download id.
+   */
+  std::map<std::string, Download> getDownloadSnapshots() const;
+
+  /**
+   * Get a future becoming ready once aria2 answers, the known downloads are
+   * read and the queued downloads are started.
+   *
+   * The future holds an exception if aria2 cannot be reached.
+   */
+  std::shared_future<void> getReadyFuture() const { return m_ready; }
+  bool isReady() const;
+
  private:
+  typedef std::vector<std::pair<std::string, std::string>> Options;
+  struct QueuedDownload {
+    std::unique_ptr<Download> download;
+    Options options;
+  };
+
+  void start();
+  void readKnownDownloads();
+  void poll(unsigned int intervalMs, StatusCallback callback);
+  void updateStatuses(const std::vector<Download*>& downloads);
+
   std::map<std::string, std::unique_ptr<Download>> m_knownDownloads;
   std::shared_ptr<Aria2> mp_aria;
+  std::mutex m_lock;
+
+  // The start, waiting for aria2 in background.
+  std::promise<void> m_readyPromise;
+  std::shared_future<void> m_ready;
+  std::thread m_startThread;
+  bool m_started = false;
+  bool m_closing = false;
+  // The downloads started before aria2 is ready (and, after, the ones which
+  // could not be started).
+  std::vector<QueuedDownload> m_queuedDownloads;
+
+  // The poller
+  std::thread m_pollerThread;
+  bool m_stopPolling = false;
+  std::condition_variable m_pollerCondition;
+  std::map<std::string, Download> m_snapshots;
+  mutable std::mutex m_snapshotsLock;
 };
 }
 
@@ -22,8 +22,11 @@
 
 #include <string>
 #include <vector>
+#include <deque>
+#include <list>
 #include <map>
 #include <memory>
+#include <set>
 #include <zim/archive.h>
 
 #include "book.h"
@@ -37,6 +40,12 @@ namespace kiwix
 
 class OPDSDumper;
 class Library;
+class BookOrdinals;
+class FacetIndex;
+class SortIndex;
+class AttributeCounter;
+class PathIndex;
+class IllustrationStore;
 
 enum supportedListSortBy { UNSORTED, TITLE, SIZE, DATE, CREATOR, PUBLISHER };
 enum supportedListMode {
@@ -135,11 +144,22 @@ class Filter {
 
 private: // functions
     friend class Library;
+    friend class FederatedSearcher;
 
     bool accept(const Book& book) const;
 };
 
 
+/**
+ * An illustration (favicon) of a book.
+ */
+struct Illustration
+{
+  std::string mimeType;
+  // The content of the illustration, or nullptr if there is none.
+  std::shared_ptr<const std::string> data;
+};
+
 /**
  * A Library store several books.
  */
@@ -148,12 +168,43 @@ class Library
   std::map<std::string, kiwix::Book> m_books;
   std::map<std::string, std::shared_ptr<Reader>> m_readers;
   std::map<std::string, std::shared_ptr<zim::Archive>> m_archives;
-  std::vector<kiwix::Bookmark> m_bookmarks;
+  std::list<kiwix::Bookmark> m_bookmarks;
+  // The bookmarks of each book.
+  std::multimap<std::string, std::list<kiwix::Bookmark>::iterator> m_bookmarksByBook;
   class BookDB;
   std::unique_ptr<BookDB> m_bookDB;
+  std::unique_ptr<BookOrdinals> m_bookOrdinals;
+  std::unique_ptr<FacetIndex> m_facetIndex;
+  std::unique_ptr<SortIndex> m_sortIndex;
+  std::unique_ptr<AttributeCounter> m_attributeCounter;
+  std::unique_ptr<PathIndex> m_pathIndex;
+  // The books given by a non const getter. Their path may have changed since
+  // they have been indexed: they are indexed again by the non const
+  // getBookByPath() and touchBook(), never by a const method.
+  std::set<std::string> m_booksToReindex;
+  std::unique_ptr<IllustrationStore> m_illustrationStore;
+  uint64_t m_revision = 0;
+  std::map<std::string, uint64_t> m_bookRevisions;
+  // The revision at which each book has been added.
+  std::map<std::string, uint64_t> m_bookAddRevisions;
+  // The last changes of the library: the revision and the id of the changed
+  // book. All the changes made after m_journalStart are in the journal.
+  std::deque<std::pair<uint64_t, std::string>> m_journal;
+  uint64_t m_journalStart = 0;
 
  public:
   typedef std::vector<std::string> BookIdCollection;
+  typedef std::vector<std::pair<std::string, size_t>> AttributeCounts;
+
+  /**
+   * The books changed by mergeBooks() or since a revision of the library
+   * (see getChangesSince()).
+   */
+  struct Changes {
+    BookIdCollection addedBooks;
+    BookIdCollection updatedBooks;
+    BookIdCollection removedBooks;
+  };
 
  public:
   Library();
@@ -167,18 +218,59 @@ class Library
   void operator=(const Library& ) = delete;
   Library& operator=(Library&& );
 
+  /**
+   * Use a persistent (on disk) database to index the books of the library.
+   *
+   * Indexing the books for the text searches is expensive. If the books
+   * are loaded from the same source at each start, using a persistent
+   * database avoids to index again the books which have not changed.
+   *
+   * It must be called on an empty library, before loading the books. Once
+   * the books are loaded, commitBookDB() must be called.
+   * If the database cannot be opened, an in memory one is used.
+   *
+   * @param path The path of the database directory.
+   * @return True if the database is used.
+   */
+  bool openBookDB(const std::string& path);
+
+  /**
+   * Write the changes of the persistent book database on disk.
+   *
+   * The books of the database which have not been added to the library
+   * since openBookDB() are removed from it.
+   */
+  void commitBookDB();
+
   /**
    * Add a book to the library.
    *
    * If a book already exist in the library with the same id, update
-   * the existing book instead of adding a new one.
+   * the existing book instead of adding a new one. The existing book is
+   * left untouched (and not indexed again) if it has the same content
+   * (see Book::operator==()) or if it is read only.
    *
    * @param book The book to add.
    * @return True if the book has been added.
-   *         False if a book has been updated.
+   *         False if a book has been updated (or left untouched).
    */
   bool addBook(const Book& book);
 
+  /**
+   * Merge a new version of a catalog of books in the library.
+   *
+   * The new books of the catalog are added and the changed ones are updated.
+   * Unchanged books are not touched, so the cost of the merge depends on
+   * the number of changes. The books of the library accepted by `scope`
+   * (the previous version of the catalog) which are not in the catalog
+   * anymore are removed.
+   *
+   * @param books The books of the catalog.
+   * @param scope The filter selecting the books of the catalog in the library.
+   * @return The ids of the added, updated and removed books.
+   */
+  Changes mergeBooks(const std::vector<Book>& books, const Filter& scope);
+
   /**
    * Add a bookmark to the library.
    *
@@ -195,13 +287,99 @@ class Library
    */
   bool removeBookmark(const std::string& zimId, const std::string& url);
 
+  /**
+   * Get a book of the library.
+   *
+   * The non const versions give a modifiable book. Once the book is
+   * modified, touchBook() must be called to index it again and change its
+   * revision. Getting a book doesn't change it, so read only callers should
+   * use the const versions anyway: they don't modify the library and can be
+   * called from several threads at the same time.
+   *
+   * Paths are compared once made absolute and normalized. If several books
+   * have the same path, the one with the smallest id is returned.
+   */
   const Book& getBookById(const std::string& id) const;
   Book& getBookById(const std::string& id);
   const Book& getBookByPath(const std::string& path) const;
   Book& getBookByPath(const std::string& path);
+
+  /**
+   * Record that a book has been modified (through a non const getter).
+   *
+   * The book is indexed again and its revision changes.
+   *
+   * @param id The id of the book.
+   * @throw std::out_of_range if no book has this id.
+   */
+  void touchBook(const std::string& id);
+
+  /**
+   * Get the revision of a book.
+   *
+   * The revision changes each time the book is modified: when it is added
+   * (or updated) with addBook() or touched with touchBook(). Two versions of the books of a library never share the same
+   * revision, so it can be used to cache data computed from a book.
+   *
+   * @param id The id of the book.
+   * @return The revision of the book.
+   * @throw std::out_of_range if no book has this id.
+   */
+  uint64_t getBookRevision(const std::string& id) const;
+
+  /**
+   * Get the revision of the library.
+   *
+   * The revision changes each time a book is added, updated (see
+   * getBookRevision()) or removed. Revisions start from the creation time
+   * of the library, so the revisions of a library are greater than the ones
+   * of a library created before (for instance before a restart).
+   */
+  uint64_t getRevision() const { return m_revision; }
+
+  /**
+   * Get the books changed since a revision of the library.
+   *
+   * Only the last changes are kept. A book added and removed since
+   * `revision` may be reported as removed. The revision 0 stands for an
+   * empty library: all the books are reported as added.
+   *
+   * @param revision A revision of the library, as given by getRevision().
+   * @return The ids of the added, updated and removed books.
+   * @throw std::out_of_range if the changes since `revision` are not known.
+   */
+  Changes getChangesSince(uint64_t revision) const;
+
+  /**
+   * Get the changes since a revision of the books accepted by a filter.
+   *
+   * The changed books which are not accepted by `filter` (anymore) are
+   * reported as removed, even if they were not accepted before either. The
+   * revision 0 reports the books accepted by `filter` as added.
+   *
+   * @param revision A revision of the library, as given by getRevision().
+   * @param filter The filter selecting the books.
+   * @return The ids of the added, updated and removed books.
+   * @throw std::out_of_range if the changes since `revision` are not known.
+   */
+  Changes getChangesSince(uint64_t revision, const Filter& filter) const;
   std::shared_ptr<Reader> getReaderById(const std::string& id);
   std::shared_ptr<zim::Archive> getArchiveById(const std::string& id);
 
+  /**
+   * Get the illustration (favicon) of a book.
+   *
+   * The illustration stored in the book (coming from the library file) is
+   * used if any. Else it is read from the zim file of the book, and kept in
+   * a size bounded cache. Identical illustrations are stored only once.
+   * A favicon url of the book is never downloaded.
+   *
+   * @param id The id of the book.
+   * @return The illustration of the book (with no data if there is none).
+   * @throw std::out_of_range if no book has this id.
+   */
+  Illustration getBookIllustration(const std::string& id);
+
   /**
    * Remove a book from the library.
    *
@@ -218,6 +396,24 @@ class Library
    */
   bool writeToFile(const std::string& path) const;
 
+  /**
+   * Append books of the library to a library file.
+   *
+   * This avoids to rewrite a whole (big) library file to save a few new or
+   * updated books: when the file is read (not as read only), the last entry
+   * of a book updates the previous ones. Removed books need a full
+   * writeToFile().
+   *
+   * Unlike writeToFile(), the file is modified in place.
+   *
+   * @param path the path of a library file written by writeToFile().
+   * @param bookIds the ids of the books to append.
+   * @return True if the books have been appended. False if the file doesn't
+   *         exist or doesn't end with the end tag of a library node (as an
+   *         empty library file).
+   */
+  bool appendBooksToFile(const std::string& path, const BookIdCollection& bookIds) const;
+
   /**
    * Write the library bookmarks to a file.
    *
@@ -226,6 +422,30 @@ class Library
    */
   bool writeBookmarksToFile(const std::string& path) const;
 
+  /**
+   * Write the books of the library to a binary snapshot file.
+   *
+   * A snapshot is a cache of the library, much faster to load than the
+   * library xml file. Its format is specific to this version of kiwix-lib,
+   * use writeToFile() to exchange libraries.
+   *
+   * @param path the path of the file to write to.
+   * @return True if the snapshot has been correctly saved.
+   */
+  bool writeSnapshot(const std::string& path) const;
+
+  /**
+   * Add the books of a snapshot written by writeSnapshot() to the library.
+   *
+   * With a book database (see openBookDB()), the books indexed in the
+   * database are not indexed again: only the in-memory indexes are built.
+   *
+   * @param path the path of the snapshot file.
+   * @return True if the books have been added. False if the file doesn't
+   *         exist or is not a valid snapshot (no book is added then).
+   */
+  bool readSnapshot(const std::string& path);
+
   /**
    * Get the number of book in the library.
    *
@@ -238,28 +458,44 @@ class Library
   /**
    * Get all languagues of the books in the library.
    *
-   * @return A list of languages.
+   * @return A (sorted) list of languages.
    */
   std::vector<std::string> getBooksLanguages() const;
 
+  /**
+   * Get all languagues of the books in the library with the number of
+   * books in each language.
+   *
+   * @return A (sorted) list of languages with the associated book count.
+   */
+  AttributeCounts getBooksLanguagesWithCounts() const;
+
   /**
    * Get all categories of the books in the library.
    *
-   * @return A list of categories.
+   * @return A (sorted) list of categories.
    */
   std::vector<std::string> getBooksCategories() const;
 
+  /**
+   * Get all categories of the books in the library with the number of
+   * books in each category.
+   *
+   * @return A (sorted) list of categories with the associated book count.
+   */
+  AttributeCounts getBooksCategoriesWithCounts() const;
+
   /**
    * Get all book creators of the books in the library.
    *
-   * @return A list of book creators.
+   * @return A (sorted) list of book creators.
    */
   std::vector<std::string> getBooksCreators() const;
 
   /**
    * Get all book publishers of the books in the library.
    *
-   * @return A list of book publishers.
+   * @return A (sorted) list of book publishers.
    */
   std::vector<std::string> getBooksPublishers() const;
 
@@ -296,10 +532,39 @@ class Library
    */
   BookIdCollection filter(const Filter& filter) const;
 
+  /**
+   * Filter and sort the library, and return a range of the results.
+   *
+   * The returned range is the same as the one extracted from
+   * `filter(filter)` sorted with `sort(..., sortBy, ascending)`, but the
+   * ids of the books outside of the range are never generated.
+   *
+   * @param filter The filter to use.
+   * @param sortBy Attribute to sort the results by (UNSORTED to keep
+   *               the order of `filter(filter)`).
+   * @param ascending The sort direction.
+   * @param start Index of the first result to return.
+   * @param count Maximum number of results to return.
+   * @param[out] totalCount The number of books matching the filter.
+   * @return The list of bookIds in the requested range.
+   */
+  BookIdCollection filter(const Filter& filter,
+                          supportedListSortBy sortBy,
+                          bool ascending,
+                          size_t start,
+                          size_t count,
+                          size_t& totalCount) const;
+
 
   /**
    * Sort (in place) bookIds using the given comparator.
    *
+   * Titles are compared using the (root locale) collation order.
+   * The order of the books with the same sort key is not specified. It is
+   * the same for every sort while the books are not changed (and the same
+   * as the one of `filter(filter, sortBy, ...)`), and a descending sort
+   * gives the reverse of an ascending one.
+   *
    * @param bookIds the list of book Ids to sort
    * @param comparator how to sort the books
    * @return The sorted list of books
@@ -342,8 +607,10 @@ class Library
   friend class libXMLDumper;
 
 private: // functions
-  BookIdCollection filterViaBookDB(const Filter& filter) const;
-  void updateBookDB(const Book& book);
+  void updateBookIndexes(const Book& book);
+  void updatePathIndex();
+  void recordChange(const std::string& id);
+  void updateBookDB(const Book& book, uint32_t ordinal);
 };
 
 }
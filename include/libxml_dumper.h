@@ -49,6 +49,28 @@ class LibXMLDumper
    */
   std::string dumpLibXMLContent(const std::vector<std::string>& bookIds);
 
+  /**
+   * Dump the library.xml to a writer.
+   *
+   * The books are written one by one, the whole document is never built
+   * in memory.
+   *
+   * @param bookIds The ids of the books to dump.
+   * @param writer The writer to write the library.xml content to.
+   */
+  void dumpLibXMLContent(const std::vector<std::string>& bookIds, pugi::xml_writer& writer);
+
+  /**
+   * Dump the book entries of the library.xml to a writer.
+   *
+   * Only the `book` nodes are written, not the enclosing `library` node.
+   *
+   * @param bookIds The ids of the books to dump.
+   * @param writer The writer to write the entries to.
+   * @return The number of written entries (read only books are not dumped).
+   */
+  size_t dumpLibXMLBooks(const std::vector<std::string>& bookIds, pugi::xml_writer& writer);
+
 
   /**
    * Dump the bookmark of the library.
@@ -75,7 +97,8 @@ class LibXMLDumper
   const kiwix::Library* library;
   std::string baseDir;
  private:
-  void handleBook(Book book, pugi::xml_node root_node);
+  void handleBook(const Book& book, pugi::xml_node root_node);
+  bool writeBook(const Book& book, pugi::xml_writer& writer);
   void handleBookmark(Bookmark bookmark, pugi::xml_node root_node);
 };
 }
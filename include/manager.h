@@ -24,11 +24,13 @@
 #include "library.h"
 #include "reader.h"
 
+#include <memory>
 #include <string>
 #include <vector>
 
 namespace pugi {
 class xml_document;
+class xml_node;
 }
 
 namespace kiwix
@@ -38,7 +40,16 @@ class LibraryManipulator {
  public:
   virtual ~LibraryManipulator() {}
   virtual bool addBookToLibrary(Book book) = 0;
+  // Not pure, to not break the existing manipulators: the books are added
+  // one by one. Used by the readers of streams to give their books at once.
+  virtual void addBooksToLibrary(const std::vector<Book>& books) {
+    for (const auto& book : books) {
+      addBookToLibrary(book);
+    }
+  }
   virtual void addBookmarkToLibrary(Bookmark bookmark) = 0;
+  // Not pure, to not break the existing manipulators which can't remove books.
+  virtual bool removeBookFromLibrary(const std::string& bookId) { return false; }
 };
 
 class DefaultLibraryManipulator : public LibraryManipulator {
@@ -52,6 +63,9 @@ class DefaultLibraryManipulator : public LibraryManipulator {
   void addBookmarkToLibrary(Bookmark bookmark) {
     library->addBookmark(bookmark);
   }
+  bool removeBookFromLibrary(const std::string& bookId) {
+    return library->removeBookById(bookId);
+  }
  private:
    kiwix::Library* library;
 };
@@ -65,6 +79,9 @@ class Manager
   Manager(LibraryManipulator* manipulator);
   Manager(Library* library);
   ~Manager();
+  // The manipulator owned by the moved manager is transferred.
+  Manager(Manager&& other);
+  Manager& operator=(Manager&& other);
 
   /**
    * Read a `library.xml` and add book in the file to the library.
@@ -101,6 +118,56 @@ class Manager
    */
   bool readOpds(const std::string& content, const std::string& urlHost);
 
+  /**
+   * Load a library content stored in a OPDS stream, given by chunks.
+   *
+   * The stream may be cut anywhere. The books are given to the library by
+   * batches (see LibraryManipulator::addBooksToLibrary()) as soon as their
+   * entries are complete, and only the incomplete entry is kept in memory.
+   * So the memory used doesn't depend on the size of the stream, and the
+   * stream can be read while it is downloaded.
+   * Once the whole stream is read, endOpdsStream() must be called.
+   *
+   * @param chunk The next part of the OPDS stream.
+   * @param urlHost The url of the server of the stream (used to resolve the
+   *                relative urls). Only the value of the first chunk is used.
+   * @return False if an entry of the stream cannot be parsed (the entry is
+   *         skipped).
+   */
+  bool readOpdsChunk(const std::string& chunk, const std::string& urlHost);
+
+  /**
+   * End the reading of the OPDS stream started by readOpdsChunk().
+   *
+   * @return True if the whole stream has been properly parsed.
+   */
+  bool endOpdsStream();
+
+  /**
+   * Apply the changes of a catalog given by a `/catalog/v2/changes` feed.
+   *
+   * The books of the feed are added (or updated) and the removed books are
+   * removed from the library. The revision of the catalog given by the feed
+   * is stored in `m_catalogRevision`, to ask for the next changes with
+   * `/catalog/v2/changes?since=<m_catalogRevision>`.
+   * If the server answers with a 410 (Gone) status, the changes since
+   * `m_catalogRevision` are not known anymore: the whole catalog must be
+   * read again with `/catalog/v2/changes?since=0`.
+   *
+   * The feed is paged as `/catalog/v2/entries` (`start` and `count`
+   * arguments). The paging information is stored in `m_totalBooks`,
+   * `m_startIndex` and `m_itemsPerPage`, and the revision is only stored
+   * from the first page: the next pages must be asked with the same
+   * `since`. The changes made while reading the pages are read again by
+   * the next call.
+   *
+   * @param content The content of the feed.
+   * @param urlHost The url of the server of the feed (used to resolve the
+   *                relative urls).
+   * @return True if the content has been properly parsed.
+   */
+  bool readOpdsChanges(const std::string& content, const std::string& urlHost);
+
 
   /**
    * Load a bookmark file.
@@ -148,19 +215,27 @@ class Manager
   uint64_t m_totalBooks = 0;
   uint64_t m_startIndex = 0;
   uint64_t m_itemsPerPage = 0;
+  uint64_t m_catalogRevision = 0;
 
  protected:
   kiwix::LibraryManipulator* manipulator;
   bool mustDeleteManipulator;
 
   bool readBookFromPath(const std::string& path, Book* book);
+  void readBooksFromPaths(std::vector<Book>& books);
   bool parseXmlDom(const pugi::xml_document& doc,
                    bool readOnly,
                    const std::string& libraryPath,
                    bool trustLibrary);
   bool parseOpdsDom(const pugi::xml_document& doc,
                     const std::string& urlHost);
+  void parseOpdsFeedNode(const pugi::xml_node& feedNode);
+  void addBookFromOpdsEntry(const pugi::xml_node& entryNode,
+                            const std::string& urlHost);
 
+ private:
+  class OpdsStream;
+  std::unique_ptr<OpdsStream> m_opdsStream;
 };
 }
 
@@ -34,6 +34,8 @@ using namespace std;
 namespace kiwix
 {
 
+class OPDSEntryCache;
+
 /**
  * A tool to dump a `Library` into a opds stream.
  *
@@ -63,13 +65,36 @@ class OPDSDumper
    */
   std::string dumpOPDSFeedV2(const std::vector<std::string>& bookIds, const std::string& query) const;
 
+  /**
+   * Dump the OPDS feed of the changes of the library.
+   *
+   * The added and updated books are given as entries and the removed ones
+   * as deleted entries (RFC 6721). The feed also gives the revision of the
+   * library to ask the next changes from, and the paging information set
+   * with setOpenSearchInfo().
+   *
+   * @param changes the changes of the library since `since` (of the page)
+   * @param since the revision of the library the changes start from
+   * @param revision the current revision of the library
+   * @return The OPDS feed.
+   */
+  std::string dumpOPDSChangesFeed(const Library::Changes& changes, uint64_t since, uint64_t revision) const;
+
   /**
    * Dump the categories OPDS feed.
    *
-   * @param categories list of category names
+   * @param categories list of category names with their book count
+   * @return The OPDS feed.
+   */
+  std::string categoriesOPDSFeed(const Library::AttributeCounts& categories) const;
+
+  /**
+   * Dump the languages OPDS feed.
+   *
+   * @param languages list of languages (iso639-3 codes) with their book count
    * @return The OPDS feed.
    */
-  std::string categoriesOPDSFeed(const std::vector<std::string>& categories) const;
+  std::string languagesOPDSFeed(const Library::AttributeCounts& languages) const;
 
   /**
    * Set the id of the library.
@@ -94,6 +119,13 @@ class OPDSDumper
    */
   void setOpenSearchInfo(int totalResult, int startIndex, int count);
 
+  /**
+   * Set a cache of the book entries to use (and fill) for the feeds.
+   *
+   * @param cache the cache to use (must outlive the dumper).
+   */
+  void setEntryCache(OPDSEntryCache* cache) { m_entryCache = cache; }
+
  protected:
   kiwix::Library* library;
   std::string libraryId;
@@ -101,6 +133,7 @@ class OPDSDumper
   int m_totalResults;
   int m_startIndex;
   int m_count;
+  OPDSEntryCache* m_entryCache = nullptr;
 };
 }
 
@@ -25,6 +25,7 @@
 #include <zim/archive.h>
 #include <exception>
 #include <map>
+#include <memory>
 #include <sstream>
 #include <string>
 #include "common.h"
@@ -500,7 +501,11 @@ class Reader
   SuggestionsList_t::iterator suggestionsOffset;
 
  private:
-  std::map<const std::string, unsigned int> parseCounterMetadata() const;
+  /* The metadata of the archive, read once (on first use) and shared by the
+   * copies of the reader. */
+  struct Metadata;
+  std::shared_ptr<Metadata> mp_metadata;
+  const Metadata& getCachedMetadata() const;
 };
 }
 
@@ -21,6 +21,7 @@
 #define KIWIX_SEARCH_RENDERER_H
 
 #include <string>
+#include <vector>
 #include <zim/search.h>
 
 namespace kiwix
@@ -34,6 +35,19 @@ class NameMapper;
 class SearchRenderer
 {
  public:
+  /**
+   * A result of a search.
+   */
+  struct Result {
+    std::string title;
+    std::string path;
+    std::string snippet;
+    // The id of the book (the uuid of its zim file).
+    std::string bookId;
+    // -1 if unknown.
+    int wordCount = -1;
+  };
+
   /**
    * The default constructor.
    *
@@ -43,6 +57,8 @@ class SearchRenderer
   SearchRenderer(Searcher* searcher, NameMapper* mapper);
   SearchRenderer(zim::SearchResultSet srs, NameMapper* mapper,
                  unsigned int start, unsigned int estimatedResultCount);
+  SearchRenderer(std::vector<Result> results, NameMapper* mapper,
+                 unsigned int start, unsigned int estimatedResultCount);
 
   ~SearchRenderer();
 
@@ -77,7 +93,7 @@ class SearchRenderer
 
  protected:
   std::string beautifyInteger(const unsigned int number);
-  zim::SearchResultSet m_srs;
+  std::vector<Result> m_results;
   NameMapper* mp_nameMapper;
   std::string searchContent;
   std::string searchPattern;
@@ -0,0 +1,153 @@
+/*
+ * Copyright 2021 Kiwix <contact@kiwix.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU  General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef KIWIX_VERIFIER_H
+#define KIWIX_VERIFIER_H
+
+#include "book.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace kiwix
+{
+
+/**
+ * A service checking the integrity (the checksum) of zim files in background.
+ *
+ * Files are checked in the order they are queued, by a pool of worker
+ * threads. The results are kept for each file, with the size and the
+ * modification time of the file they apply to, so a file is read again only
+ * if it changes.
+ */
+class Verifier
+{
+ public:
+  struct Progress {
+    std::string path;
+    uint64_t bytesRead = 0;
+    uint64_t bytesTotal = 0;
+    /* The check is done (or cancelled). */
+    bool finished = false;
+    /* The result, once finished (UNKNOWN if the check is cancelled or the
+     * file cannot be read). */
+    Book::Integrity integrity;
+  };
+
+  /**
+   * Called (from a worker thread) as the file is read, and when the check is
+   * finished.
+   */
+  typedef std::function<void(const Progress& progress)> Callback;
+
+  /**
+   * @param workerCount The number of files checked in parallel.
+   */
+  explicit Verifier(unsigned int workerCount = 1);
+  /* Cancel the queued and running checks, without calling their callbacks
+   * anymore. */
+  ~Verifier();
+  Verifier(const Verifier&) = delete;
+  Verifier& operator=(const Verifier&) = delete;
+
+  /**
+   * Limit the read bandwidth (shared by all the workers).
+   *
+   * @param bytesPerSecond The limit, 0 (the default) for no limit.
+   */
+  void setMaxBytesPerSecond(uint64_t bytesPerSecond);
+
+  /**
+   * Queue the check of a zim file (or of a split zim file).
+   *
+   * If the result for the file (as it is now) is already known, the file is
+   * not read and the callback is called immediately (from the calling
+   * thread). If the file is already queued, the callback is added to the
+   * ones of the pending check.
+   */
+  void verify(const std::string& path, Callback callback = Callback());
+
+  /**
+   * Queue the check of the zim file of a book.
+   *
+   * As verify(path), using the integrity of the book as a known result.
+   */
+  void verify(const Book& book, Callback callback = Callback());
+
+  /* Cancel the check of a file, if queued or running. */
+  void cancel(const std::string& path);
+
+  /**
+   * Get the result of the check of a file.
+   *
+   * @return The known result for the file as it is now, or a result with a
+   *         UNKNOWN status if the file was not checked (or was modified).
+   */
+  Book::Integrity getIntegrity(const std::string& path) const;
+
+  /**
+   * Update the integrity of a book with the known result for its file.
+   *
+   * @return True if the integrity of the book was changed.
+   */
+  bool updateIntegrity(Book& book) const;
+
+  /* Wait until all the queued checks are done (and their callbacks called). */
+  void wait();
+
+ private:
+  void work();
+  Book::Integrity check(const std::string& path);
+  void report(const Progress& progress);
+  /* Wait before reading `size` bytes of `path`, to respect the bandwidth
+   * limit. Return false if the check of `path` is cancelled. */
+  bool throttle(const std::string& path, size_t size);
+  /* The known result for the file as it is now, if any. Takes the lock,
+   * but not while the file is looked for. */
+  bool findResult(const std::string& path, Book::Integrity* integrity) const;
+
+  mutable std::mutex m_lock;
+  std::condition_variable m_workCondition;
+  std::condition_variable m_doneCondition;
+  std::vector<std::thread> m_workers;
+  bool m_stopping = false;
+
+  std::deque<std::string> m_queue;
+  // The callbacks of the queued and running checks.
+  std::map<std::string, std::vector<Callback>> m_callbacks;
+  std::set<std::string> m_cancelled;
+  // The number of finished checks whose callbacks are being called.
+  unsigned int m_finishingCount = 0;
+  std::map<std::string, Book::Integrity> m_results;
+
+  uint64_t m_maxBytesPerSecond = 0;
+  std::chrono::steady_clock::time_point m_nextReadTime;
+};
+
+}
+
+#endif // KIWIX_VERIFIER_H
@@ -2,6 +2,7 @@
 
 #include "aria2.h"
 #include "xmlrpc.h"
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <thread>
@@ -27,12 +28,28 @@
 
 namespace kiwix {
 
+namespace {
+
+// The delay before trying to reach the rpc server, doubled after each try.
+const std::chrono::milliseconds CONNECT_FIRST_DELAY(10);
+const std::chrono::milliseconds CONNECT_MAX_DELAY(500);
+const std::chrono::milliseconds CONNECT_TIMEOUT(10000);
+
+size_t discard_callback(char* /*ptr*/, size_t size, size_t nmemb, void* /*userdata*/)
+{
+  return size * nmemb;
+}
+
+} // unnamed namespace
+
 Aria2::Aria2():
   mp_aria(nullptr),
   m_port(42042),
   m_secret("kiwixariarpc"),
   m_curlErrorBuffer(new char[CURL_ERROR_SIZE]),
-  mp_curl(nullptr)
+  mp_curl(nullptr),
+  m_ready(m_readyPromise.get_future().share()),
+  m_stopConnecting(false)
 {
   m_downloadDir = getDataDirectory();
   makeDirectory(m_downloadDir);
@@ -89,32 +106,89 @@ Aria2::Aria2():
       launchCmd.append(cmd).append(" ");
   }
   mp_aria = Subprocess::run(callCmd);
+  connect(launchCmd);
+}
+
+Aria2::Aria2(int port, const std::string& secret):
+  mp_aria(nullptr),
+  m_port(port),
+  m_secret("token:" + secret),
+  m_curlErrorBuffer(new char[CURL_ERROR_SIZE]),
+  mp_curl(nullptr),
+  m_ready(m_readyPromise.get_future().share()),
+  m_stopConnecting(false)
+{
+  m_downloadDir = getDataDirectory();
+  connect("");
+}
+
+void Aria2::connect(const std::string& launchCmd)
+{
   mp_curl = curl_easy_init();
 
   curl_easy_setopt(mp_curl, CURLOPT_URL, "http://localhost/rpc");
   curl_easy_setopt(mp_curl, CURLOPT_PORT, m_port);
   curl_easy_setopt(mp_curl, CURLOPT_POST, 1L);
+  curl_easy_setopt(mp_curl, CURLOPT_POSTFIELDS, "");
+  curl_easy_setopt(mp_curl, CURLOPT_WRITEFUNCTION, &discard_callback);
   curl_easy_setopt(mp_curl, CURLOPT_ERRORBUFFER, m_curlErrorBuffer.get());
 
-  int watchdog = 50;
-  while(--watchdog) {
-    sleep(10);
+  m_connectThread = std::thread(&Aria2::waitConnection, this, launchCmd);
+}
+
+/* Try to reach the rpc server, with an exponential backoff, until it answers
+ * or CONNECT_TIMEOUT is reached. */
+void Aria2::waitConnection(const std::string& launchCmd)
+{
+  const auto deadline = std::chrono::steady_clock::now() + CONNECT_TIMEOUT;
+  auto delay = CONNECT_FIRST_DELAY;
+  std::unique_lock<std::mutex> lock(m_lock);
+  while (true) {
+    m_connectCondition.wait_for(lock, delay, [this]() { return m_stopConnecting; });
+    if (m_stopConnecting) {
+      m_readyPromise.set_exception(std::make_exception_ptr(
+        std::runtime_error("Connection to aria2c rpc cancelled")));
+      return;
+    }
     m_curlErrorBuffer[0] = 0;
     auto res = curl_easy_perform(mp_curl);
     if (res == CURLE_OK) {
-      break;
-    } else if (watchdog == 1) {
+      m_readyPromise.set_value();
+      return;
+    }
+    if (std::chrono::steady_clock::now() >= deadline) {
       LOG_ARIA_ERROR();
+      m_readyPromise.set_exception(std::make_exception_ptr(
+        std::runtime_error("Cannot connect to aria2c rpc. Aria2c launch cmd : " + launchCmd)));
+      return;
     }
+    delay = std::min(delay * 2, CONNECT_MAX_DELAY);
+  }
+}
+
+bool Aria2::isReady() const
+{
+  if (m_ready.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+    return false;
   }
-  if (!watchdog) {
-    curl_easy_cleanup(mp_curl);
-    throw std::runtime_error("Cannot connect to aria2c rpc. Aria2c launch cmd : " + launchCmd);
+  try {
+    m_ready.get();
+    return true;
+  } catch (std::exception& e) {
+    return false;
   }
 }
 
 Aria2::~Aria2()
 {
+  {
+    std::unique_lock<std::mutex> lock(m_lock);
+    m_stopConnecting = true;
+  }
+  m_connectCondition.notify_all();
+  if (m_connectThread.joinable()) {
+    m_connectThread.join();
+  }
   std::unique_lock<std::mutex> lock(m_lock);
   curl_easy_cleanup(mp_curl);
 }
@@ -134,6 +208,8 @@ size_t write_callback_to_iss(char* ptr, size_t size, size_t nmemb, void* userdat
 
 std::string Aria2::doRequest(const MethodCall& methodCall)
 {
+  // Throw if the rpc server cannot be reached.
+  m_ready.get();
   auto requestContent = methodCall.toString();
   std::stringstream outStream;
   CURLcode res;
@@ -195,44 +271,67 @@ std::string Aria2::tellStatus(const std::string& gid, const std::vector<std::str
   return doRequest(methodCall);
 }
 
-std::vector<std::string> Aria2::tellActive()
+std::string Aria2::tellStatuses(const std::vector<std::string>& gids, const std::vector<std::string>& statusKey)
 {
-  MethodCall methodCall("aria2.tellActive", m_secret);
+  MethodCall methodCall("system.multicall", "");
+  auto calls = methodCall.newParamValue().getArray();
+  for (auto& gid : gids) {
+    auto call = calls.addValue().getStruct();
+    call.addMember("methodName").getValue().set(std::string("aria2.tellStatus"));
+    auto params = call.addMember("params").getValue().getArray();
+    params.addValue().set(m_secret);
+    params.addValue().set(gid);
+    if (!statusKey.empty()) {
+      auto statusArray = params.addValue().getArray();
+      for (auto& key : statusKey) {
+        statusArray.addValue().set(key);
+      }
+    }
+  }
+  return doRequest(methodCall);
+}
+
+/* The gids returned by `method` (tellActive, or tellWaiting if offset >= 0). */
+std::vector<std::string> Aria2::tellGids(const std::string& method, int offset, int num)
+{
+  MethodCall methodCall(method, m_secret);
+  if (offset >= 0) {
+    methodCall.newParamValue().set(offset);
+    methodCall.newParamValue().set(num);
+  }
   auto statusArray = methodCall.newParamValue().getArray();
   statusArray.addValue().set(std::string("gid"));
   auto responseContent = doRequest(methodCall);
   MethodResponse response(responseContent);
-  std::vector<std::string> activeGID;
+  std::vector<std::string> gids;
   int index = 0;
   while(true) {
     try {
       auto structNode = response.getParamValue(0).getArray().getValue(index++).getStruct();
       auto gidNode = structNode.getMember("gid");
-      activeGID.push_back(gidNode.getValue().getAsS());
+      gids.push_back(gidNode.getValue().getAsS());
     } catch (InvalidRPCNode& e) { break; }
   }
-  return activeGID;
+  return gids;
+}
+
+std::vector<std::string> Aria2::tellActive()
+{
+  return tellGids("aria2.tellActive");
 }
 
 std::vector<std::string> Aria2::tellWaiting()
 {
-  MethodCall methodCall("aria2.tellWaiting", m_secret);
-  methodCall.newParamValue().set(0);
-  methodCall.newParamValue().set(99); // max number of downloads to be returned, don't know how to set this properly assumed that there will not be more than 99 paused downloads.
-  auto statusArray = methodCall.newParamValue().getArray();
-  statusArray.addValue().set(std::string("gid"));
-  auto responseContent = doRequest(methodCall);
-  MethodResponse response(responseContent);
+  // Read the waiting downloads by pages, until a page is not full.
+  const int pageSize = 100;
   std::vector<std::string> waitingGID;
-  int index = 0;
-  while(true) {
-    try {
-      auto structNode = response.getParamValue(0).getArray().getValue(index++).getStruct();
-      auto gidNode = structNode.getMember("gid");
-      waitingGID.push_back(gidNode.getValue().getAsS());
-    } catch (InvalidRPCNode& e) { break; }
+  while (true) {
+    const auto page = tellGids("aria2.tellWaiting", waitingGID.size(), pageSize);
+    waitingGID.insert(waitingGID.end(), page.begin(), page.end());
+    if (page.size() < pageSize) {
+      return waitingGID;
+    }
   }
-  return waitingGID;
 }
 
 void Aria2::saveSession()
@@ -11,8 +11,11 @@
 #include "subprocess.h"
 #include "xmlrpc.h"
 
+#include <condition_variable>
+#include <future>
 #include <memory>
 #include <mutex>
+#include <thread>
 #include <curl/curl.h>
 
 namespace kiwix {
@@ -28,15 +31,38 @@ class Aria2
     CURL* mp_curl;
     std::mutex m_lock;
 
+    // The connection to the rpc server, made in background.
+    std::promise<void> m_readyPromise;
+    std::shared_future<void> m_ready;
+    std::thread m_connectThread;
+    bool m_stopConnecting;
+    std::condition_variable m_connectCondition;
+
     std::string doRequest(const MethodCall& methodCall);
+    void connect(const std::string& launchCmd);
+    void waitConnection(const std::string& launchCmd);
+    std::vector<std::string> tellGids(const std::string& method, int offset = -1, int num = 0);
 
   public:
     Aria2();
+    /* Use the aria2 rpc server already listening on `port` (on localhost). */
+    Aria2(int port, const std::string& secret);
     virtual ~Aria2();
     void close();
 
+    /* The constructors don't wait for the rpc server to answer: the
+     * returned future becomes ready once it does, or holds an exception if
+     * it doesn't answer in time. Requests made before wait for it (and throw
+     * the exception of the future if the connection failed). */
+    std::shared_future<void> getReadyFuture() const { return m_ready; }
+    bool isReady() const;
+
     std::string addUri(const std::vector<std::string>& uri, const std::vector<std::pair<std::string, std::string>>& options = {});
     std::string tellStatus(const std::string& gid, const std::vector<std::string>& statusKey);
+    /* The status of several downloads, with one request (system.multicall).
+     * The n-th value of the response is an array containing the status of
+     * the n-th gid, or a fault struct if its status cannot be read. */
+    std::string tellStatuses(const std::vector<std::string>& gids, const std::vector<std::string>& statusKey);
     std::vector<std::string> tellActive();
     std::vector<std::string> tellWaiting();
     void saveSession();
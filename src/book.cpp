@@ -27,6 +27,7 @@
 #include "tools/otherTools.h"
 #include "tools/stringTools.h"
 #include "tools/pathTools.h"
+#include "tools/archiveTools.h"
 
 #include <pugixml.hpp>
 
@@ -74,32 +75,43 @@ bool Book::update(const kiwix::Book& other)
   m_faviconUrl = other.m_faviconUrl;
 
   m_downloadId = other.m_downloadId;
+  m_integrity = other.m_integrity;
 
   return true;
 }
 
 void Book::update(const kiwix::Reader& reader)
 {
+  update(*reader.getZimArchive());
   m_path = reader.getZimFilePath();
-  m_pathValid = true;
-  m_id = reader.getId();
-  m_title = reader.getTitle();
-  m_description = reader.getDescription();
-  m_language = reader.getLanguage();
-  m_creator = reader.getCreator();
-  m_publisher = reader.getPublisher();
-  m_date = reader.getDate();
-  m_name = reader.getName();
-  m_flavour = reader.getFlavour();
-  m_tags = reader.getTags();
+}
+
+/* Same as update(const Reader&), without the Reader. The path of the book is
+ * not changed. */
+void Book::update(const zim::Archive& archive)
+{
+  std::ostringstream id;
+  id << archive.getUuid();
+  m_id = id.str();
+  m_title = getArchiveTitle(archive);
+  m_description = getMetaDescription(archive);
+  m_language = getMetaLanguage(archive);
+  m_creator = getMetaCreator(archive);
+  m_publisher = getMetaPublisher(archive);
+  m_date = getMetaDate(archive);
+  m_name = getMetaName(archive);
+  m_flavour = getMetaFlavour(archive);
+  m_tags = getMetaTags(archive);
   m_category = getCategoryFromTags();
-  m_origId = reader.getOrigId();
-  m_articleCount = reader.getArticleCount();
-  m_mediaCount = reader.getMediaCount();
-  m_size = static_cast<uint64_t>(reader.getFileSize()) << 10;
+  m_origId = getArchiveOrigId(archive);
+
+  countArticlesAndMedias(getMetadata(archive, "Counter"), m_articleCount, m_mediaCount);
+  m_size = static_cast<uint64_t>(archive.getFilesize() / 1024) << 10;
   m_pathValid = true;
 
-  reader.getFavicon(m_favicon, m_faviconMimeType);
+  std::string favicon;
+  getArchiveFavicon(archive, favicon, m_faviconMimeType);
+  setFavicon(favicon);
 }
 
 #define ATTR(name) node.attribute(name).value()
@@ -126,7 +138,7 @@ void Book::updateFromXml(const pugi::xml_node& node, const std::string& baseDir)
   m_articleCount = strtoull(ATTR("articleCount"), 0, 0);
   m_mediaCount = strtoull(ATTR("mediaCount"), 0, 0);
   m_size = strtoull(ATTR("size"), 0, 0) << 10;
-  m_favicon = base64_decode(ATTR("favicon"));
+  setFavicon(base64_decode(ATTR("favicon")));
   m_faviconMimeType = ATTR("faviconMimeType");
   m_faviconUrl = ATTR("faviconUrl");
   try {
@@ -134,6 +146,13 @@ void Book::updateFromXml(const pugi::xml_node& node, const std::string& baseDir)
   } catch(...) {}
   const auto catattr = node.attribute("category");
   m_category = catattr.empty() ? getCategoryFromTags() : catattr.value();
+  const std::string integrity = ATTR("integrity");
+  m_integrity.status = integrity == "valid" ? Integrity::VALID
+                     : integrity == "corrupted" ? Integrity::CORRUPTED
+                     : integrity == "noChecksum" ? Integrity::NO_CHECKSUM
+                     : Integrity::UNKNOWN;
+  m_integrity.fileSize = strtoull(ATTR("integrityFileSize"), 0, 0);
+  m_integrity.fileMtime = strtoll(ATTR("integrityFileMtime"), 0, 0);
 }
 #undef ATTR
 
@@ -210,15 +229,49 @@ void Book::setPath(const std::string& path)
    : path;
 }
 
+bool Book::operator==(const Book& other) const
+{
+  if ( m_id != other.m_id || m_downloadId != other.m_downloadId
+    || m_path != other.m_path || m_pathValid != other.m_pathValid
+    || m_title != other.m_title || m_description != other.m_description
+    || m_category != other.m_category || m_language != other.m_language
+    || m_creator != other.m_creator || m_publisher != other.m_publisher
+    || m_date != other.m_date || m_url != other.m_url
+    || m_name != other.m_name || m_flavour != other.m_flavour
+    || m_tags != other.m_tags || m_origId != other.m_origId
+    || m_articleCount != other.m_articleCount
+    || m_mediaCount != other.m_mediaCount
+    || m_readOnly != other.m_readOnly || m_size != other.m_size
+    || m_faviconUrl != other.m_faviconUrl
+    || m_faviconMimeType != other.m_faviconMimeType
+    || m_integrity.status != other.m_integrity.status
+    || m_integrity.fileSize != other.m_integrity.fileSize
+    || m_integrity.fileMtime != other.m_integrity.fileMtime ) {
+    return false;
+  }
+  if ( !m_faviconUrl.empty() || m_favicon == other.m_favicon ) {
+    // A favicon downloaded from the url is not part of the content.
+    return true;
+  }
+  return m_favicon && other.m_favicon && *m_favicon == *other.m_favicon;
+}
+
 const std::string& Book::getFavicon() const {
-  if (m_favicon.empty() && !m_faviconUrl.empty()) {
+  static const std::string noFavicon;
+  if (!m_favicon && !m_faviconUrl.empty()) {
     try {
-      m_favicon = download(m_faviconUrl);
+      m_favicon = std::make_shared<const std::string>(download(m_faviconUrl));
     } catch(...) {
       std::cerr << "Cannot download favicon from " << m_faviconUrl;
     }
   }
-  return m_favicon;
+  return m_favicon ? *m_favicon : noFavicon;
+}
+
+void Book::setFavicon(const std::string& favicon) {
+  m_favicon = favicon.empty()
+            ? nullptr
+            : std::make_shared<const std::string>(favicon);
 }
 
 std::string Book::getTagStr(const std::string& tagName) const {
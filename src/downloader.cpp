@@ -35,19 +35,25 @@
 namespace kiwix
 {
 
+namespace
+{
+
+const std::vector<std::string> STATUS_KEY = {"status", "files", "totalLength",
+                                             "completedLength", "followedBy",
+                                             "downloadSpeed", "verifiedLength"};
+
+} // unnamed namespace
+
+const std::string& Download::getStatusGid(bool follow) const
+{
+  return follow && !m_followedBy.empty() ? m_followedBy : m_did;
+}
+
 void Download::updateStatus(bool follow)
 {
-  if (m_status == Download::K_REMOVED)
+  if (m_status == Download::K_REMOVED || m_did.empty())
     return;
-  static std::vector<std::string> statusKey = {"status", "files", "totalLength",
-                                               "completedLength", "followedBy",
-                                               "downloadSpeed", "verifiedLength"};
-  std::string strStatus;
-  if(follow && !m_followedBy.empty()) {
-    strStatus = mp_aria->tellStatus(m_followedBy, statusKey);
-  } else {
-    strStatus = mp_aria->tellStatus(m_did, statusKey);
-  }
+  std::string strStatus = mp_aria->tellStatus(getStatusGid(follow), STATUS_KEY);
 //  std::cout << strStatus << std::endl;
   MethodResponse response(strStatus);
   if (response.isFault()) {
@@ -55,6 +61,13 @@ void Download::updateStatus(bool follow)
     return;
   }
   auto structNode = response.getParams().getParam(0).getValue().getStruct();
+  if (!updateStatus(structNode, follow)) {
+    updateStatus(true);
+  }
+}
+
+bool Download::updateStatus(const Struct& structNode, bool follow)
+{
   auto _status = structNode.getMember("status").getValue().getAsS();
   auto status = _status == "active" ? Download::K_ACTIVE
               : _status == "waiting" ? Download::K_WAITING
@@ -66,11 +79,11 @@ void Download::updateStatus(bool follow)
   if (status == K_COMPLETE) {
     try {
       auto followedByMember = structNode.getMember("followedBy");
-      m_followedBy = followedByMember.getValue().getArray().getValue(0).getAsS();
-      if (follow) {
-        status = K_ACTIVE;
-        updateStatus(true);
-        return;
+      const auto followedBy = followedByMember.getValue().getArray().getValue(0).getAsS();
+      const bool followedByChanged = followedBy != m_followedBy;
+      m_followedBy = followedBy;
+      if (follow && followedByChanged) {
+        return false;
       }
     } catch (InvalidRPCNode& e) { }
   }
@@ -94,6 +107,7 @@ void Download::updateStatus(bool follow)
       m_uris.push_back(uriNode.getValue().getAsS());
     } catch(InvalidRPCNode& e) { break; }
   }
+  return true;
 }
 
 void Download::resumeDownload()
@@ -125,37 +139,164 @@ void Download::cancelDownload()
 
 /* Constructor */
 Downloader::Downloader() :
-  mp_aria(new Aria2())
+  mp_aria(new Aria2()),
+  m_ready(m_readyPromise.get_future().share())
 {
+  m_startThread = std::thread(&Downloader::start, this);
+}
+
+Downloader::Downloader(std::shared_ptr<Aria2> aria) :
+  mp_aria(aria),
+  m_ready(m_readyPromise.get_future().share())
+{
+  m_startThread = std::thread(&Downloader::start, this);
+}
+
+/* Destructor */
+Downloader::~Downloader()
+{
+  stopPolling();
+  {
+    std::unique_lock<std::mutex> lock(m_lock);
+    m_closing = true;
+  }
+  if (m_startThread.joinable()) {
+    m_startThread.join();
+  }
+}
+
+/* Wait for aria2, then read the known downloads and start the queued ones. */
+void Downloader::start()
+{
+  auto ariaReady = mp_aria->getReadyFuture();
+  while (ariaReady.wait_for(std::chrono::milliseconds(10)) != std::future_status::ready) {
+    std::unique_lock<std::mutex> lock(m_lock);
+    if (m_closing) {
+      m_readyPromise.set_exception(std::make_exception_ptr(
+        std::runtime_error("Downloader closed before aria2 is ready")));
+      return;
+    }
+  }
+
   try {
-    for (auto gid : mp_aria->tellActive()) {
-      m_knownDownloads[gid] = std::unique_ptr<Download>(new Download(mp_aria, gid));
-      m_knownDownloads[gid]->updateStatus();
+    ariaReady.get();
+  } catch (std::exception& e) {
+    std::cerr << "aria2 is not available : " << e.what() << std::endl;
+    std::unique_lock<std::mutex> lock(m_lock);
+    for (auto& queued : m_queuedDownloads) {
+      queued.download->m_status = Download::K_ERROR;
     }
+    m_started = true;
+    m_readyPromise.set_exception(std::current_exception());
+    return;
+  }
+
+  readKnownDownloads();
+
+  // Start the queued downloads. The lock is released during the requests
+  // to aria2, so downloads may be queued meanwhile: they are started by the
+  // next round.
+  std::unique_lock<std::mutex> lock(m_lock);
+  // The queued downloads before this index could not be started.
+  size_t tried = 0;
+  while (tried < m_queuedDownloads.size()) {
+    std::vector<std::pair<std::vector<std::string>, Options>> requests;
+    for (size_t i = tried; i < m_queuedDownloads.size(); i++) {
+      const auto& queued = m_queuedDownloads[i];
+      requests.emplace_back(queued.download->m_uris, queued.options);
+    }
+    lock.unlock();
+
+    std::vector<std::string> gids;
+    for (const auto& request : requests) {
+      try {
+        gids.push_back(mp_aria->addUri(request.first, request.second));
+      } catch (std::exception& e) {
+        std::cerr << "aria2 addUri failed : " << e.what() << std::endl;
+        gids.push_back("");
+      }
+    }
+
+    lock.lock();
+    std::vector<QueuedDownload> queue;
+    size_t failedCount = 0;
+    for (size_t i = 0; i < m_queuedDownloads.size(); i++) {
+      auto& queued = m_queuedDownloads[i];
+      if (i >= tried && i - tried < gids.size()) {
+        const auto& gid = gids[i - tried];
+        if (!gid.empty()) {
+          queued.download->m_did = gid;
+          m_knownDownloads[gid] = std::move(queued.download);
+          continue;
+        }
+        queued.download->m_status = Download::K_ERROR;
+        failedCount++;
+      }
+      queue.push_back(std::move(queued));
+    }
+    m_queuedDownloads.swap(queue);
+    tried += failedCount;
+  }
+  m_started = true;
+  m_readyPromise.set_value();
+}
+
+bool Downloader::isReady() const
+{
+  if (m_ready.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+    return false;
+  }
+  try {
+    m_ready.get();
+    return true;
+  } catch (std::exception& e) {
+    return false;
+  }
+}
+
+void Downloader::readKnownDownloads()
+{
+  std::vector<std::string> gids;
+  try {
+    gids = mp_aria->tellActive();
   } catch (std::exception& e) {
     std::cerr << "aria2 tellActive failed : " << e.what() << std::endl;
   }
   try {
-    for (auto gid : mp_aria->tellWaiting()) {
-      m_knownDownloads[gid] = std::unique_ptr<Download>(new Download(mp_aria, gid));
-      m_knownDownloads[gid]->updateStatus();
-    }
+    const auto waitingGids = mp_aria->tellWaiting();
+    gids.insert(gids.end(), waitingGids.begin(), waitingGids.end());
   } catch (std::exception& e) {
     std::cerr << "aria2 tellWaiting failed : " << e.what() << std::endl;
   }
-}
 
-/* Destructor */
-Downloader::~Downloader()
-{
+  std::vector<std::unique_ptr<Download>> newDownloads;
+  std::vector<Download*> downloads;
+  for (auto& gid : gids) {
+    newDownloads.emplace_back(new Download(mp_aria, gid));
+    downloads.push_back(newDownloads.back().get());
+  }
+  try {
+    updateStatuses(downloads);
+  } catch (std::exception& e) {
+    std::cerr << "aria2 tellStatus failed : " << e.what() << std::endl;
+  }
+
+  // Keep the downloads already adopted by getDownload().
+  std::unique_lock<std::mutex> lock(m_lock);
+  for (auto& download : newDownloads) {
+    const auto gid = download->getDid();
+    m_knownDownloads.emplace(gid, std::move(download));
+  }
 }
 
 void Downloader::close()
 {
+  stopPolling();
   mp_aria->close();
 }
 
 std::vector<std::string> Downloader::getDownloadIds() {
+  std::unique_lock<std::mutex> lock(m_lock);
   std::vector<std::string> ret;
   for(auto& p:m_knownDownloads) {
     ret.push_back(p.first);
@@ -165,39 +306,214 @@ std::vector<std::string> Downloader::getDownloadIds() {
 
 Download* Downloader::startDownload(const std::string& uri, const std::vector<std::pair<std::string, std::string>>& options)
 {
+  std::unique_lock<std::mutex> lock(m_lock);
   for (auto& p: m_knownDownloads) {
     auto& d = p.second;
     auto& uris = d->getUris();
     if (std::find(uris.begin(), uris.end(), uri) != uris.end())
       return d.get();
   }
+  if (!m_started) {
+    for (auto& queued : m_queuedDownloads) {
+      auto& uris = queued.download->getUris();
+      if (std::find(uris.begin(), uris.end(), uri) != uris.end())
+        return queued.download.get();
+    }
+    std::unique_ptr<Download> download(new Download(mp_aria, ""));
+    download->m_uris.push_back(uri);
+    m_queuedDownloads.push_back(QueuedDownload{std::move(download), options});
+    return m_queuedDownloads.back().download.get();
+  }
+  lock.unlock();
+
+  // Don't keep the lock during the request to aria2.
   std::vector<std::string> uris = {uri};
   auto gid = mp_aria->addUri(uris, options);
-  m_knownDownloads[gid] = std::unique_ptr<Download>(new Download(mp_aria, gid));
-  return m_knownDownloads[gid].get();
+  lock.lock();
+  auto& download = m_knownDownloads[gid];
+  if (!download) {
+    download.reset(new Download(mp_aria, gid));
+  }
+  return download.get();
+}
+
+size_t Downloader::getNbDownload()
+{
+  std::unique_lock<std::mutex> lock(m_lock);
+  return m_knownDownloads.size();
 }
 
 Download* Downloader::getDownload(const std::string& did)
 {
-  try {
-    m_knownDownloads.at(did).get()->updateStatus(true);
-    return m_knownDownloads.at(did).get();
-  } catch(std::exception& e) {
-    for (auto gid : mp_aria->tellActive()) {
-      if (gid == did) {
-        m_knownDownloads[gid] = std::unique_ptr<Download>(new Download(mp_aria, gid));
-        m_knownDownloads.at(gid).get()->updateStatus(true);
-        return m_knownDownloads[gid].get();
+  // The status is read into a copy, without the lock. The known download
+  // is only modified with the lock taken.
+  std::unique_ptr<Download> copy;
+  {
+    std::unique_lock<std::mutex> lock(m_lock);
+    const auto it = m_knownDownloads.find(did);
+    if (it != m_knownDownloads.end()) {
+      copy.reset(new Download(*it->second));
+    }
+  }
+  if (copy) {
+    try {
+      copy->updateStatus(true);
+      std::unique_lock<std::mutex> lock(m_lock);
+      const auto it = m_knownDownloads.find(did);
+      if (it != m_knownDownloads.end()) {
+        *it->second = *copy;
+        return it->second.get();
       }
+    } catch (std::exception& e) {}
+  }
+
+  // Only adopt the unknown downloads which are still running.
+  std::unique_ptr<Download> newDownload(new Download(mp_aria, did));
+  newDownload->updateStatus(true);
+  const auto status = newDownload->getStatus();
+  if (status != Download::K_ACTIVE
+   && status != Download::K_WAITING
+   && status != Download::K_PAUSED) {
+    throw std::out_of_range("No running download with id " + did);
+  }
+  std::unique_lock<std::mutex> lock(m_lock);
+  auto& knownDownload = m_knownDownloads[did];
+  if (knownDownload) {
+    // Adopted by another thread meanwhile.
+    *knownDownload = *newDownload;
+  } else {
+    knownDownload = std::move(newDownload);
+  }
+  return knownDownload.get();
+}
+
+void Downloader::updateDownloads()
+{
+  // The statuses are read into copies of the downloads, without the lock,
+  // and then applied to the known downloads with the lock taken.
+  std::map<std::string, Download> copies;
+  {
+    std::unique_lock<std::mutex> lock(m_lock);
+    for (auto& p: m_knownDownloads) {
+      copies.emplace(p.first, *p.second);
+    }
+  }
+  std::vector<Download*> downloads;
+  for (auto& p: copies) {
+    downloads.push_back(&p.second);
+  }
+  updateStatuses(downloads);
+
+  std::unique_lock<std::mutex> lock(m_lock);
+  for (const auto& p: copies) {
+    const auto it = m_knownDownloads.find(p.first);
+    if (it != m_knownDownloads.end()) {
+      *it->second = p.second;
+    }
+  }
+}
+
+/* Read the statuses of the downloads with one multicall request. Downloads
+ * discovering that they are followed by another one are read again (once)
+ * to get the status of the download following them. */
+void Downloader::updateStatuses(const std::vector<Download*>& downloads)
+{
+  std::vector<Download*> toRead;
+  for (auto download : downloads) {
+    if (download->m_status != Download::K_REMOVED) {
+      toRead.push_back(download);
+    }
+  }
+
+  for (int pass = 0; pass < 2 && !toRead.empty(); pass++) {
+    std::vector<std::string> gids;
+    for (auto download : toRead) {
+      gids.push_back(download->getStatusGid(true));
     }
-    for (auto gid : mp_aria->tellWaiting()) {
-      if (gid == did) {
-        m_knownDownloads[gid] = std::unique_ptr<Download>(new Download(mp_aria, gid));
-        m_knownDownloads.at(gid).get()->updateStatus(true);
-        return m_knownDownloads[gid].get();
+    MethodResponse response(mp_aria->tellStatuses(gids, STATUS_KEY));
+    auto results = response.getParamValue(0).getArray();
+    std::vector<Download*> followed;
+    for (size_t i = 0; i < toRead.size(); i++) {
+      try {
+        // A successful call gives an array of one value, a failed one a
+        // fault struct.
+        auto structNode = results.getValue(i).getArray().getValue(0).getStruct();
+        if (!toRead[i]->updateStatus(structNode, true)) {
+          followed.push_back(toRead[i]);
+        }
+      } catch (InvalidRPCNode& e) {
+        toRead[i]->m_status = Download::K_UNKNOWN;
       }
+    }
+    toRead.swap(followed);
   }
-    throw e;
+}
+
+void Downloader::startPolling(unsigned int intervalMs, StatusCallback callback)
+{
+  stopPolling();
+  m_stopPolling = false;
+  m_pollerThread = std::thread(&Downloader::poll, this, intervalMs, callback);
+}
+
+void Downloader::stopPolling()
+{
+  {
+    std::unique_lock<std::mutex> lock(m_lock);
+    m_stopPolling = true;
+  }
+  m_pollerCondition.notify_all();
+  if (m_pollerThread.joinable()) {
+    m_pollerThread.join();
+  }
+}
+
+std::map<std::string, Download> Downloader::getDownloadSnapshots() const
+{
+  std::unique_lock<std::mutex> lock(m_snapshotsLock);
+  return m_snapshots;
+}
+
+void Downloader::poll(unsigned int intervalMs, StatusCallback callback)
+{
+  std::unique_lock<std::mutex> lock(m_lock);
+  while (!m_stopPolling) {
+    // The poller works on its own copies of the downloads, so the downloads
+    // used by the other threads are never modified.
+    auto snapshots = getDownloadSnapshots();
+    for (auto& p: m_knownDownloads) {
+      if (snapshots.find(p.first) == snapshots.end()) {
+        snapshots.emplace(p.first, Download(mp_aria, p.first));
+      }
+    }
+    lock.unlock();
+
+    std::map<std::string, Download::StatusResult> previousStatuses;
+    std::vector<Download*> downloads;
+    for (auto& p: snapshots) {
+      previousStatuses[p.first] = p.second.getStatus();
+      downloads.push_back(&p.second);
+    }
+    try {
+      updateStatuses(downloads);
+    } catch (std::exception& e) {
+      std::cerr << "aria2 tellStatus failed : " << e.what() << std::endl;
+    }
+    {
+      std::unique_lock<std::mutex> snapshotsLock(m_snapshotsLock);
+      m_snapshots = snapshots;
+    }
+    if (callback) {
+      for (auto& p: snapshots) {
+        if (p.second.getStatus() != previousStatuses[p.first]) {
+          callback(p.second, previousStatuses[p.first]);
+        }
+      }
+    }
+
+    lock.lock();
+    m_pollerCondition.wait_for(lock, std::chrono::milliseconds(intervalMs),
+                               [this]() { return m_stopPolling; });
   }
 }
 
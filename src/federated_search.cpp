@@ -0,0 +1,401 @@
+/*
+ * Copyright 2021 Kiwix <contact@kiwix.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU  General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include "federated_search.h"
+
+#include <algorithm>
+#include <exception>
+#include <set>
+#include <stdexcept>
+
+#include <zim/archive.h>
+#include <zim/search.h>
+
+namespace kiwix
+{
+
+struct FederatedSearcher::ArchiveSearcher
+{
+  ArchiveSearcher(const std::string& bookId, std::shared_ptr<zim::Archive> archive)
+    : bookId(bookId),
+      archive(archive),
+      searcher(*archive)
+  {}
+
+  const std::string bookId;
+  const std::shared_ptr<zim::Archive> archive;
+  // A zim::Searcher (and the results it gives) cannot be used from several
+  // threads at the same time.
+  std::mutex mutex;
+  zim::Searcher searcher;
+};
+
+namespace
+{
+
+// A result of an archive, before the merge.
+struct Hit {
+  int score;
+  size_t archiveIndex;
+  size_t rank;
+};
+
+// The scores of Xapian are percentages of the best match of each archive,
+// so they cannot be compared between archives. The archives are interleaved
+// by rank (round-robin), the results of a same rank ordered by score.
+bool isBetter(const Hit& a, const Hit& b)
+{
+  if (a.rank != b.rank) {
+    return a.rank < b.rank;
+  }
+  if (a.score != b.score) {
+    return a.score > b.score;
+  }
+  return a.archiveIndex < b.archiveIndex;
+}
+
+struct ArchiveResults {
+  std::unique_ptr<zim::SearchResultSet> resultSet;
+  std::vector<zim::SearchIterator> iterators;
+  unsigned int estimatedMatches = 0;
+  std::exception_ptr error;
+};
+
+// The maximum number of scopes kept. When it is reached, the scopes are
+// forgotten.
+const size_t MAX_SCOPE_COUNT = 1024;
+
+} // unnamed namespace
+
+FederatedSearcher::FederatedSearcher(unsigned int threadCount, const Filter& filter)
+  : m_filter(filter),
+    mp_archiveList(std::make_shared<const ArchiveSearchers>())
+{
+  for (unsigned int i = 0; i < threadCount; i++) {
+    m_threads.emplace_back(&FederatedSearcher::work, this);
+  }
+}
+
+FederatedSearcher::~FederatedSearcher()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_tasksMutex);
+    m_stopping = true;
+  }
+  m_tasksCondition.notify_all();
+  for (auto& thread : m_threads) {
+    thread.join();
+  }
+}
+
+void FederatedSearcher::update(Library& library)
+{
+  std::lock_guard<std::mutex> updateLock(m_updateMutex);
+  const auto revision = library.getRevision();
+  if (m_updated && revision == m_revision) {
+    return;
+  }
+
+  Library::Changes changes;
+  bool readAll = !m_updated;
+  if (!readAll) {
+    try {
+      changes = library.getChangesSince(m_revision);
+    } catch (const std::out_of_range&) {
+      readAll = true;
+    }
+  }
+  if (readAll) {
+    // Only the books whose revision has changed are read again.
+    changes.updatedBooks = library.filter(m_filter);
+    const std::set<std::string> bookIds(changes.updatedBooks.begin(), changes.updatedBooks.end());
+    for (const auto& p : m_bookRevisions) {
+      if (bookIds.find(p.first) == bookIds.end()) {
+        changes.removedBooks.push_back(p.first);
+      }
+    }
+  }
+
+  for (const auto& bookId : changes.addedBooks) {
+    updateBook(library, bookId);
+  }
+  for (const auto& bookId : changes.updatedBooks) {
+    updateBook(library, bookId);
+  }
+
+  std::lock_guard<std::mutex> lock(m_archivesMutex);
+  for (const auto& bookId : changes.removedBooks) {
+    m_archives.erase(bookId);
+    m_bookRevisions.erase(bookId);
+  }
+  auto archiveList = std::make_shared<ArchiveSearchers>();
+  archiveList->reserve(m_archives.size());
+  for (const auto& p : m_archives) {
+    archiveList->push_back(p.second);
+  }
+  mp_archiveList = archiveList;
+  m_scopes.clear();
+  m_revision = revision;
+  m_updated = true;
+}
+
+void FederatedSearcher::updateBook(Library& library, const std::string& bookId)
+{
+  const Library& constLibrary = library;
+  uint64_t bookRevision;
+  try {
+    bookRevision = constLibrary.getBookRevision(bookId);
+  } catch (const std::out_of_range&) {
+    // Removed since (0 is never a revision).
+    bookRevision = 0;
+  }
+  const auto known = m_bookRevisions.find(bookId);
+  if (known != m_bookRevisions.end() && known->second == bookRevision) {
+    // Not changed since the last read.
+    return;
+  }
+  if (bookRevision != 0) {
+    m_bookRevisions[bookId] = bookRevision;
+  } else if (known != m_bookRevisions.end()) {
+    m_bookRevisions.erase(known);
+  }
+
+  std::shared_ptr<zim::Archive> archive;
+  try {
+    if (m_filter.accept(constLibrary.getBookById(bookId))) {
+      archive = library.getArchiveById(bookId);
+    }
+  } catch (const std::exception&) {}
+
+  {
+    std::lock_guard<std::mutex> lock(m_archivesMutex);
+    const auto it = m_archives.find(bookId);
+    if (it != m_archives.end() && archive && it->second->archive == archive) {
+      // Same archive: keep its (warm) searcher.
+      return;
+    }
+    if (it != m_archives.end()) {
+      m_archives.erase(it);
+    }
+  }
+  if (!archive) {
+    return;
+  }
+
+  std::shared_ptr<ArchiveSearcher> archiveSearcher;
+  try {
+    archiveSearcher = std::make_shared<ArchiveSearcher>(bookId, archive);
+  } catch (const std::exception&) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(m_archivesMutex);
+  m_archives[bookId] = archiveSearcher;
+}
+
+size_t FederatedSearcher::getArchiveCount() const
+{
+  std::lock_guard<std::mutex> lock(m_archivesMutex);
+  return mp_archiveList->size();
+}
+
+FederatedSearcher::Results FederatedSearcher::search(const zim::Query& query,
+                                                     unsigned int start,
+                                                     unsigned int count)
+{
+  std::shared_ptr<const ArchiveSearchers> archives;
+  {
+    std::lock_guard<std::mutex> lock(m_archivesMutex);
+    archives = mp_archiveList;
+  }
+  return search(*archives, query, start, count);
+}
+
+FederatedSearcher::Results FederatedSearcher::search(const zim::Query& query,
+                                                     unsigned int start,
+                                                     unsigned int count,
+                                                     const std::string& scopeKey,
+                                                     const std::function<Library::BookIdCollection()>& getBookIds)
+{
+  std::shared_ptr<const ArchiveSearchers> archives;
+  uint64_t revision;
+  {
+    std::lock_guard<std::mutex> lock(m_archivesMutex);
+    const auto it = m_scopes.find(scopeKey);
+    if (it != m_scopes.end()) {
+      archives = it->second;
+    }
+    revision = m_revision;
+  }
+
+  if (!archives) {
+    const auto bookIds = getBookIds();
+    auto scope = std::make_shared<ArchiveSearchers>();
+    std::lock_guard<std::mutex> lock(m_archivesMutex);
+    for (const auto& bookId : bookIds) {
+      const auto it = m_archives.find(bookId);
+      if (it != m_archives.end()) {
+        scope->push_back(it->second);
+      }
+    }
+    archives = scope;
+    // Don't cache a scope computed from a previous version of the library.
+    if (revision == m_revision) {
+      if (m_scopes.size() >= MAX_SCOPE_COUNT) {
+        m_scopes.clear();
+      }
+      m_scopes[scopeKey] = archives;
+    }
+  }
+  return search(*archives, query, start, count);
+}
+
+FederatedSearcher::Results FederatedSearcher::search(const ArchiveSearchers& archives,
+                                                     const zim::Query& query,
+                                                     unsigned int start,
+                                                     unsigned int count)
+{
+  // Get the best `start + count` results of each archive.
+  const auto maxResults = start + count;
+  std::vector<ArchiveResults> archiveResults(archives.size());
+  std::vector<std::function<void()>> tasks;
+  for (size_t i = 0; i < archives.size(); i++) {
+    tasks.push_back([&, i]() {
+      auto& archive = *archives[i];
+      auto& results = archiveResults[i];
+      try {
+        std::lock_guard<std::mutex> lock(archive.mutex);
+        auto search = archive.searcher.search(query);
+        results.estimatedMatches = search.getEstimatedMatches();
+        results.resultSet.reset(new zim::SearchResultSet(search.getResults(0, maxResults)));
+        for (auto it = results.resultSet->begin(); it != results.resultSet->end(); it++) {
+          results.iterators.push_back(it);
+        }
+      } catch (...) {
+        results.error = std::current_exception();
+      }
+    });
+  }
+  run(std::move(tasks));
+
+  Results results;
+  std::vector<Hit> hits;
+  std::exception_ptr error;
+  bool searched = archives.empty();
+  for (size_t i = 0; i < archives.size(); i++) {
+    auto& archive = *archives[i];
+    const auto& archiveResult = archiveResults[i];
+    if (archiveResult.error) {
+      // An archive without full text index.
+      error = archiveResult.error;
+      continue;
+    }
+    searched = true;
+    results.estimatedMatches += archiveResult.estimatedMatches;
+    std::lock_guard<std::mutex> lock(archive.mutex);
+    for (size_t rank = 0; rank < archiveResult.iterators.size(); rank++) {
+      hits.push_back(Hit{archiveResult.iterators[rank].getScore(), i, rank});
+    }
+  }
+  if (!searched) {
+    std::rethrow_exception(error);
+  }
+
+  // Merge the results and keep the page only.
+  if (hits.size() <= start) {
+    return results;
+  }
+  const auto end = std::min(hits.size(), size_t(maxResults));
+  std::partial_sort(hits.begin(), hits.begin() + end, hits.end(), isBetter);
+
+  // Read the results of the page, in parallel too.
+  results.results.resize(end - start);
+  std::map<size_t, std::vector<size_t>> pageByArchive;
+  for (size_t index = start; index < end; index++) {
+    pageByArchive[hits[index].archiveIndex].push_back(index);
+  }
+  std::vector<std::function<void()>> pageTasks;
+  for (const auto& p : pageByArchive) {
+    pageTasks.push_back([&, p]() {
+      auto& archive = *archives[p.first];
+      std::lock_guard<std::mutex> lock(archive.mutex);
+      for (auto index : p.second) {
+        auto& result = results.results[index - start];
+        try {
+          const auto& it = archiveResults[p.first].iterators[hits[index].rank];
+          result.title = it.getTitle();
+          result.path = it.getPath();
+          result.snippet = it.getSnippet();
+          result.wordCount = it.getWordCount();
+        } catch (const std::exception&) {}
+        result.bookId = archive.bookId;
+      }
+    });
+  }
+  run(std::move(pageTasks));
+  return results;
+}
+
+void FederatedSearcher::run(std::vector<std::function<void()>> tasks)
+{
+  if (m_threads.empty()) {
+    for (auto& task : tasks) {
+      task();
+    }
+    return;
+  }
+
+  std::mutex doneMutex;
+  std::condition_variable doneCondition;
+  size_t pending = tasks.size();
+  {
+    std::lock_guard<std::mutex> lock(m_tasksMutex);
+    for (auto& task : tasks) {
+      m_tasks.push_back([&, task]() {
+        task();
+        std::lock_guard<std::mutex> lock(doneMutex);
+        if (--pending == 0) {
+          doneCondition.notify_all();
+        }
+      });
+    }
+  }
+  m_tasksCondition.notify_all();
+
+  std::unique_lock<std::mutex> lock(doneMutex);
+  doneCondition.wait(lock, [&]() { return pending == 0; });
+}
+
+void FederatedSearcher::work()
+{
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(m_tasksMutex);
+      m_tasksCondition.wait(lock, [this]() { return m_stopping || !m_tasks.empty(); });
+      if (m_tasks.empty()) {
+        return;
+      }
+      task = std::move(m_tasks.front());
+      m_tasks.pop_front();
+    }
+    task();
+  }
+}
+
+}
@@ -0,0 +1,151 @@
+/*
+ * Copyright 2021 Kiwix <contact@kiwix.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU  General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef KIWIX_FEDERATED_SEARCH_H
+#define KIWIX_FEDERATED_SEARCH_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "library.h"
+#include "search_renderer.h"
+
+namespace zim
+{
+class Archive;
+class Query;
+}
+
+namespace kiwix
+{
+
+/**
+ * A full text search over the archives of the books of a library.
+ *
+ * Each archive has its own searcher, kept between the searches: update()
+ * only opens the archives of the books changed since the previous update.
+ * The archives are searched in parallel by a pool of threads. Each archive
+ * gives its best `start + count` results, which are merged round-robin by
+ * rank: the best result of each archive first, then the second ones, and so
+ * on (the results of a same rank are ordered by score). The scores are not
+ * compared between archives, Xapian giving them relative to the best match
+ * of each archive. Only the results of the requested page are read.
+ *
+ * All the methods can be called from several threads.
+ */
+class FederatedSearcher
+{
+  public:
+    struct Results {
+      std::vector<SearchRenderer::Result> results;
+      unsigned int estimatedMatches = 0;
+    };
+
+    /**
+     * @param threadCount The number of threads searching the archives.
+     * @param filter The filter selecting the books to search.
+     */
+    FederatedSearcher(unsigned int threadCount, const Filter& filter);
+    ~FederatedSearcher();
+
+    FederatedSearcher(const FederatedSearcher&) = delete;
+    FederatedSearcher& operator=(const FederatedSearcher&) = delete;
+
+    /**
+     * Update the archives searched with the changes of the library.
+     *
+     * It does nothing if the library has not changed since the last update.
+     * If the changes are not known anymore, all the books are read again.
+     */
+    void update(Library& library);
+
+    /**
+     * Search all the archives.
+     *
+     * @param query The query.
+     * @param start The index of the first result to return.
+     * @param count The number of results to return.
+     * @return The results and the sum of the estimated matches of the archives.
+     */
+    Results search(const zim::Query& query, unsigned int start, unsigned int count);
+
+    /**
+     * Search the archives of some books only.
+     *
+     * The archives of the books are cached with `scopeKey` until the next
+     * change of the library (see update()): `getBookIds` is only called if
+     * they are not cached.
+     *
+     * @param scopeKey The key of the books, for instance the signature of
+     *                 the filter selecting them.
+     * @param getBookIds A function returning the ids of the books.
+     */
+    Results search(const zim::Query& query, unsigned int start, unsigned int count,
+                   const std::string& scopeKey,
+                   const std::function<Library::BookIdCollection()>& getBookIds);
+
+    /* The number of archives searched. */
+    size_t getArchiveCount() const;
+
+  private:
+    struct ArchiveSearcher;
+    typedef std::vector<std::shared_ptr<ArchiveSearcher>> ArchiveSearchers;
+
+    void updateBook(Library& library, const std::string& bookId);
+    Results search(const ArchiveSearchers& archives,
+                   const zim::Query& query, unsigned int start, unsigned int count);
+    void run(std::vector<std::function<void()>> tasks);
+    void work();
+
+    Filter m_filter;
+
+    // The archive searchers, by book id.
+    mutable std::mutex m_archivesMutex;
+    std::map<std::string, std::shared_ptr<ArchiveSearcher>> m_archives;
+    // The archive searchers, in the order of the book ids (for the searches).
+    std::shared_ptr<const ArchiveSearchers> mp_archiveList;
+    // The archive searchers of the scopes, by scope key.
+    std::map<std::string, std::shared_ptr<const ArchiveSearchers>> m_scopes;
+    std::mutex m_updateMutex;
+    // The revision of the books when they have been read (see updateBook()),
+    // including the ones not searched. Used with m_updateMutex locked.
+    std::map<std::string, uint64_t> m_bookRevisions;
+    // Modified with both m_updateMutex and m_archivesMutex locked.
+    uint64_t m_revision = 0;
+    bool m_updated = false;
+
+    // The pool of threads.
+    std::mutex m_tasksMutex;
+    std::condition_variable m_tasksCondition;
+    std::deque<std::function<void()>> m_tasks;
+    std::vector<std::thread> m_threads;
+    bool m_stopping = false;
+};
+
+}
+
+#endif // KIWIX_FEDERATED_SEARCH_H
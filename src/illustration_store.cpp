@@ -0,0 +1,130 @@
+/*
+ * Copyright 2021 Kiwix <contact@kiwix.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU  General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include "illustration_store.h"
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+
+namespace kiwix
+{
+
+namespace
+{
+
+const size_t MIN_DATA_SWEEP_THRESHOLD = 64;
+
+size_t illustrationSize(const Illustration& illustration)
+{
+  return illustration.data ? illustration.data->size() : 0;
+}
+
+} // unnamed namespace
+
+IllustrationStore::IllustrationStore(size_t maxCacheSize)
+  : m_dataSweepThreshold(MIN_DATA_SWEEP_THRESHOLD),
+    m_cacheSize(0),
+    m_maxCacheSize(maxCacheSize)
+{
+}
+
+IllustrationStore::Data IllustrationStore::intern(const Data& data)
+{
+  if (!data) {
+    return data;
+  }
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return internLocked(data);
+}
+
+IllustrationStore::Data IllustrationStore::internLocked(const Data& data)
+{
+  const auto hash = std::hash<std::string>()(*data);
+  const auto range = m_data.equal_range(hash);
+  for (auto it = range.first; it != range.second; ++it) {
+    const auto stored = it->second.lock();
+    if (stored && *stored == *data) {
+      return stored;
+    }
+  }
+
+  // The data of removed books are not tracked. Forget them once in a while.
+  if (m_data.size() >= m_dataSweepThreshold) {
+    for (auto it = m_data.begin(); it != m_data.end(); ) {
+      it = it->second.expired() ? m_data.erase(it) : std::next(it);
+    }
+    m_dataSweepThreshold = std::max(MIN_DATA_SWEEP_THRESHOLD, 2 * m_data.size());
+  }
+  m_data.emplace(hash, data);
+  return data;
+}
+
+Illustration IllustrationStore::getCached(const std::string& bookId)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  const auto it = m_cacheIndex.find(bookId);
+  if (it == m_cacheIndex.end()) {
+    return Illustration();
+  }
+  m_cache.splice(m_cache.begin(), m_cache, it->second);
+  return it->second->second;
+}
+
+void IllustrationStore::cache(const std::string& bookId, const Illustration& illustration)
+{
+  const auto size = illustrationSize(illustration);
+  if (size > m_maxCacheSize) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  Illustration stored = illustration;
+  stored.data = internLocked(illustration.data);
+  const auto it = m_cacheIndex.find(bookId);
+  if (it != m_cacheIndex.end()) {
+    m_cacheSize -= illustrationSize(it->second->second);
+    it->second->second = stored;
+    m_cache.splice(m_cache.begin(), m_cache, it->second);
+  } else {
+    m_cache.emplace_front(bookId, stored);
+    m_cacheIndex[bookId] = m_cache.begin();
+  }
+  m_cacheSize += size;
+
+  while (m_cacheSize > m_maxCacheSize) {
+    const auto& last = m_cache.back();
+    m_cacheSize -= illustrationSize(last.second);
+    m_cacheIndex.erase(last.first);
+    m_cache.pop_back();
+  }
+}
+
+void IllustrationStore::uncache(const std::string& bookId)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  const auto it = m_cacheIndex.find(bookId);
+  if (it != m_cacheIndex.end()) {
+    m_cacheSize -= illustrationSize(it->second->second);
+    m_cache.erase(it->second);
+    m_cacheIndex.erase(it);
+  }
+}
+
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright 2021 Kiwix <contact@kiwix.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU  General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef KIWIX_ILLUSTRATION_STORE_H
+#define KIWIX_ILLUSTRATION_STORE_H
+
+#include "library.h"
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace kiwix
+{
+
+/**
+ * Storage of the illustrations (favicons) of the books of a library.
+ *
+ * Identical illustrations are stored only once, whatever the number of
+ * books using them. Illustrations read from the zim files are kept in a
+ * cache, bounded by the total size of the illustrations.
+ *
+ * All the methods can be called from several threads.
+ */
+class IllustrationStore
+{
+  public:
+    typedef std::shared_ptr<const std::string> Data;
+
+    explicit IllustrationStore(size_t maxCacheSize);
+
+    /* Return the stored data equal to `data` if any, else store `data`. */
+    Data intern(const Data& data);
+
+    /* The illustration cached for a book (with no data if there is none). */
+    Illustration getCached(const std::string& bookId);
+    void cache(const std::string& bookId, const Illustration& illustration);
+    void uncache(const std::string& bookId);
+
+  private:
+    Data internLocked(const Data& data);
+
+    typedef std::pair<std::string, Illustration> CacheEntry;
+
+    std::mutex m_mutex;
+    // Stored data by hash of their content.
+    std::unordered_multimap<size_t, std::weak_ptr<const std::string>> m_data;
+    size_t m_dataSweepThreshold;
+    // Cached illustrations, the most recently used first.
+    std::list<CacheEntry> m_cache;
+    std::unordered_map<std::string, std::list<CacheEntry>::iterator> m_cacheIndex;
+    size_t m_cacheSize;
+    size_t m_maxCacheSize;
+};
+
+}
+
+#endif // KIWIX_ILLUSTRATION_STORE_H
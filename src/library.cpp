@@ -21,8 +21,12 @@
 #include "book.h"
 #include "reader.h"
 #include "libxml_dumper.h"
+#include "library_index.h"
+#include "library_snapshot.h"
+#include "illustration_store.h"
 
 #include "tools.h"
+#include "tools/archiveTools.h"
 #include "tools/base64.h"
 #include "tools/regexTools.h"
 #include "tools/pathTools.h"
@@ -30,9 +34,12 @@
 
 #include <pugixml.hpp>
 #include <algorithm>
+#include <chrono>
+#include <functional>
 #include <set>
 #include <unicode/locid.h>
 #include <xapian.h>
+#include <zlib.h>
 
 namespace kiwix
 {
@@ -49,17 +56,126 @@ std::string normalizeText(const std::string& text)
   return removeAccents(text);
 }
 
+// The absolute and normalized form of a path, to compare paths of books.
+// Empty paths (remote books) are kept empty.
+std::string normalizePath(const std::string& path)
+{
+  if (path.empty()) {
+    return path;
+  }
+  return isRelativePath(path)
+    ? computeAbsolutePath(getCurrentDirectory(), path)
+    : computeAbsolutePath(path, "");
+}
+
+// Xapian document ids start at 1. Documents of the BookDB are stored with a
+// docid derived from the book ordinal, so search results can be mapped back
+// to books without reading the documents.
+Xapian::docid ordinalToDocid(BookOrdinal ordinal)
+{
+  return ordinal + 1;
+}
+
+BookOrdinal docidToOrdinal(Xapian::docid docid)
+{
+  return docid - 1;
+}
+
+// Change it each time the way books are indexed changes, so databases
+// created by older versions are rebuilt.
+const char BOOKDB_REVISION[] = "1";
+const char BOOKDB_REVISION_KEY[] = "kiwix_bookdb_revision";
+const Xapian::valueno BOOKDB_FINGERPRINT_SLOT = 0;
+
+// Maximum number of changes kept in the journal of the library.
+const size_t JOURNAL_SIZE = 16384;
+
+uint64_t initialRevision()
+{
+  const auto now = std::chrono::system_clock::now().time_since_epoch();
+  return std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+}
+
+// Maximum size of the illustrations read from the zim files kept in memory.
+const size_t ILLUSTRATION_CACHE_SIZE = 8 * 1024 * 1024;
+
+// A fingerprint of the indexed data of a book, to detect the documents of
+// a persistent BookDB which must be updated.
+std::string bookDBFingerprint(const Book& book)
+{
+  std::string data;
+  for ( const auto& field : { book.getId(), book.getTitle(), book.getDescription(),
+                              book.getLanguage(), book.getCreator(), book.getPublisher(),
+                              book.getName(), book.getCategory(), book.getTags() } ) {
+    data += field;
+    data += '\0';
+  }
+  const auto crc = crc32(0L, reinterpret_cast<const Bytef*>(data.data()), data.size());
+  return to_string(crc) + ":" + to_string(data.size());
+}
+
 } // unnamed namespace
 
 class Library::BookDB : public Xapian::WritableDatabase
 {
 public:
-  BookDB() : Xapian::WritableDatabase("", Xapian::DB_BACKEND_INMEMORY) {}
+  BookDB()
+    : Xapian::WritableDatabase("", Xapian::DB_BACKEND_INMEMORY),
+      persistent(false)
+  {}
+
+  BookDB(const std::string& path, int action)
+    : Xapian::WritableDatabase(path, action | Xapian::DB_BACKEND_GLASS),
+      persistent(true)
+  {}
+
+  /* Whether the document of `ordinal` indexes a book with `fingerprint`.
+   * The fingerprints are kept in memory, so it is known without reading
+   * the document. */
+  bool indexes(BookOrdinal ordinal, const std::string& fingerprint) const
+  {
+    return ordinal < fingerprints.size() && fingerprints[ordinal] == fingerprint;
+  }
+
+  void setDocument(BookOrdinal ordinal, const Xapian::Document& doc, const std::string& fingerprint)
+  {
+    replace_document(ordinalToDocid(ordinal), doc);
+    setFingerprint(ordinal, fingerprint);
+  }
+
+  void deleteDocument(BookOrdinal ordinal)
+  {
+    delete_document(ordinalToDocid(ordinal));
+    setFingerprint(ordinal, "");
+  }
+
+  void setFingerprint(BookOrdinal ordinal, const std::string& fingerprint)
+  {
+    if (fingerprints.size() <= ordinal) {
+      fingerprints.resize(ordinal + 1);
+    }
+    fingerprints[ordinal] = fingerprint;
+  }
+
+  const bool persistent;
+
+private:
+  // The fingerprints of the books of the documents, by ordinal (empty
+  // without document).
+  std::vector<std::string> fingerprints;
 };
 
 /* Constructor */
 Library::Library()
-  : m_bookDB(new BookDB)
+  : m_bookDB(new BookDB),
+    m_bookOrdinals(new BookOrdinals),
+    m_facetIndex(new FacetIndex),
+    m_sortIndex(new SortIndex),
+    m_attributeCounter(new AttributeCounter),
+    m_pathIndex(new PathIndex),
+    m_illustrationStore(new IllustrationStore(ILLUSTRATION_CACHE_SIZE)),
+    m_revision(initialRevision()),
+    m_journalStart(m_revision)
 {
 }
 
@@ -76,27 +192,44 @@ Library::~Library()
 bool Library::addBook(const Book& book)
 {
   /* Try to find it */
-  updateBookDB(book);
+  const auto it = m_books.find(book.getId());
+  if (it != m_books.end()
+   && (it->second.readOnly() || it->second == book)) {
+    // Nothing to update.
+    return false;
+  }
+  m_illustrationStore->uncache(book.getId());
+  recordChange(book.getId());
   try {
     auto& oldbook = m_books.at(book.getId());
     oldbook.update(book);
+    oldbook.m_favicon = m_illustrationStore->intern(oldbook.m_favicon);
+    updateBookIndexes(oldbook);
     return false;
   } catch (std::out_of_range&) {
-    m_books[book.getId()] = book;
+    m_bookAddRevisions[book.getId()] = m_revision;
+    auto& newbook = m_books[book.getId()];
+    newbook = book;
+    newbook.m_favicon = m_illustrationStore->intern(newbook.m_favicon);
+    updateBookIndexes(newbook);
     return true;
   }
 }
 
 void Library::addBookmark(const Bookmark& bookmark)
 {
-  m_bookmarks.push_back(bookmark);
+  const auto it = m_bookmarks.insert(m_bookmarks.end(), bookmark);
+  m_bookmarksByBook.emplace(bookmark.getBookId(), it);
 }
 
 bool Library::removeBookmark(const std::string& zimId, const std::string& url)
 {
-  for(auto it=m_bookmarks.begin(); it!=m_bookmarks.end(); it++) {
-    if (it->getBookId() == zimId && it->getUrl() == url) {
-      m_bookmarks.erase(it);
+  // The bookmarks of a book are in insertion order in the index.
+  const auto range = m_bookmarksByBook.equal_range(zimId);
+  for (auto it = range.first; it != range.second; it++) {
+    if (it->second->getUrl() == url) {
+      m_bookmarks.erase(it->second);
+      m_bookmarksByBook.erase(it);
       return true;
     }
   }
@@ -105,12 +238,52 @@ bool Library::removeBookmark(const std::string& zimId, const std::string& url)
 
 
 
+Library::Changes Library::mergeBooks(const std::vector<Book>& books, const Filter& scope)
+{
+  Changes changes;
+  std::set<std::string> bookIds;
+  for (const auto& book : books) {
+    bookIds.insert(book.getId());
+    const auto it = m_books.find(book.getId());
+    if (it == m_books.end()) {
+      addBook(book);
+      changes.addedBooks.push_back(book.getId());
+    } else if (!it->second.readOnly()
+            && it->second != book) {
+      addBook(book);
+      changes.updatedBooks.push_back(book.getId());
+    }
+  }
+  for (const auto& id : filter(scope)) {
+    if (bookIds.find(id) == bookIds.end()) {
+      removeBookById(id);
+      changes.removedBooks.push_back(id);
+    }
+  }
+  return changes;
+}
+
 bool Library::removeBookById(const std::string& id)
 {
-  m_bookDB->delete_document("Q" + id);
+  BookOrdinal ordinal;
+  if (m_bookOrdinals->remove(id, &ordinal)) {
+    m_bookDB->deleteDocument(ordinal);
+    m_facetIndex->remove(ordinal);
+    m_sortIndex->remove(ordinal);
+    m_attributeCounter->remove(ordinal);
+  }
   m_readers.erase(id);
   m_archives.erase(id);
-  return m_books.erase(id) == 1;
+  m_illustrationStore->uncache(id);
+  m_pathIndex->remove(id);
+  m_booksToReindex.erase(id);
+  if (m_books.erase(id) == 0) {
+    return false;
+  }
+  recordChange(id);
+  m_bookRevisions.erase(id);
+  m_bookAddRevisions.erase(id);
+  return true;
 }
 
 const Book& Library::getBookById(const std::string& id) const
@@ -121,15 +294,36 @@ const Book& Library::getBookById(const std::string& id) const
 Book& Library::getBookById(const std::string& id)
 {
   const Library& const_self = *this;
-  return const_cast<Book&>(const_self.getBookById(id));
+  auto& book = const_cast<Book&>(const_self.getBookById(id));
+  // The caller may change the path of the book without calling touchBook().
+  m_booksToReindex.insert(id);
+  return book;
 }
 
 const Book& Library::getBookByPath(const std::string& path) const
 {
-  for(auto& it: m_books) {
-    auto& book = it.second;
-    if (book.getPath() == path)
-      return book;
+  // Read only, so that it can be called from several threads: the books
+  // given by a non const getter are compared with their current path, the
+  // indexed one may be outdated.
+  const auto normalizedPath = normalizePath(path);
+  const std::string* id = nullptr;
+  for (const auto& indexedId : m_pathIndex->getBookIds(normalizedPath)) {
+    if (m_booksToReindex.count(indexedId) == 0) {
+      id = &indexedId;
+      break;
+    }
+  }
+  for (const auto& modifiedId : m_booksToReindex) {
+    if (id && *id < modifiedId) {
+      break;
+    }
+    if (normalizePath(m_books.at(modifiedId).getPath()) == normalizedPath) {
+      id = &modifiedId;
+      break;
+    }
+  }
+  if (id) {
+    return m_books.at(*id);
   }
   std::ostringstream ss;
   ss << "No book with path " << path << " in the library." << std::endl;
@@ -138,8 +332,99 @@ const Book& Library::getBookByPath(const std::string& path) const
 
 Book& Library::getBookByPath(const std::string& path)
 {
+  updatePathIndex();
   const Library& const_self = *this;
-  return const_cast<Book&>(const_self.getBookByPath(path));
+  auto& book = const_cast<Book&>(const_self.getBookByPath(path));
+  // The caller may change the path of the book without calling touchBook().
+  m_booksToReindex.insert(book.getId());
+  return book;
+}
+
+void Library::touchBook(const std::string& id)
+{
+  auto& book = m_books.at(id);
+  m_illustrationStore->uncache(id);
+  recordChange(id);
+  book.m_favicon = m_illustrationStore->intern(book.m_favicon);
+  updateBookIndexes(book);
+}
+
+uint64_t Library::getBookRevision(const std::string& id) const
+{
+  return m_bookRevisions.at(id);
+}
+
+void Library::recordChange(const std::string& id)
+{
+  m_bookRevisions[id] = ++m_revision;
+  if (!m_journal.empty() && m_journal.back().second == id) {
+    m_journal.back().first = m_revision;
+    return;
+  }
+  m_journal.emplace_back(m_revision, id);
+  if (m_journal.size() > JOURNAL_SIZE) {
+    m_journalStart = m_journal.front().first;
+    m_journal.pop_front();
+  }
+}
+
+Library::Changes Library::getChangesSince(uint64_t revision) const
+{
+  Changes changes;
+  if (revision == 0) {
+    changes.addedBooks = getBooksIds();
+    return changes;
+  }
+  if (revision < m_journalStart || revision > m_revision) {
+    std::ostringstream ss;
+    ss << "The changes since the revision " << revision << " are not known." << std::endl;
+    throw std::out_of_range(ss.str());
+  }
+
+  std::set<std::string> changedBooks;
+  for (auto it = m_journal.rbegin(); it != m_journal.rend() && it->first > revision; ++it) {
+    changedBooks.insert(it->second);
+  }
+  for (const auto& id : changedBooks) {
+    const auto it = m_bookAddRevisions.find(id);
+    if (it == m_bookAddRevisions.end()) {
+      changes.removedBooks.push_back(id);
+    } else if (it->second > revision) {
+      changes.addedBooks.push_back(id);
+    } else {
+      changes.updatedBooks.push_back(id);
+    }
+  }
+  return changes;
+}
+
+Library::Changes Library::getChangesSince(uint64_t revision, const Filter& filter) const
+{
+  if (revision == 0) {
+    Changes changes;
+    changes.addedBooks = this->filter(filter);
+    return changes;
+  }
+
+  auto changes = getChangesSince(revision);
+  if (changes.addedBooks.empty() && changes.updatedBooks.empty()) {
+    return changes;
+  }
+  const auto acceptedIds = this->filter(filter);
+  const std::set<std::string> accepted(acceptedIds.begin(), acceptedIds.end());
+  for (auto* ids : {&changes.addedBooks, &changes.updatedBooks}) {
+    BookIdCollection acceptedChanges;
+    for (const auto& id : *ids) {
+      if (accepted.find(id) != accepted.end()) {
+        acceptedChanges.push_back(id);
+      } else {
+        changes.removedBooks.push_back(id);
+      }
+    }
+    ids->swap(acceptedChanges);
+  }
+  std::sort(changes.removedBooks.begin(), changes.removedBooks.end());
+  return changes;
 }
 
 std::shared_ptr<Reader> Library::getReaderById(const std::string& id)
@@ -154,7 +439,7 @@ std::shared_ptr<Reader> Library::getReaderById(const std::string& id)
     return reader;
   } catch (std::out_of_range& e) {}
 
-  auto book = getBookById(id);
+  const auto& book = m_books.at(id);
   if (!book.isPathValid())
     return nullptr;
 
@@ -171,7 +456,7 @@ std::shared_ptr<zim::Archive> Library::getArchiveById(const std::string& id)
     return m_archives.at(id);
   } catch (std::out_of_range& e) {}
 
-  auto book = getBookById(id);
+  const auto& book = m_books.at(id);
   if (!book.isPathValid())
     return nullptr;
 
@@ -180,6 +465,30 @@ std::shared_ptr<zim::Archive> Library::getArchiveById(const std::string& id)
   return sptr;
 }
 
+Illustration Library::getBookIllustration(const std::string& id)
+{
+  const auto& book = m_books.at(id);
+  if (book.m_favicon) {
+    return Illustration{book.getFaviconMimeType(), book.m_favicon};
+  }
+
+  auto illustration = m_illustrationStore->getCached(id);
+  if (illustration.data) {
+    return illustration;
+  }
+  try {
+    const auto archive = getArchiveById(id);
+    std::string content;
+    if (archive && getArchiveFavicon(*archive, content, illustration.mimeType)) {
+      illustration.data = m_illustrationStore->intern(
+        std::make_shared<const std::string>(content));
+      m_illustrationStore->cache(id, illustration);
+      return illustration;
+    }
+  } catch (const std::exception&) {}
+  return Illustration();
+}
+
 unsigned int Library::getBookCount(const bool localBooks,
                                    const bool remoteBooks) const
 {
@@ -194,101 +503,184 @@ unsigned int Library::getBookCount(const bool localBooks,
   return result;
 }
 
+namespace
+{
+
+class XmlFileWriter: public pugi::xml_writer
+{
+  public:
+    explicit XmlFileWriter(FILE* file) : m_file(file) {}
+
+    virtual void write(const void* data, size_t size) {
+      if (fwrite(data, 1, size, m_file) != size) {
+        m_failed = true;
+      }
+    }
+
+    bool failed() const { return m_failed; }
+
+  private:
+    FILE* m_file;
+    bool m_failed = false;
+};
+
+// The end of a library.xml file written by writeToFile()
+const std::string LIBRARY_END_TAG = "</library>";
+
+} // unnamed namespace
+
 bool Library::writeToFile(const std::string& path) const
 {
   auto baseDir = removeLastPathElement(path);
   LibXMLDumper dumper(this);
   dumper.setBaseDir(baseDir);
-  return writeTextFile(path, dumper.dumpLibXMLContent(getBooksIds()));
-}
 
-bool Library::writeBookmarksToFile(const std::string& path) const
-{
-  LibXMLDumper dumper(this);
-  return writeTextFile(path, dumper.dumpLibXMLBookmark());
+  // Write a new file and replace the existing one, so the library file is
+  // never left half written.
+  const auto tmpPath = path + ".tmp";
+  FILE* file = openFile(tmpPath, "wb");
+  if (!file) {
+    return false;
+  }
+  XmlFileWriter writer(file);
+  dumper.dumpLibXMLContent(getBooksIds(), writer);
+  const bool synced = syncFile(file);
+  if (fclose(file) != 0 || !synced || writer.failed()
+   || !moveFile(tmpPath, path)) {
+    remove(tmpPath.c_str());
+    return false;
+  }
+  return true;
 }
 
-std::vector<std::string> Library::getBooksLanguages() const
+bool Library::appendBooksToFile(const std::string& path, const BookIdCollection& bookIds) const
 {
-  std::vector<std::string> booksLanguages;
-  std::map<std::string, bool> booksLanguagesMap;
+  FILE* file = openFile(path, "r+b");
+  if (!file) {
+    return false;
+  }
 
-  for (auto& pair: m_books) {
-    auto& book = pair.second;
-    auto& language = book.getLanguage();
-    if (booksLanguagesMap.find(language) == booksLanguagesMap.end()) {
-      if (book.getOrigId().empty()) {
-        booksLanguagesMap[language] = true;
-        booksLanguages.push_back(language);
+  // Look for the end tag of the library node and write the new books over
+  // it. Only blank characters may follow the end tag.
+  long endTagPos = -1;
+  char tail[256];
+  if (fseek(file, 0, SEEK_END) == 0) {
+    const long fileSize = ftell(file);
+    const long tailSize = std::min<long>(fileSize, sizeof(tail));
+    if (fileSize >= 0
+     && fseek(file, fileSize - tailSize, SEEK_SET) == 0
+     && fread(tail, 1, tailSize, file) == static_cast<size_t>(tailSize)) {
+      const std::string tailStr(tail, tailSize);
+      const auto pos = tailStr.rfind(LIBRARY_END_TAG);
+      if (pos != std::string::npos
+       && tailStr.find_first_not_of(" \t\r\n", pos + LIBRARY_END_TAG.size()) == std::string::npos) {
+        endTagPos = fileSize - tailSize + pos;
       }
     }
   }
+  if (endTagPos < 0 || fseek(file, endTagPos, SEEK_SET) != 0) {
+    fclose(file);
+    return false;
+  }
 
-  return booksLanguages;
+  LibXMLDumper dumper(this);
+  dumper.setBaseDir(removeLastPathElement(path));
+  XmlFileWriter writer(file);
+  dumper.dumpLibXMLBooks(bookIds, writer);
+  // The new content is never shorter than the end tag it replaces.
+  // Remaining blank characters after it are allowed by xml.
+  writer.write(LIBRARY_END_TAG.data(), LIBRARY_END_TAG.size());
+  writer.write("\n", 1);
+  const bool synced = syncFile(file);
+  return fclose(file) == 0 && synced && !writer.failed();
 }
 
-std::vector<std::string> Library::getBooksCategories() const
+bool Library::writeBookmarksToFile(const std::string& path) const
 {
-  std::set<std::string> categories;
+  LibXMLDumper dumper(this);
+  return writeTextFile(path, dumper.dumpLibXMLBookmark());
+}
 
+bool Library::writeSnapshot(const std::string& path) const
+{
+  std::vector<const Book*> books;
+  books.reserve(m_books.size());
   for (const auto& pair: m_books) {
-    const auto& book = pair.second;
-    const auto& c = book.getCategory();
-    if ( !c.empty() ) {
-      categories.insert(c);
-    }
+    books.push_back(&pair.second);
   }
+  return LibrarySnapshot::write(path, books);
+}
 
-  return std::vector<std::string>(categories.begin(), categories.end());
+bool Library::readSnapshot(const std::string& path)
+{
+  std::vector<Book> books;
+  if (!LibrarySnapshot::read(path, books)) {
+    return false;
+  }
+  for (const auto& book: books) {
+    addBook(book);
+  }
+  return true;
 }
 
-std::vector<std::string> Library::getBooksCreators() const
+namespace
 {
-  std::vector<std::string> booksCreators;
-  std::map<std::string, bool> booksCreatorsMap;
 
-  for (auto& pair: m_books) {
-    auto& book = pair.second;
-    auto& creator = book.getCreator();
-    if (booksCreatorsMap.find(creator) == booksCreatorsMap.end()) {
-      if (book.getOrigId().empty()) {
-        booksCreatorsMap[creator] = true;
-        booksCreators.push_back(creator);
-      }
-    }
+std::vector<std::string> getValues(const AttributeCounter::Counts& counts)
+{
+  std::vector<std::string> values;
+  values.reserve(counts.size());
+  for (const auto& pair: counts) {
+    values.push_back(pair.first);
   }
+  return values;
+}
 
-  return booksCreators;
+Library::AttributeCounts getValuesWithCounts(const AttributeCounter::Counts& counts)
+{
+  return Library::AttributeCounts(counts.begin(), counts.end());
 }
 
-std::vector<std::string> Library::getBooksPublishers() const
+} // unnamed namespace
+
+std::vector<std::string> Library::getBooksLanguages() const
 {
-  std::vector<std::string> booksPublishers;
-  std::map<std::string, bool> booksPublishersMap;
+  return getValues(m_attributeCounter->getCounts(AttributeCounter::LANGUAGE));
+}
 
-  for (auto& pair:m_books) {
-    auto& book = pair.second;
-    auto& publisher = book.getPublisher();
-    if (booksPublishersMap.find(publisher) == booksPublishersMap.end()) {
-      if (book.getOrigId().empty()) {
-        booksPublishersMap[publisher] = true;
-        booksPublishers.push_back(publisher);
-      }
-    }
-  }
+Library::AttributeCounts Library::getBooksLanguagesWithCounts() const
+{
+  return getValuesWithCounts(m_attributeCounter->getCounts(AttributeCounter::LANGUAGE));
+}
 
-  return booksPublishers;
+std::vector<std::string> Library::getBooksCategories() const
+{
+  return getValues(m_attributeCounter->getCounts(AttributeCounter::CATEGORY));
+}
+
+Library::AttributeCounts Library::getBooksCategoriesWithCounts() const
+{
+  return getValuesWithCounts(m_attributeCounter->getCounts(AttributeCounter::CATEGORY));
+}
+
+std::vector<std::string> Library::getBooksCreators() const
+{
+  return getValues(m_attributeCounter->getCounts(AttributeCounter::CREATOR));
+}
+
+std::vector<std::string> Library::getBooksPublishers() const
+{
+  return getValues(m_attributeCounter->getCounts(AttributeCounter::PUBLISHER));
 }
 
 const std::vector<kiwix::Bookmark> Library::getBookmarks(bool onlyValidBookmarks) const
 {
   if (!onlyValidBookmarks) {
-    return m_bookmarks;
+    return std::vector<kiwix::Bookmark>(m_bookmarks.begin(), m_bookmarks.end());
   }
   std::vector<kiwix::Bookmark> validBookmarks;
-  auto booksId = getBooksIds();
   for(auto& bookmark:m_bookmarks) {
-    if (std::find(booksId.begin(), booksId.end(), bookmark.getBookId()) != booksId.end()) {
+    if (m_books.find(bookmark.getBookId()) != m_books.end()) {
       validBookmarks.push_back(bookmark);
     }
   }
@@ -316,8 +708,88 @@ Library::BookIdCollection Library::filter(const std::string& search) const
 }
 
 
-void Library::updateBookDB(const Book& book)
+void Library::updateBookIndexes(const Book& book)
+{
+  const auto ordinal = m_bookOrdinals->add(book.getId(), &book);
+  updateBookDB(book, ordinal);
+
+  FacetIndex::Values values;
+  values[FacetIndex::LANGUAGE] = split(normalizeText(book.getLanguage()), ",; ");
+  values[FacetIndex::CATEGORY] = { normalizeText(book.getCategory()) };
+  values[FacetIndex::NAME] = { normalizeText(book.getName()) };
+  values[FacetIndex::TAG] = split(normalizeText(book.getTags()), ";");
+  m_facetIndex->index(ordinal, values);
+  m_sortIndex->index(ordinal, book);
+  m_attributeCounter->index(ordinal, book, values[FacetIndex::LANGUAGE]);
+  m_pathIndex->index(book.getId(), normalizePath(book.getPath()));
+  m_booksToReindex.erase(book.getId());
+}
+
+void Library::updatePathIndex()
+{
+  for (const auto& id : m_booksToReindex) {
+    m_pathIndex->index(id, normalizePath(m_books.at(id).getPath()));
+  }
+  m_booksToReindex.clear();
+}
+
+bool Library::openBookDB(const std::string& path)
 {
+  if ( !m_books.empty() ) {
+    return false;
+  }
+
+  std::unique_ptr<BookDB> bookDB;
+  try {
+    bookDB.reset(new BookDB(path, Xapian::DB_CREATE_OR_OPEN));
+    if ( bookDB->get_metadata(BOOKDB_REVISION_KEY) != BOOKDB_REVISION ) {
+      // Release the lock on the database before overwriting it.
+      bookDB.reset();
+      bookDB.reset(new BookDB(path, Xapian::DB_CREATE_OR_OVERWRITE));
+      bookDB->set_metadata(BOOKDB_REVISION_KEY, BOOKDB_REVISION);
+    }
+  } catch (const Xapian::Error& e) {
+    std::cerr << "Cannot open the book database " << path << ": " << e.get_msg() << std::endl;
+    return false;
+  }
+
+  // The books keep the ordinal they had, so their documents can be reused
+  // without being read again (see updateBookDB()).
+  m_bookOrdinals.reset(new BookOrdinals);
+  for ( auto it = bookDB->postlist_begin(""); it != bookDB->postlist_end(""); ++it ) {
+    const auto docid = *it;
+    const auto doc = bookDB->get_document(docid);
+    const auto ordinal = docidToOrdinal(docid);
+    m_bookOrdinals->reserve(doc.get_data(), ordinal);
+    bookDB->setFingerprint(ordinal, doc.get_value(BOOKDB_FINGERPRINT_SLOT));
+  }
+  m_bookDB = std::move(bookDB);
+  return true;
+}
+
+void Library::commitBookDB()
+{
+  if ( !m_bookDB->persistent ) {
+    return;
+  }
+
+  // Remove the books of the database which have not been added back.
+  for ( const auto& id : m_bookOrdinals->getReservedIds() ) {
+    BookOrdinal ordinal;
+    m_bookOrdinals->remove(id, &ordinal);
+    m_bookDB->deleteDocument(ordinal);
+  }
+  m_bookDB->commit();
+}
+
+void Library::updateBookDB(const Book& book, uint32_t ordinal)
+{
+  // The fingerprint includes the id of the book.
+  const auto fingerprint = bookDBFingerprint(book);
+  if ( m_bookDB->indexes(ordinal, fingerprint) ) {
+    return;
+  }
+
   Xapian::Stem stemmer;
   Xapian::TermGenerator indexer;
   const std::string lang = book.getLanguage();
@@ -353,19 +825,14 @@ void Library::updateBookDB(const Book& book)
   doc.add_boolean_term(idterm);
 
   doc.set_data(book.getId());
+  doc.add_value(BOOKDB_FINGERPRINT_SLOT, fingerprint);
 
-  m_bookDB->replace_document(idterm, doc);
+  m_bookDB->setDocument(ordinal, doc, fingerprint);
 }
 
 namespace
 {
 
-bool willSelectEverything(const Xapian::Query& query)
-{
-  return query.get_type() == Xapian::Query::LEAF_MATCH_ALL;
-}
-
-
 Xapian::Query buildXapianQueryFromFilterQuery(const Filter& filter)
 {
   if ( !filter.hasQuery() || filter.getQuery().empty() ) {
@@ -400,21 +867,6 @@ Xapian::Query buildXapianQueryFromFilterQuery(const Filter& filter)
   return queryParser.parse_query(normalizeText(filter.getQuery()), flags);
 }
 
-Xapian::Query nameQuery(const std::string& name)
-{
-  return Xapian::Query("XN" + normalizeText(name));
-}
-
-Xapian::Query categoryQuery(const std::string& category)
-{
-  return Xapian::Query("XC" + normalizeText(category));
-}
-
-Xapian::Query langQuery(const std::string& lang)
-{
-  return Xapian::Query("L" + normalizeText(lang));
-}
-
 Xapian::Query publisherQuery(const std::string& publisher)
 {
   Xapian::QueryParser queryParser;
@@ -435,157 +887,227 @@ Xapian::Query creatorQuery(const std::string& creator)
   return Xapian::Query(Xapian::Query::OP_PHRASE, q.get_terms_begin(), q.get_terms_end(), q.get_length());
 }
 
-Xapian::Query tagsQuery(const Filter::Tags& acceptTags, const Filter::Tags& rejectTags)
+Xapian::Query buildXapianQuery(const Filter& filter)
 {
-  Xapian::Query q = Xapian::Query(std::string());
-  if (!acceptTags.empty()) {
-    for ( const auto& tag : acceptTags )
-      q &= Xapian::Query("XT" + normalizeText(tag));
+  auto q = buildXapianQueryFromFilterQuery(filter);
+  if ( filter.hasPublisher() ) {
+    q = Xapian::Query(Xapian::Query::OP_AND, q, publisherQuery(filter.getPublisher()));
   }
-
-  if (!rejectTags.empty()) {
-    for ( const auto& tag : rejectTags )
-      q = Xapian::Query(Xapian::Query::OP_AND_NOT, q, "XT" + normalizeText(tag));
+  if ( filter.hasCreator() ) {
+    q = Xapian::Query(Xapian::Query::OP_AND, q, creatorQuery(filter.getCreator()));
   }
   return q;
 }
 
-Xapian::Query buildXapianQuery(const Filter& filter)
+// Text queries, publishers and creators need the full text BookDB.
+// Other criteria are exact matches answered by the FacetIndex.
+bool needsBookDB(const Filter& filter)
 {
-  auto q = buildXapianQueryFromFilterQuery(filter);
+  return (filter.hasQuery() && !filter.getQuery().empty())
+      || filter.hasPublisher()
+      || filter.hasCreator();
+}
+
+bool hasFacets(const Filter& filter)
+{
+  return filter.hasName()
+      || filter.hasCategory()
+      || filter.hasLang()
+      || !filter.getAcceptTags().empty()
+      || !filter.getRejectTags().empty();
+}
+
+BookBitset filterViaFacets(const FacetIndex& index, const Filter& filter)
+{
+  BookBitset books = index.getAllBooks();
   if ( filter.hasName() ) {
-    q = Xapian::Query(Xapian::Query::OP_AND, q, nameQuery(filter.getName()));
+    books &= index.getBooks(FacetIndex::NAME, normalizeText(filter.getName()));
   }
   if ( filter.hasCategory() ) {
-    q = Xapian::Query(Xapian::Query::OP_AND, q, categoryQuery(filter.getCategory()));
+    books &= index.getBooks(FacetIndex::CATEGORY, normalizeText(filter.getCategory()));
   }
   if ( filter.hasLang() ) {
-    q = Xapian::Query(Xapian::Query::OP_AND, q, langQuery(filter.getLang()));
+    books &= index.getBooks(FacetIndex::LANGUAGE, normalizeText(filter.getLang()));
   }
-  if ( filter.hasPublisher() ) {
-    q = Xapian::Query(Xapian::Query::OP_AND, q, publisherQuery(filter.getPublisher()));
-  }
-  if ( filter.hasCreator() ) {
-    q = Xapian::Query(Xapian::Query::OP_AND, q, creatorQuery(filter.getCreator()));
+  for ( const auto& tag : filter.getAcceptTags() ) {
+    books &= index.getBooks(FacetIndex::TAG, normalizeText(tag));
   }
-  if ( !filter.getAcceptTags().empty() || !filter.getRejectTags().empty() ) {
-    const auto tq = tagsQuery(filter.getAcceptTags(), filter.getRejectTags());
-    q = Xapian::Query(Xapian::Query::OP_AND, q, tq);;
+  for ( const auto& tag : filter.getRejectTags() ) {
+    books.andNot(index.getBooks(FacetIndex::TAG, normalizeText(tag)));
   }
-  return q;
+  return books;
 }
 
-} // unnamed namespace
-
-Library::BookIdCollection Library::filterViaBookDB(const Filter& filter) const
+// Keep only the matches accepted by `accept`, so that Xapian counts and
+// pages the final results.
+class BookMatchDecider : public Xapian::MatchDecider
 {
-  const auto query = buildXapianQuery(filter);
+  public:
+    explicit BookMatchDecider(std::function<bool(BookOrdinal)> accept)
+      : m_accept(accept)
+    {}
 
-  if ( willSelectEverything(query) )
-    return getBooksIds();
+    bool operator()(const Xapian::Document& doc) const override
+    {
+      return m_accept(docidToOrdinal(doc.get_docid()));
+    }
 
-  BookIdCollection bookIds;
+  private:
+    std::function<bool(BookOrdinal)> m_accept;
+};
 
-  Xapian::Enquire enquire(*m_bookDB);
+// The BookDB may contain books not added (back) to the library yet (see
+// Library::openBookDB()). They are ignored.
+std::vector<BookOrdinal> filterViaBookDB(const Xapian::Database& bookDB,
+                                         const BookOrdinals& books,
+                                         const Filter& filter)
+{
+  const auto query = buildXapianQuery(filter);
+
+  std::vector<BookOrdinal> ordinals;
+  Xapian::Enquire enquire(bookDB);
   enquire.set_query(query);
-  const auto results = enquire.get_mset(0, m_books.size());
+  const auto results = enquire.get_mset(0, bookDB.get_doccount());
   for ( auto it = results.begin(); it != results.end(); ++it  ) {
-    bookIds.push_back(it.get_document().get_data());
+    const auto ordinal = docidToOrdinal(*it);
+    if ( books.getBook(ordinal) ) {
+      ordinals.push_back(ordinal);
+    }
   }
 
-  return bookIds;
+  return ordinals;
 }
 
+} // unnamed namespace
+
 Library::BookIdCollection Library::filter(const Filter& filter) const
 {
   BookIdCollection result;
-  for(auto id : filterViaBookDB(filter)) {
-    if(filter.accept(m_books.at(id))) {
-      result.push_back(id);
+
+  if ( !needsBookDB(filter) && !hasFacets(filter) ) {
+    for ( const auto& pair : m_books ) {
+      if ( filter.accept(pair.second) ) {
+        result.push_back(pair.first);
+      }
     }
+    return result;
   }
-  return result;
-}
 
-template<supportedListSortBy SORT>
-struct KEY_TYPE {
-  typedef std::string TYPE;
-};
-
-template<>
-struct KEY_TYPE<SIZE> {
-  typedef size_t TYPE;
-};
+  std::vector<BookOrdinal> ordinals;
+  if ( needsBookDB(filter) ) {
+    // Keep the relevance order of the BookDB results.
+    ordinals = filterViaBookDB(*m_bookDB, *m_bookOrdinals, filter);
+    if ( hasFacets(filter) ) {
+      const auto facetBooks = filterViaFacets(*m_facetIndex, filter);
+      ordinals.erase(std::remove_if(ordinals.begin(), ordinals.end(),
+                                    [&](BookOrdinal o) { return !facetBooks.test(o); }),
+                     ordinals.end());
+    }
+  } else {
+    ordinals = filterViaFacets(*m_facetIndex, filter).ordinals();
+  }
 
-template<supportedListSortBy sort>
-class Comparator {
-  private:
-    const Library* const lib;
-    const bool     ascending;
+  for ( auto ordinal : ordinals ) {
+    const auto& book = *m_bookOrdinals->getBook(ordinal);
+    if ( filter.accept(book) ) {
+      result.push_back(book.getId());
+    }
+  }
+  return result;
+}
 
-    inline typename KEY_TYPE<sort>::TYPE get_key(const std::string& id);
+Library::BookIdCollection Library::filter(const Filter& filter,
+                                          supportedListSortBy sortBy,
+                                          bool ascending,
+                                          size_t start,
+                                          size_t count,
+                                          size_t& totalCount) const
+{
+  std::unique_ptr<BookBitset> facetBooks;
+  if ( hasFacets(filter) ) {
+    facetBooks.reset(new BookBitset(filterViaFacets(*m_facetIndex, filter)));
+  }
 
-  public:
-    Comparator(const Library* lib, bool ascending) : lib(lib), ascending(ascending) {}
-    inline bool operator() (const std::string& id1, const std::string& id2) {
-      if (ascending) {
-        return get_key(id1) < get_key(id2);
-      } else {
-        return get_key(id2) < get_key(id1);
+  std::vector<BookOrdinal> ordinals;
+  if ( needsBookDB(filter) && sortBy == UNSORTED ) {
+    // Let Xapian do the paging (in relevance order).
+    // Asking to check all the documents makes the estimated count exact.
+    const BookMatchDecider decider([&](BookOrdinal ordinal) {
+      const auto book = m_bookOrdinals->getBook(ordinal);
+      return book
+          && (!facetBooks || facetBooks->test(ordinal))
+          && filter.accept(*book);
+    });
+    Xapian::Enquire enquire(*m_bookDB);
+    enquire.set_query(buildXapianQuery(filter));
+    const auto results = enquire.get_mset(start, count, m_bookDB->get_doccount(), nullptr, &decider);
+    totalCount = results.get_matches_estimated();
+    for ( auto it = results.begin(); it != results.end(); ++it ) {
+      ordinals.push_back(docidToOrdinal(*it));
+    }
+  } else if ( !needsBookDB(filter) && !facetBooks && sortBy == UNSORTED ) {
+    // Same (id) order as filter().
+    BookIdCollection result;
+    totalCount = 0;
+    for ( const auto& pair : m_books ) {
+      if ( !filter.accept(pair.second) ) {
+        continue;
+      }
+      if ( totalCount >= start && result.size() < count ) {
+        result.push_back(pair.first);
       }
+      totalCount++;
     }
-};
-
-template<>
-std::string Comparator<TITLE>::get_key(const std::string& id)
-{
-  return lib->getBookById(id).getTitle();
-}
+    return result;
+  } else {
+    BookBitset selected;
+    if ( needsBookDB(filter) ) {
+      for ( auto ordinal : filterViaBookDB(*m_bookDB, *m_bookOrdinals, filter) ) {
+        selected.set(ordinal);
+      }
+      if ( facetBooks ) {
+        selected &= *facetBooks;
+      }
+    } else {
+      selected = facetBooks ? *facetBooks : m_facetIndex->getAllBooks();
+    }
+    for ( auto ordinal : selected.ordinals() ) {
+      if ( !filter.accept(*m_bookOrdinals->getBook(ordinal)) ) {
+        selected.reset(ordinal);
+      }
+    }
+    totalCount = selected.count();
+    ordinals = m_sortIndex->getRange(selected, sortBy, ascending, start, count);
+  }
 
-template<>
-size_t Comparator<SIZE>::get_key(const std::string& id)
-{
-  return lib->getBookById(id).getSize();
+  BookIdCollection result;
+  result.reserve(ordinals.size());
+  for ( auto ordinal : ordinals ) {
+    result.push_back(m_bookOrdinals->getBook(ordinal)->getId());
+  }
+  return result;
 }
 
-template<>
-std::string Comparator<DATE>::get_key(const std::string& id)
+void Library::sort(BookIdCollection& bookIds, supportedListSortBy sort, bool ascending) const
 {
-  return lib->getBookById(id).getDate();
-}
+  if (sort == UNSORTED) {
+    return;
+  }
 
-template<>
-std::string Comparator<CREATOR>::get_key(const std::string& id)
-{
-  return lib->getBookById(id).getCreator();
-}
+  std::vector<BookOrdinal> ordinals;
+  ordinals.reserve(bookIds.size());
+  for (const auto& id : bookIds) {
+    BookOrdinal ordinal;
+    if (!m_bookOrdinals->find(id, &ordinal)) {
+      throw std::out_of_range("Unknown book id " + id);
+    }
+    ordinals.push_back(ordinal);
+  }
 
-template<>
-std::string Comparator<PUBLISHER>::get_key(const std::string& id)
-{
-  return lib->getBookById(id).getPublisher();
-}
+  m_sortIndex->sort(ordinals, sort, ascending);
 
-void Library::sort(BookIdCollection& bookIds, supportedListSortBy sort, bool ascending) const
-{
-  switch(sort) {
-    case TITLE:
-      std::sort(bookIds.begin(), bookIds.end(), Comparator<TITLE>(this, ascending));
-      break;
-    case SIZE:
-      std::sort(bookIds.begin(), bookIds.end(), Comparator<SIZE>(this, ascending));
-      break;
-    case DATE:
-      std::sort(bookIds.begin(), bookIds.end(), Comparator<DATE>(this, ascending));
-      break;
-    case CREATOR:
-      std::sort(bookIds.begin(), bookIds.end(), Comparator<CREATOR>(this, ascending));
-      break;
-    case PUBLISHER:
-      std::sort(bookIds.begin(), bookIds.end(), Comparator<PUBLISHER>(this, ascending));
-      break;
-    default:
-      break;
+  for (size_t i = 0; i < ordinals.size(); i++) {
+    bookIds[i] = m_bookOrdinals->getBook(ordinals[i])->getId();
   }
 }
 
@@ -0,0 +1,498 @@
+/*
+ * Copyright 2021 Kiwix <contact@kiwix.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU  General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include "library_index.h"
+#include "book.h"
+#include "tools/stringTools.h"
+
+#include <algorithm>
+
+#include <unicode/locid.h>
+
+namespace kiwix
+{
+
+namespace
+{
+
+const size_t WORD_BITS = 64;
+
+inline unsigned popCount(uint64_t word)
+{
+#if defined(__GNUC__)
+  return __builtin_popcountll(word);
+#else
+  unsigned count = 0;
+  for (; word; word &= word - 1) {
+    count++;
+  }
+  return count;
+#endif
+}
+
+inline unsigned lowestBit(uint64_t word)
+{
+#if defined(__GNUC__)
+  return __builtin_ctzll(word);
+#else
+  unsigned bit = 0;
+  while (!(word & 1)) {
+    word >>= 1;
+    bit++;
+  }
+  return bit;
+#endif
+}
+
+} // unnamed namespace
+
+void BookBitset::set(BookOrdinal ordinal)
+{
+  const size_t word = ordinal / WORD_BITS;
+  if (word >= m_words.size()) {
+    m_words.resize(word + 1, 0);
+  }
+  m_words[word] |= uint64_t(1) << (ordinal % WORD_BITS);
+}
+
+void BookBitset::reset(BookOrdinal ordinal)
+{
+  const size_t word = ordinal / WORD_BITS;
+  if (word < m_words.size()) {
+    m_words[word] &= ~(uint64_t(1) << (ordinal % WORD_BITS));
+  }
+}
+
+bool BookBitset::test(BookOrdinal ordinal) const
+{
+  const size_t word = ordinal / WORD_BITS;
+  return word < m_words.size()
+      && (m_words[word] >> (ordinal % WORD_BITS)) & 1;
+}
+
+size_t BookBitset::count() const
+{
+  size_t count = 0;
+  for (auto word : m_words) {
+    count += popCount(word);
+  }
+  return count;
+}
+
+BookBitset& BookBitset::operator&=(const BookBitset& other)
+{
+  if (m_words.size() > other.m_words.size()) {
+    m_words.resize(other.m_words.size());
+  }
+  for (size_t i = 0; i < m_words.size(); i++) {
+    m_words[i] &= other.m_words[i];
+  }
+  return *this;
+}
+
+BookBitset& BookBitset::operator|=(const BookBitset& other)
+{
+  if (m_words.size() < other.m_words.size()) {
+    m_words.resize(other.m_words.size(), 0);
+  }
+  for (size_t i = 0; i < other.m_words.size(); i++) {
+    m_words[i] |= other.m_words[i];
+  }
+  return *this;
+}
+
+BookBitset& BookBitset::andNot(const BookBitset& other)
+{
+  const auto size = std::min(m_words.size(), other.m_words.size());
+  for (size_t i = 0; i < size; i++) {
+    m_words[i] &= ~other.m_words[i];
+  }
+  return *this;
+}
+
+std::vector<BookOrdinal> BookBitset::ordinals() const
+{
+  std::vector<BookOrdinal> result;
+  result.reserve(count());
+  for (size_t i = 0; i < m_words.size(); i++) {
+    for (auto word = m_words[i]; word; word &= word - 1) {
+      result.push_back(i * WORD_BITS + lowestBit(word));
+    }
+  }
+  return result;
+}
+
+std::vector<BookOrdinal> BookBitset::ordinals(size_t start, size_t count) const
+{
+  std::vector<BookOrdinal> result;
+  size_t i = 0;
+  // Skip whole words as long as possible.
+  for (; i < m_words.size(); i++) {
+    const auto wordCount = popCount(m_words[i]);
+    if (wordCount > start) {
+      break;
+    }
+    start -= wordCount;
+  }
+  for (; i < m_words.size() && result.size() < count; i++) {
+    for (auto word = m_words[i]; word && result.size() < count; word &= word - 1) {
+      if (start) {
+        start--;
+        continue;
+      }
+      result.push_back(i * WORD_BITS + lowestBit(word));
+    }
+  }
+  return result;
+}
+
+BookOrdinal BookOrdinals::add(const std::string& id, const Book* book)
+{
+  BookOrdinal ordinal;
+  if (find(id, &ordinal)) {
+    m_books[ordinal] = book;
+    return ordinal;
+  }
+  if (m_freeOrdinals.empty()) {
+    ordinal = m_books.size();
+    m_books.push_back(book);
+  } else {
+    ordinal = m_freeOrdinals.back();
+    m_freeOrdinals.pop_back();
+    m_books[ordinal] = book;
+  }
+  m_ordinals[id] = ordinal;
+  return ordinal;
+}
+
+bool BookOrdinals::remove(const std::string& id, BookOrdinal* ordinal)
+{
+  auto it = m_ordinals.find(id);
+  if (it == m_ordinals.end()) {
+    return false;
+  }
+  *ordinal = it->second;
+  m_books[it->second] = nullptr;
+  m_freeOrdinals.push_back(it->second);
+  m_ordinals.erase(it);
+  return true;
+}
+
+bool BookOrdinals::find(const std::string& id, BookOrdinal* ordinal) const
+{
+  auto it = m_ordinals.find(id);
+  if (it == m_ordinals.end()) {
+    return false;
+  }
+  *ordinal = it->second;
+  return true;
+}
+
+void BookOrdinals::reserve(const std::string& id, BookOrdinal ordinal)
+{
+  if (ordinal >= m_books.size()) {
+    for (BookOrdinal free = m_books.size(); free < ordinal; free++) {
+      m_freeOrdinals.push_back(free);
+    }
+    m_books.resize(ordinal + 1, nullptr);
+  } else {
+    m_freeOrdinals.erase(std::remove(m_freeOrdinals.begin(), m_freeOrdinals.end(), ordinal),
+                         m_freeOrdinals.end());
+  }
+  m_ordinals[id] = ordinal;
+}
+
+std::vector<std::string> BookOrdinals::getReservedIds() const
+{
+  std::vector<std::string> ids;
+  for (const auto& pair : m_ordinals) {
+    if (!m_books[pair.second]) {
+      ids.push_back(pair.first);
+    }
+  }
+  return ids;
+}
+
+void FacetIndex::index(BookOrdinal ordinal, const Values& values)
+{
+  remove(ordinal);
+  if (ordinal >= m_bookValues.size()) {
+    m_bookValues.resize(ordinal + 1);
+  }
+  auto& bookValues = m_bookValues[ordinal];
+  for (int facet = 0; facet < FACET_COUNT; facet++) {
+    for (const auto& value : values[facet]) {
+      if (value.empty()) {
+        continue;
+      }
+      auto& books = m_sets[facet][value];
+      if (books.test(ordinal)) {
+        continue;
+      }
+      books.set(ordinal);
+      bookValues.push_back(std::make_pair(Facet(facet), value));
+    }
+  }
+  m_allBooks.set(ordinal);
+}
+
+void FacetIndex::remove(BookOrdinal ordinal)
+{
+  if (ordinal >= m_bookValues.size()) {
+    return;
+  }
+  for (const auto& facetValue : m_bookValues[ordinal]) {
+    auto& sets = m_sets[facetValue.first];
+    auto it = sets.find(facetValue.second);
+    it->second.reset(ordinal);
+    if (it->second.count() == 0) {
+      sets.erase(it);
+    }
+  }
+  m_bookValues[ordinal].clear();
+  m_allBooks.reset(ordinal);
+}
+
+const BookBitset& FacetIndex::getBooks(Facet facet, const std::string& value) const
+{
+  static const BookBitset emptySet;
+  const auto it = m_sets[facet].find(value);
+  return it == m_sets[facet].end() ? emptySet : it->second;
+}
+
+void PathIndex::index(const std::string& id, const std::string& path)
+{
+  const auto it = m_paths.find(id);
+  if (it != m_paths.end()) {
+    if (it->second == path) {
+      return;
+    }
+    remove(id);
+  }
+  m_paths[id] = path;
+  m_bookIds[path].insert(id);
+}
+
+void PathIndex::remove(const std::string& id)
+{
+  const auto it = m_paths.find(id);
+  if (it == m_paths.end()) {
+    return;
+  }
+  auto& ids = m_bookIds[it->second];
+  ids.erase(id);
+  if (ids.empty()) {
+    m_bookIds.erase(it->second);
+  }
+  m_paths.erase(it);
+}
+
+const std::set<std::string>& PathIndex::getBookIds(const std::string& path) const
+{
+  static const std::set<std::string> noIds;
+  const auto it = m_bookIds.find(path);
+  return it == m_bookIds.end() ? noIds : it->second;
+}
+
+void AttributeCounter::add(BookOrdinal ordinal, Attribute attribute, const std::string& value)
+{
+  m_counts[attribute][value]++;
+  m_bookValues[ordinal].push_back(std::make_pair(attribute, value));
+}
+
+void AttributeCounter::index(BookOrdinal ordinal, const Book& book,
+                             const std::vector<std::string>& languages)
+{
+  remove(ordinal);
+  if (m_bookValues.size() <= ordinal) {
+    m_bookValues.resize(ordinal + 1);
+  }
+
+  if (book.getOrigId().empty()) {
+    // A book listing a language twice is still counted once for it.
+    const std::set<std::string> uniqueLanguages(languages.begin(), languages.end());
+    for (const auto& language : uniqueLanguages) {
+      add(ordinal, LANGUAGE, language);
+    }
+    add(ordinal, CREATOR, book.getCreator());
+    add(ordinal, PUBLISHER, book.getPublisher());
+  }
+  if (!book.getCategory().empty()) {
+    add(ordinal, CATEGORY, book.getCategory());
+  }
+}
+
+void AttributeCounter::remove(BookOrdinal ordinal)
+{
+  if (ordinal >= m_bookValues.size()) {
+    return;
+  }
+  for (const auto& attributeValue : m_bookValues[ordinal]) {
+    auto& counts = m_counts[attributeValue.first];
+    auto it = counts.find(attributeValue.second);
+    if (--it->second == 0) {
+      counts.erase(it);
+    }
+  }
+  m_bookValues[ordinal].clear();
+}
+
+namespace
+{
+
+template<typename Iterator>
+std::vector<BookOrdinal> selectRange(Iterator begin, Iterator end, const BookBitset& selected,
+                                     size_t start, size_t count)
+{
+  std::vector<BookOrdinal> result;
+  for (auto it = begin; it != end && result.size() < count; ++it) {
+    if (!selected.test(*it)) {
+      continue;
+    }
+    if (start) {
+      start--;
+      continue;
+    }
+    result.push_back(*it);
+  }
+  return result;
+}
+
+} // unnamed namespace
+
+SortIndex::SortIndex()
+{
+  for (size_t sortBy = 0; sortBy < SORT_COUNT; sortBy++) {
+    m_orderings[sortBy] = Ordering(KeyLess{&m_keys[sortBy]});
+  }
+}
+
+SortIndex::~SortIndex() = default;
+
+bool SortIndex::KeyLess::operator()(BookOrdinal a, BookOrdinal b) const
+{
+  const int c = (*keys)[a].compare((*keys)[b]);
+  return c < 0 || (c == 0 && a < b);
+}
+
+std::string SortIndex::titleKey(const std::string& title)
+{
+  if (!m_collator) {
+    loadICUExternalTables();
+    UErrorCode status = U_ZERO_ERROR;
+    m_collator.reset(icu::Collator::createInstance(icu::Locale::getRoot(), status));
+    if (U_FAILURE(status)) {
+      m_collator.reset();
+      return title;
+    }
+  }
+  const auto ustring = icu::UnicodeString::fromUTF8(title);
+  const int32_t size = m_collator->getSortKey(ustring, nullptr, 0);
+  std::string key(size, '\0');
+  m_collator->getSortKey(ustring, reinterpret_cast<uint8_t*>(&key[0]), size);
+  // Drop the terminating null byte
+  if (!key.empty()) {
+    key.pop_back();
+  }
+  return key;
+}
+
+void SortIndex::index(BookOrdinal ordinal, const Book& book)
+{
+  remove(ordinal);
+
+  // Big endian encoding, so keys compare as the numbers do.
+  std::string sizeKey(8, '\0');
+  for (int i = 0; i < 8; i++) {
+    sizeKey[7 - i] = char((book.getSize() >> (8 * i)) & 0xFF);
+  }
+
+  std::string keys[SORT_COUNT];
+  keys[TITLE] = titleKey(book.getTitle());
+  keys[SIZE] = sizeKey;
+  keys[DATE] = book.getDate();
+  keys[CREATOR] = book.getCreator();
+  keys[PUBLISHER] = book.getPublisher();
+
+  for (size_t sortBy = TITLE; sortBy < SORT_COUNT; sortBy++) {
+    if (m_keys[sortBy].size() <= ordinal) {
+      m_keys[sortBy].resize(ordinal + 1);
+    }
+    m_keys[sortBy][ordinal] = std::move(keys[sortBy]);
+    m_orderings[sortBy].insert(ordinal);
+  }
+  m_indexedBooks.set(ordinal);
+}
+
+void SortIndex::remove(BookOrdinal ordinal)
+{
+  if (!m_indexedBooks.test(ordinal)) {
+    return;
+  }
+  for (size_t sortBy = TITLE; sortBy < SORT_COUNT; sortBy++) {
+    // Must be done while the key is still the one used for the insertion.
+    m_orderings[sortBy].erase(ordinal);
+    m_keys[sortBy][ordinal].clear();
+  }
+  m_indexedBooks.reset(ordinal);
+}
+
+void SortIndex::sort(std::vector<BookOrdinal>& ordinals, supportedListSortBy sortBy, bool ascending) const
+{
+  if (sortBy == UNSORTED || sortBy >= SORT_COUNT) {
+    return;
+  }
+  const auto& ordering = m_orderings[sortBy];
+
+  BookBitset selected;
+  for (auto ordinal : ordinals) {
+    selected.set(ordinal);
+  }
+
+  // Walking the whole ordering costs O(library size). For small subsets (or
+  // if some books are present several times), sort using the keys instead.
+  const bool smallSubset = ordinals.size() * 16 < ordering.size();
+  if (smallSubset || selected.count() != ordinals.size()) {
+    KeyLess less{&m_keys[sortBy]};
+    if (ascending) {
+      std::sort(ordinals.begin(), ordinals.end(), less);
+    } else {
+      std::sort(ordinals.begin(), ordinals.end(),
+                [&](BookOrdinal a, BookOrdinal b) { return less(b, a); });
+    }
+    return;
+  }
+
+  ordinals = getRange(selected, sortBy, ascending, 0, ordinals.size());
+}
+
+std::vector<BookOrdinal> SortIndex::getRange(const BookBitset& selected,
+                                             supportedListSortBy sortBy, bool ascending,
+                                             size_t start, size_t count) const
+{
+  if (sortBy == UNSORTED || sortBy >= SORT_COUNT) {
+    return selected.ordinals(start, count);
+  }
+  const auto& ordering = m_orderings[sortBy];
+  return ascending
+       ? selectRange(ordering.begin(), ordering.end(), selected, start, count)
+       : selectRange(ordering.rbegin(), ordering.rend(), selected, start, count);
+}
+
+}
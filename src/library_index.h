@@ -0,0 +1,236 @@
+/*
+ * Copyright 2021 Kiwix <contact@kiwix.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU  General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef KIWIX_LIBRARY_INDEX_H
+#define KIWIX_LIBRARY_INDEX_H
+
+#include "library.h"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <unicode/coll.h>
+
+namespace kiwix
+{
+
+class Book;
+
+/* Books of a library are identified by a small integer (their ordinal) in
+ * the indexes. Ordinals of removed books are reused. */
+typedef uint32_t BookOrdinal;
+
+/**
+ * A set of books, stored as a bitset indexed by the book ordinals.
+ */
+class BookBitset
+{
+  public:
+    void set(BookOrdinal ordinal);
+    void reset(BookOrdinal ordinal);
+    bool test(BookOrdinal ordinal) const;
+
+    /* Number of books in the set. */
+    size_t count() const;
+
+    BookBitset& operator&=(const BookBitset& other);
+    BookBitset& operator|=(const BookBitset& other);
+    /* Remove from this set all the books present in `other`. */
+    BookBitset& andNot(const BookBitset& other);
+
+    /* The ordinals of the set, in increasing order. */
+    std::vector<BookOrdinal> ordinals() const;
+    /* At most `count` ordinals of the set, skipping the `start` first ones. */
+    std::vector<BookOrdinal> ordinals(size_t start, size_t count) const;
+
+  private:
+    std::vector<uint64_t> m_words;
+};
+
+/**
+ * Map book ids to ordinals (and ordinals to books).
+ */
+class BookOrdinals
+{
+  public:
+    /* Return the ordinal of the book, allocating one if the book is new. */
+    BookOrdinal add(const std::string& id, const Book* book);
+    /* Release the ordinal of a book. Return false if the book is unknown. */
+    bool remove(const std::string& id, BookOrdinal* ordinal);
+    bool find(const std::string& id, BookOrdinal* ordinal) const;
+
+    /* Assign `ordinal` to the book `id` before the book itself is added.
+     * Until then, getBook(ordinal) returns nullptr. */
+    void reserve(const std::string& id, BookOrdinal ordinal);
+    /* The ids of the reserved ordinals with no book. */
+    std::vector<std::string> getReservedIds() const;
+
+    const Book* getBook(BookOrdinal ordinal) const { return m_books[ordinal]; }
+
+  private:
+    std::unordered_map<std::string, BookOrdinal> m_ordinals;
+    std::vector<const Book*> m_books;
+    std::vector<BookOrdinal> m_freeOrdinals;
+};
+
+/**
+ * Sets of books sharing the same value of an exact-match facet.
+ *
+ * Values are stored as given (normalized by the caller).
+ * The index keeps track of the values of each book, so a book can be
+ * (re)indexed or removed without knowing its previous values.
+ */
+class FacetIndex
+{
+  public:
+    enum Facet {
+      LANGUAGE,
+      CATEGORY,
+      NAME,
+      TAG,
+      FACET_COUNT
+    };
+
+    typedef std::vector<std::string> Values[FACET_COUNT];
+
+    void index(BookOrdinal ordinal, const Values& values);
+    void remove(BookOrdinal ordinal);
+
+    /* The books having the `value` for `facet` (possibly an empty set). */
+    const BookBitset& getBooks(Facet facet, const std::string& value) const;
+    const BookBitset& getAllBooks() const { return m_allBooks; }
+
+  private:
+    std::unordered_map<std::string, BookBitset> m_sets[FACET_COUNT];
+    std::vector<std::vector<std::pair<Facet, std::string>>> m_bookValues;
+    BookBitset m_allBooks;
+};
+
+/**
+ * The books of each path.
+ *
+ * Paths are stored as given (normalized by the caller). Several books may
+ * share the same path.
+ */
+class PathIndex
+{
+  public:
+    void index(const std::string& id, const std::string& path);
+    void remove(const std::string& id);
+
+    /* The ids of the books having `path`, in id order (possibly none). */
+    const std::set<std::string>& getBookIds(const std::string& path) const;
+
+  private:
+    std::unordered_map<std::string, std::set<std::string>> m_bookIds;
+    // The indexed path of each book.
+    std::unordered_map<std::string, std::string> m_paths;
+};
+
+/**
+ * Number of books having each value of some book attributes.
+ *
+ * Only the books without origId are counted for languages, creators and
+ * publishers, and empty categories are not counted. The languages of a book
+ * are given by the caller, split and normalized as in the FacetIndex so that
+ * each counted language can be used as a language filter.
+ */
+class AttributeCounter
+{
+  public:
+    enum Attribute {
+      LANGUAGE,
+      CATEGORY,
+      CREATOR,
+      PUBLISHER,
+      ATTRIBUTE_COUNT
+    };
+
+    typedef std::map<std::string, size_t> Counts;
+
+    void index(BookOrdinal ordinal, const Book& book,
+               const std::vector<std::string>& languages);
+    void remove(BookOrdinal ordinal);
+
+    const Counts& getCounts(Attribute attribute) const { return m_counts[attribute]; }
+
+  private:
+    void add(BookOrdinal ordinal, Attribute attribute, const std::string& value);
+
+    Counts m_counts[ATTRIBUTE_COUNT];
+    // The values counted for each book.
+    std::vector<std::vector<std::pair<Attribute, std::string>>> m_bookValues;
+};
+
+/**
+ * Orderings of the books for each supported sort criteria.
+ *
+ * Sort keys are computed once when a book is indexed (ICU collation keys for
+ * the titles), and each ordering is kept up to date as books are indexed or
+ * removed.
+ */
+class SortIndex
+{
+  public:
+    SortIndex();
+    ~SortIndex();
+    SortIndex(const SortIndex&) = delete;
+    SortIndex& operator=(const SortIndex&) = delete;
+
+    void index(BookOrdinal ordinal, const Book& book);
+    void remove(BookOrdinal ordinal);
+
+    /* Sort the (indexed) books in `ordinals`.
+     * Books with the same key are in ordinal order (reversed by a descending
+     * sort). The ordinals being reused, this is not the order of addition. */
+    void sort(std::vector<BookOrdinal>& ordinals, supportedListSortBy sortBy, bool ascending) const;
+
+    /* The books of `selected`, sorted, skipping the `start` first ones and
+     * returning at most `count` of them. */
+    std::vector<BookOrdinal> getRange(const BookBitset& selected,
+                                      supportedListSortBy sortBy, bool ascending,
+                                      size_t start, size_t count) const;
+
+  private:
+    static const size_t SORT_COUNT = PUBLISHER + 1;
+
+    typedef std::vector<std::string> Keys;
+    struct KeyLess {
+      const Keys* keys;
+      bool operator()(BookOrdinal a, BookOrdinal b) const;
+    };
+    typedef std::set<BookOrdinal, KeyLess> Ordering;
+
+    std::string titleKey(const std::string& title);
+
+    std::unique_ptr<icu::Collator> m_collator;
+    BookBitset m_indexedBooks;
+    // The sort keys of the books, by ordinal.
+    Keys m_keys[SORT_COUNT];
+    Ordering m_orderings[SORT_COUNT];
+};
+
+}
+
+#endif // KIWIX_LIBRARY_INDEX_H
@@ -0,0 +1,342 @@
+/*
+ * Copyright 2021 Kiwix <contact@kiwix.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU  General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include "library_snapshot.h"
+#include "book.h"
+
+#include "tools/pathTools.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <unordered_map>
+
+#ifdef _WIN32
+# include <iterator>
+#else
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+namespace kiwix
+{
+
+namespace
+{
+
+const char MAGIC[8] = {'K', 'X', 'L', 'I', 'B', 'S', 'N', 'P'};
+const uint32_t VERSION = 2;
+
+/* Header:
+ *   magic (8 bytes), version (u32), record size (u32), book count (u64),
+ *   strings offset (u64), strings size (u64),
+ *   blobs offset (u64), blobs size (u64)
+ * Book record:
+ *   for each string field: offset (u32) and size (u32) in the strings,
+ *   article count (u64), media count (u64), size (u64),
+ *   favicon offset (u64) and size (u64) in the blobs,
+ *   flags (u32), integrity status (u32),
+ *   integrity file size (u64) and modification time (u64)
+ */
+const size_t HEADER_SIZE = 8 + 4 + 4 + 5 * 8;
+const uint32_t FLAG_READONLY = 1;
+
+size_t recordSize(size_t stringFieldCount)
+{
+  return stringFieldCount * 8 + 3 * 8 + 2 * 8 + 4 + 4 + 2 * 8;
+}
+
+void putUint32(std::string& out, uint32_t value)
+{
+  for (unsigned i = 0; i < 4; i++) {
+    out += static_cast<char>((value >> (8 * i)) & 0xff);
+  }
+}
+
+void putUint64(std::string& out, uint64_t value)
+{
+  for (unsigned i = 0; i < 8; i++) {
+    out += static_cast<char>((value >> (8 * i)) & 0xff);
+  }
+}
+
+uint32_t getUint32(const char* data)
+{
+  uint32_t value = 0;
+  for (unsigned i = 0; i < 4; i++) {
+    value |= static_cast<uint32_t>(static_cast<unsigned char>(data[i])) << (8 * i);
+  }
+  return value;
+}
+
+uint64_t getUint64(const char* data)
+{
+  uint64_t value = 0;
+  for (unsigned i = 0; i < 8; i++) {
+    value |= static_cast<uint64_t>(static_cast<unsigned char>(data[i])) << (8 * i);
+  }
+  return value;
+}
+
+/* Strings stored only once, whatever the number of books using them. */
+class StringTable
+{
+  public:
+    bool add(const std::string& value, std::string& record)
+    {
+      auto it = m_offsets.find(value);
+      if (it == m_offsets.end()) {
+        if (m_data.size() + value.size() > std::numeric_limits<uint32_t>::max()) {
+          return false;
+        }
+        it = m_offsets.emplace(value, static_cast<uint32_t>(m_data.size())).first;
+        m_data += value;
+      }
+      putUint32(record, it->second);
+      putUint32(record, static_cast<uint32_t>(value.size()));
+      return true;
+    }
+
+    const std::string& data() const { return m_data; }
+
+  private:
+    std::unordered_map<std::string, uint32_t> m_offsets;
+    std::string m_data;
+};
+
+/* A read only view of a whole file. The file is mapped in memory when
+ * possible, else it is read. */
+class FileView
+{
+  public:
+    explicit FileView(const std::string& path)
+    {
+#ifdef _WIN32
+      std::ifstream in(path, std::ios::binary);
+      if (in) {
+        m_content.assign(std::istreambuf_iterator<char>(in),
+                         std::istreambuf_iterator<char>());
+        m_data = m_content.data();
+        m_size = m_content.size();
+        m_valid = !in.bad();
+      }
+#else
+      const int fd = ::open(path.c_str(), O_RDONLY);
+      if (fd == -1) {
+        return;
+      }
+      struct stat st;
+      if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* addr = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED) {
+          m_data = static_cast<const char*>(addr);
+          m_size = st.st_size;
+          m_valid = true;
+        }
+      }
+      ::close(fd);
+#endif
+    }
+
+    ~FileView()
+    {
+#ifndef _WIN32
+      if (m_valid) {
+        ::munmap(const_cast<char*>(m_data), m_size);
+      }
+#endif
+    }
+
+    FileView(const FileView&) = delete;
+    FileView& operator=(const FileView&) = delete;
+
+    bool valid() const { return m_valid; }
+    const char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+  private:
+#ifdef _WIN32
+    std::string m_content;
+#endif
+    const char* m_data = nullptr;
+    size_t m_size = 0;
+    bool m_valid = false;
+};
+
+} // unnamed namespace
+
+const std::vector<std::string Book::*>& LibrarySnapshot::stringFields()
+{
+  static const std::vector<std::string Book::*> fields {
+    &Book::m_id,
+    &Book::m_downloadId,
+    &Book::m_path,
+    &Book::m_title,
+    &Book::m_description,
+    &Book::m_category,
+    &Book::m_language,
+    &Book::m_creator,
+    &Book::m_publisher,
+    &Book::m_date,
+    &Book::m_url,
+    &Book::m_name,
+    &Book::m_flavour,
+    &Book::m_tags,
+    &Book::m_origId,
+    &Book::m_faviconUrl,
+    &Book::m_faviconMimeType
+  };
+  return fields;
+}
+
+bool LibrarySnapshot::write(const std::string& path, const std::vector<const Book*>& books)
+{
+  const auto& fields = stringFields();
+  StringTable strings;
+  std::string records;
+  std::string blobs;
+  records.reserve(books.size() * recordSize(fields.size()));
+
+  for (const auto book : books) {
+    for (const auto field : fields) {
+      if (!strings.add(book->*field, records)) {
+        return false;
+      }
+    }
+    putUint64(records, book->m_articleCount);
+    putUint64(records, book->m_mediaCount);
+    putUint64(records, book->m_size);
+    // Use the favicon as stored, getFavicon() may download it.
+    const auto faviconSize = book->m_favicon ? book->m_favicon->size() : 0;
+    putUint64(records, blobs.size());
+    putUint64(records, faviconSize);
+    if (faviconSize) {
+      blobs += *book->m_favicon;
+    }
+    putUint32(records, book->m_readOnly ? FLAG_READONLY : 0);
+    putUint32(records, book->m_integrity.status);
+    putUint64(records, book->m_integrity.fileSize);
+    putUint64(records, book->m_integrity.fileMtime);
+  }
+
+  std::string header(MAGIC, sizeof(MAGIC));
+  putUint32(header, VERSION);
+  putUint32(header, recordSize(fields.size()));
+  putUint64(header, books.size());
+  const uint64_t stringsOffset = HEADER_SIZE + records.size();
+  putUint64(header, stringsOffset);
+  putUint64(header, strings.data().size());
+  putUint64(header, stringsOffset + strings.data().size());
+  putUint64(header, blobs.size());
+
+  // A snapshot may be mapped by another process. Never modify it in place.
+  const std::string tmpPath = path + ".tmp";
+  {
+    std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+    out.write(header.data(), header.size());
+    out.write(records.data(), records.size());
+    out.write(strings.data().data(), strings.data().size());
+    out.write(blobs.data(), blobs.size());
+    out.close();
+    if (!out) {
+      std::remove(tmpPath.c_str());
+      return false;
+    }
+  }
+  if (!moveFile(tmpPath, path)) {
+    std::remove(tmpPath.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool LibrarySnapshot::read(const std::string& path, std::vector<Book>& books)
+{
+  books.clear();
+  const FileView file(path);
+  if (!file.valid() || file.size() < HEADER_SIZE) {
+    return false;
+  }
+
+  const char* data = file.data();
+  const auto& fields = stringFields();
+  const size_t bookRecordSize = recordSize(fields.size());
+  if (std::memcmp(data, MAGIC, sizeof(MAGIC)) != 0
+   || getUint32(data + 8) != VERSION
+   || getUint32(data + 12) != bookRecordSize) {
+    return false;
+  }
+  const uint64_t bookCount = getUint64(data + 16);
+  const uint64_t stringsOffset = getUint64(data + 24);
+  const uint64_t stringsSize = getUint64(data + 32);
+  const uint64_t blobsOffset = getUint64(data + 40);
+  const uint64_t blobsSize = getUint64(data + 48);
+  if (bookCount > (file.size() - HEADER_SIZE) / bookRecordSize
+   || stringsOffset != HEADER_SIZE + bookCount * bookRecordSize
+   || stringsSize > file.size() - stringsOffset
+   || blobsOffset != stringsOffset + stringsSize
+   || blobsSize != file.size() - blobsOffset) {
+    return false;
+  }
+  const char* strings = data + stringsOffset;
+  const char* blobs = data + blobsOffset;
+
+  books.resize(bookCount);
+  const char* record = data + HEADER_SIZE;
+  for (auto& book : books) {
+    for (const auto field : fields) {
+      const uint64_t offset = getUint32(record);
+      const uint64_t size = getUint32(record + 4);
+      record += 8;
+      if (offset + size > stringsSize) {
+        books.clear();
+        return false;
+      }
+      (book.*field).assign(strings + offset, size);
+    }
+    book.m_articleCount = getUint64(record);
+    book.m_mediaCount = getUint64(record + 8);
+    book.m_size = getUint64(record + 16);
+    const uint64_t faviconOffset = getUint64(record + 24);
+    const uint64_t faviconSize = getUint64(record + 32);
+    if (faviconOffset > blobsSize || faviconSize > blobsSize - faviconOffset) {
+      books.clear();
+      return false;
+    }
+    book.setFavicon(std::string(blobs + faviconOffset, faviconSize));
+    book.m_readOnly = getUint32(record + 40) & FLAG_READONLY;
+    const auto integrityStatus = getUint32(record + 44);
+    if (integrityStatus > Book::Integrity::NO_CHECKSUM) {
+      books.clear();
+      return false;
+    }
+    book.m_integrity.status = static_cast<Book::Integrity::Status>(integrityStatus);
+    book.m_integrity.fileSize = getUint64(record + 48);
+    book.m_integrity.fileMtime = getUint64(record + 56);
+    book.m_pathValid = fileExists(book.m_path);
+    record += 64;
+  }
+  return true;
+}
+
+}
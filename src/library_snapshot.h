@@ -0,0 +1,58 @@
+/*
+ * Copyright 2021 Kiwix <contact@kiwix.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU  General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef KIWIX_LIBRARY_SNAPSHOT_H
+#define KIWIX_LIBRARY_SNAPSHOT_H
+
+#include <string>
+#include <vector>
+
+namespace kiwix
+{
+
+class Book;
+
+/**
+ * Read and write the books of a library in a binary snapshot file.
+ *
+ * The file is made of a header, a table of fixed size book records, a table
+ * of (deduplicated) strings and the raw favicons. Records reference the
+ * strings and favicons by offset, so the file is read without parsing or
+ * decoding anything. All integers are stored in little endian.
+ *
+ * The format is versioned and only meant to be read back by the same
+ * version of kiwix-lib. The xml library file stays the interchange format.
+ */
+class LibrarySnapshot
+{
+  public:
+    static bool write(const std::string& path, const std::vector<const Book*>& books);
+
+    /* Read the books of the snapshot. Return false (and no book) if the file
+     * doesn't exist or is not a valid snapshot. */
+    static bool read(const std::string& path, std::vector<Book>& books);
+
+  private:
+    /* The string attributes of a book, in the order of the record. */
+    static const std::vector<std::string Book::*>& stringFields();
+};
+
+}
+
+#endif // KIWIX_LIBRARY_SNAPSHOT_H
@@ -40,7 +40,7 @@ LibXMLDumper::~LibXMLDumper()
 #define ADD_ATTRIBUTE(node, name, value) { (node).append_attribute((name)) = (value).c_str(); }
 #define ADD_ATTR_NOT_EMPTY(node, name, value) { if (!(value).empty()) ADD_ATTRIBUTE(node, name, value); }
 
-void LibXMLDumper::handleBook(Book book, pugi::xml_node root_node) {
+void LibXMLDumper::handleBook(const Book& book, pugi::xml_node root_node) {
   if (book.readOnly())
     return;
 
@@ -81,6 +81,16 @@ void LibXMLDumper::handleBook(Book book, pugi::xml_node root_node) {
     ADD_ATTRIBUTE(entry_node, "size", to_string(book.getSize()>>10));
 
   ADD_ATTR_NOT_EMPTY(entry_node, "downloadId", book.getDownloadId());
+
+  const auto& integrity = book.getIntegrity();
+  if (integrity.status != Book::Integrity::UNKNOWN) {
+    ADD_ATTRIBUTE(entry_node, "integrity", std::string(
+      integrity.status == Book::Integrity::VALID ? "valid"
+    : integrity.status == Book::Integrity::CORRUPTED ? "corrupted"
+    : "noChecksum"));
+    ADD_ATTRIBUTE(entry_node, "integrityFileSize", to_string(integrity.fileSize));
+    ADD_ATTRIBUTE(entry_node, "integrityFileMtime", to_string(integrity.fileMtime));
+  }
 }
 
 #define ADD_TEXT_ENTRY(node, child, value) (node).append_child((child)).append_child(pugi::node_pcdata).set_value((value).c_str())
@@ -107,21 +117,74 @@ void LibXMLDumper::handleBookmark(Bookmark bookmark, pugi::xml_node root_node) {
 }
 
 
-std::string LibXMLDumper::dumpLibXMLContent(const std::vector<std::string>& bookIds)
+namespace
+{
+
+struct XmlStringWriter: pugi::xml_writer
+{
+  std::string result;
+  virtual void write(const void* data, size_t size) {
+    result.append(static_cast<const char*>(data), size);
+  }
+};
+
+void writeString(pugi::xml_writer& writer, const std::string& str)
 {
+  writer.write(str.data(), str.size());
+}
+
+} // unnamed namespace
+
+bool LibXMLDumper::writeBook(const Book& book, pugi::xml_writer& writer)
+{
+  if (book.readOnly())
+    return false;
+
+  // Print the book node as if it was a child of the library node.
   pugi::xml_document doc;
+  handleBook(book, doc);
+  doc.first_child().print(writer, "  ", pugi::format_default, pugi::encoding_auto, 1);
+  return true;
+}
 
-  /* Add the library node */
-  pugi::xml_node libraryNode = doc.append_child("library");
+std::string LibXMLDumper::dumpLibXMLContent(const std::vector<std::string>& bookIds)
+{
+  XmlStringWriter writer;
+  dumpLibXMLContent(bookIds, writer);
+  return writer.result;
+}
+
+void LibXMLDumper::dumpLibXMLContent(const std::vector<std::string>& bookIds, pugi::xml_writer& writer)
+{
+  const std::string libraryNode = "<library version=\"" KIWIX_LIBRARY_VERSION "\"";
+  bool hasBooks = false;
 
-  libraryNode.append_attribute("version") = KIWIX_LIBRARY_VERSION;
+  if (library) {
+    for (auto& bookId: bookIds) {
+      const auto& book = library->getBookById(bookId);
+      if (!hasBooks && !book.readOnly()) {
+        writeString(writer, libraryNode + ">\n");
+        hasBooks = true;
+      }
+      writeBook(book, writer);
+    }
+  }
 
+  // Same output than pugixml for an empty library node.
+  writeString(writer, hasBooks ? "</library>\n" : libraryNode + " />\n");
+}
+
+size_t LibXMLDumper::dumpLibXMLBooks(const std::vector<std::string>& bookIds, pugi::xml_writer& writer)
+{
+  size_t count = 0;
   if (library) {
     for (auto& bookId: bookIds) {
-      handleBook(library->getBookById(bookId), libraryNode);
+      if (writeBook(library->getBookById(bookId), writer)) {
+        count++;
+      }
     }
   }
-  return nodeToString(libraryNode);
+  return count;
 }
 
 std::string LibXMLDumper::dumpLibXMLBookmark()
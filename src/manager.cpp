@@ -20,12 +20,27 @@
 #include "manager.h"
 
 #include "tools.h"
+#include "tools/archiveTools.h"
 #include "tools/pathTools.h"
+#include "tools/stringTools.h"
 
 #include <pugixml.hpp>
+#include <zim/archive.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
 
 namespace kiwix
 {
+
+namespace
+{
+
+const unsigned int MAX_READING_THREADS = 8;
+
+} // unnamed namespace
+
 /* Constructor */
 Manager::Manager(LibraryManipulator* manipulator):
   writableLibraryPath(""),
@@ -57,6 +72,7 @@ bool Manager::parseXmlDom(const pugi::xml_document& doc,
 
   std::string libraryVersion = libraryNode.attribute("version").value();
 
+  std::vector<kiwix::Book> books;
   for (pugi::xml_node bookNode = libraryNode.child("book"); bookNode;
        bookNode = bookNode.next_sibling("book")) {
     kiwix::Book book;
@@ -65,15 +81,52 @@ bool Manager::parseXmlDom(const pugi::xml_document& doc,
     book.updateFromXml(bookNode,
                        removeLastPathElement(libraryPath));
 
-    if (!trustLibrary && !book.getPath().empty()) {
-      this->readBookFromPath(book.getPath(), &book);
+    if (trustLibrary) {
+      manipulator->addBookToLibrary(book);
+    } else {
+      books.push_back(book);
+    }
+  }
+
+  if (!trustLibrary) {
+    readBooksFromPaths(books);
+    for (const auto& book : books) {
+      manipulator->addBookToLibrary(book);
     }
-    manipulator->addBookToLibrary(book);
   }
 
   return true;
 }
 
+void Manager::readBooksFromPaths(std::vector<kiwix::Book>& books)
+{
+  // Opening the zim files is mostly waiting for the disk. Do it on several
+  // threads, the books are then added in the library order anyway.
+  const unsigned int nbThreads = std::max(1U, std::min({
+    std::thread::hardware_concurrency(),
+    MAX_READING_THREADS,
+    static_cast<unsigned int>(books.size())
+  }));
+
+  std::atomic<size_t> nextBook(0);
+  auto readBooks = [&]() {
+    for (size_t i = nextBook++; i < books.size(); i = nextBook++) {
+      if (!books[i].getPath().empty()) {
+        this->readBookFromPath(books[i].getPath(), &books[i]);
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (unsigned int t = 1; t < nbThreads; t++) {
+    threads.emplace_back(readBooks);
+  }
+  readBooks();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
 bool Manager::readXml(const std::string& xml,
                       bool readOnly,
                       const std::string& libraryPath,
@@ -92,28 +145,39 @@ bool Manager::readXml(const std::string& xml,
 
 
 
-bool Manager::parseOpdsDom(const pugi::xml_document& doc, const std::string& urlHost)
+void Manager::parseOpdsFeedNode(const pugi::xml_node& feedNode)
 {
-  pugi::xml_node libraryNode = doc.child("feed");
-
   try {
-    m_totalBooks = strtoull(libraryNode.child("totalResults").child_value(), 0, 0);
-    m_startIndex = strtoull(libraryNode.child("startIndex").child_value(), 0, 0);
-    m_itemsPerPage = strtoull(libraryNode.child("itemsPerPage").child_value(), 0, 0);
+    m_totalBooks = strtoull(feedNode.child("totalResults").child_value(), 0, 0);
+    m_startIndex = strtoull(feedNode.child("startIndex").child_value(), 0, 0);
+    m_itemsPerPage = strtoull(feedNode.child("itemsPerPage").child_value(), 0, 0);
     m_hasSearchResult = true;
   } catch(...) {
     m_hasSearchResult = false;
   }
+}
 
-  for (pugi::xml_node entryNode = libraryNode.child("entry"); entryNode;
-       entryNode = entryNode.next_sibling("entry")) {
-    kiwix::Book book;
+void Manager::addBookFromOpdsEntry(const pugi::xml_node& entryNode,
+                                   const std::string& urlHost)
+{
+  kiwix::Book book;
 
-    book.setReadOnly(false);
-    book.updateFromOpds(entryNode, urlHost);
+  book.setReadOnly(false);
+  book.updateFromOpds(entryNode, urlHost);
+
+  /* Update the book properties with the new importer */
+  manipulator->addBookToLibrary(book);
+}
+
+bool Manager::parseOpdsDom(const pugi::xml_document& doc, const std::string& urlHost)
+{
+  pugi::xml_node libraryNode = doc.child("feed");
+
+  parseOpdsFeedNode(libraryNode);
 
-    /* Update the book properties with the new importer */
-    manipulator->addBookToLibrary(book);
+  for (pugi::xml_node entryNode = libraryNode.child("entry"); entryNode;
+       entryNode = entryNode.next_sibling("entry")) {
+    addBookFromOpdsEntry(entryNode, urlHost);
   }
 
   return true;
@@ -135,6 +199,331 @@ bool Manager::readOpds(const std::string& content, const std::string& urlHost)
   return false;
 }
 
+/* The state of an OPDS stream read by chunks.
+ *
+ * The markup of the stream is scanned to find the boundaries of the
+ * elements (skipping the comments, CDATA sections, processing instructions
+ * and declarations), and each complete entry element is parsed alone. The
+ * feed elements before the first entry are parsed (once the entry starts)
+ * as a feed without entries. */
+class Manager::OpdsStream
+{
+  public:
+    explicit OpdsStream(const std::string& urlHost)
+      : urlHost(urlHost)
+    {}
+
+    const std::string urlHost;
+    // The part of the stream which may still be needed.
+    std::string buffer;
+    // The position in `buffer` of the next markup to scan.
+    std::string::size_type pos = 0;
+    // The number of elements open at `pos` (1 inside the feed element).
+    unsigned int depth = 0;
+    // The position in `buffer` of the start tag of the current entry, or npos.
+    std::string::size_type entryStart = std::string::npos;
+    std::string feedName;
+    bool feedNodeParsed = false;
+    bool feedClosed = false;
+    bool valid = true;
+    // The books read, not given to the library yet.
+    std::vector<Book> books;
+};
+
+namespace
+{
+
+// The number of books of an OPDS stream given at once to the library.
+const size_t OPDS_BATCH_SIZE = 256;
+
+/* A markup of an XML text. */
+struct Markup {
+  enum Kind { START_TAG, END_TAG, EMPTY_ELEMENT_TAG, OTHER };
+  Kind kind;
+  // The position after the markup.
+  std::string::size_type end;
+  // The name of the element of a tag.
+  std::string name;
+};
+
+/* 1 if `text` has `literal` at `pos`, 0 if not, -1 if the text ends before
+ * it is known. */
+int matchAt(const std::string& text, std::string::size_type pos, const char* literal)
+{
+  for (; *literal; pos++, literal++) {
+    if (pos == text.size()) {
+      return -1;
+    }
+    if (text[pos] != *literal) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/* The position after the tag (or declaration) starting at `pos`, or npos
+ * if the tag is not complete. Quoted attribute values and the internal
+ * subset of a declaration may contain '>'. */
+std::string::size_type findTagEnd(const std::string& text, std::string::size_type pos)
+{
+  char quote = 0;
+  int brackets = 0;
+  for (pos++; pos < text.size(); pos++) {
+    const char c = text[pos];
+    if (quote) {
+      if (c == quote) {
+        quote = 0;
+      }
+    } else if (c == '"' || c == '\'') {
+      quote = c;
+    } else if (c == '[') {
+      brackets++;
+    } else if (c == ']') {
+      brackets--;
+    } else if (c == '>' && brackets <= 0) {
+      return pos + 1;
+    }
+  }
+  return std::string::npos;
+}
+
+/* Read the markup starting at `pos` (a '<') in `text`.
+ * Return false if the markup is not complete. */
+bool readMarkup(const std::string& text, std::string::size_type pos, Markup& markup)
+{
+  static const std::pair<std::string, std::string> SECTIONS[] = {
+    {"<!--", "-->"},
+    {"<![CDATA[", "]]>"},
+    {"<?", "?>"}
+  };
+  for (const auto& section : SECTIONS) {
+    const auto match = matchAt(text, pos, section.first.c_str());
+    if (match < 0) {
+      return false;
+    }
+    if (match > 0) {
+      const auto end = text.find(section.second, pos + section.first.size());
+      if (end == std::string::npos) {
+        return false;
+      }
+      markup.kind = Markup::OTHER;
+      markup.end = end + section.second.size();
+      return true;
+    }
+  }
+
+  markup.end = findTagEnd(text, pos);
+  if (markup.end == std::string::npos) {
+    return false;
+  }
+  if (text[pos + 1] == '!') {
+    // A declaration (<!DOCTYPE ...>)
+    markup.kind = Markup::OTHER;
+    return true;
+  }
+  const bool endTag = text[pos + 1] == '/';
+  const auto nameStart = pos + (endTag ? 2 : 1);
+  const auto nameEnd = text.find_first_of(" \t\r\n/>", nameStart);
+  markup.name = text.substr(nameStart, nameEnd - nameStart);
+  if (endTag) {
+    markup.kind = Markup::END_TAG;
+  } else if (text[markup.end - 2] == '/') {
+    markup.kind = Markup::EMPTY_ELEMENT_TAG;
+  } else {
+    markup.kind = Markup::START_TAG;
+  }
+  return true;
+}
+
+/* The name without the namespace prefix */
+std::string localName(const std::string& name)
+{
+  return name.substr(name.find(':') + 1);
+}
+
+} // unnamed namespace
+
+Manager::Manager(Manager&& other)
+  : manipulator(nullptr),
+    mustDeleteManipulator(false)
+{
+  *this = std::move(other);
+}
+
+Manager& Manager::operator=(Manager&& other)
+{
+  if (this == &other) {
+    return *this;
+  }
+  if (mustDeleteManipulator) {
+    delete manipulator;
+  }
+  writableLibraryPath = std::move(other.writableLibraryPath);
+  m_hasSearchResult = other.m_hasSearchResult;
+  m_totalBooks = other.m_totalBooks;
+  m_startIndex = other.m_startIndex;
+  m_itemsPerPage = other.m_itemsPerPage;
+  m_catalogRevision = other.m_catalogRevision;
+  manipulator = other.manipulator;
+  mustDeleteManipulator = other.mustDeleteManipulator;
+  m_opdsStream = std::move(other.m_opdsStream);
+  other.mustDeleteManipulator = false;
+  return *this;
+}
+
+bool Manager::readOpdsChunk(const std::string& chunk, const std::string& urlHost)
+{
+  if (!m_opdsStream) {
+    m_opdsStream.reset(new OpdsStream(urlHost));
+  }
+  auto& stream = *m_opdsStream;
+  auto& buffer = stream.buffer;
+  buffer += chunk;
+
+  bool valid = true;
+  const auto readEntry = [&](std::string::size_type start, std::string::size_type end) {
+    pugi::xml_document doc;
+    if (!doc.load_buffer(buffer.data() + start, end - start)) {
+      valid = false;
+      return;
+    }
+    kiwix::Book book;
+    book.setReadOnly(false);
+    book.updateFromOpds(doc.document_element(), stream.urlHost);
+    stream.books.push_back(book);
+    if (stream.books.size() >= OPDS_BATCH_SIZE) {
+      manipulator->addBooksToLibrary(stream.books);
+      stream.books.clear();
+    }
+  };
+
+  Markup markup;
+  while (true) {
+    // '<' is always the start of a markup (it is escaped in the text).
+    const auto start = buffer.find('<', stream.pos);
+    if (start == std::string::npos) {
+      stream.pos = buffer.size();
+      break;
+    }
+    stream.pos = start;
+    if (!readMarkup(buffer, start, markup)) {
+      break;
+    }
+    stream.pos = markup.end;
+    if (markup.kind == Markup::OTHER || stream.feedClosed) {
+      continue;
+    }
+
+    if (markup.kind == Markup::END_TAG) {
+      if (stream.depth > 0) {
+        stream.depth--;
+      }
+      if (stream.depth == 1 && stream.entryStart != std::string::npos) {
+        readEntry(stream.entryStart, markup.end);
+        stream.entryStart = std::string::npos;
+      } else if (stream.depth == 0) {
+        stream.feedClosed = true;
+      }
+      continue;
+    }
+
+    if (stream.depth == 0) {
+      stream.feedName = markup.name;
+    } else if (stream.depth == 1 && localName(markup.name) == "entry") {
+      if (!stream.feedNodeParsed) {
+        pugi::xml_document doc;
+        const auto feed = buffer.substr(0, start) + "</" + stream.feedName + ">";
+        if (doc.load_buffer(feed.data(), feed.size())) {
+          parseOpdsFeedNode(doc.document_element());
+        } else {
+          valid = false;
+        }
+        stream.feedNodeParsed = true;
+      }
+      if (markup.kind == Markup::EMPTY_ELEMENT_TAG) {
+        readEntry(start, markup.end);
+      } else {
+        stream.entryStart = start;
+      }
+    }
+    if (markup.kind == Markup::START_TAG) {
+      stream.depth++;
+    }
+  }
+
+  // Only keep the current entry. Without entries, the whole feed is needed
+  // to parse its elements.
+  if (stream.feedNodeParsed) {
+    const auto keep = std::min(stream.pos, stream.entryStart);
+    buffer.erase(0, keep);
+    stream.pos -= keep;
+    if (stream.entryStart != std::string::npos) {
+      stream.entryStart -= keep;
+    }
+  }
+  stream.valid = stream.valid && valid;
+  return valid;
+}
+
+bool Manager::endOpdsStream()
+{
+  if (!m_opdsStream) {
+    return false;
+  }
+  std::unique_ptr<OpdsStream> stream(std::move(m_opdsStream));
+  // The books read are kept, even if the stream is not complete.
+  if (!stream->books.empty()) {
+    manipulator->addBooksToLibrary(stream->books);
+  }
+  if (stream->feedNodeParsed) {
+    // Only blanks may remain after the end of the feed element.
+    return stream->valid
+        && stream->feedClosed
+        && stream->buffer.find_first_not_of(" \t\r\n", stream->pos) == std::string::npos;
+  }
+  pugi::xml_document doc;
+  if (!doc.load_buffer(stream->buffer.data(), stream->buffer.size())
+   || !doc.child("feed")) {
+    return false;
+  }
+  parseOpdsFeedNode(doc.child("feed"));
+  return true;
+}
+
+bool Manager::readOpdsChanges(const std::string& content, const std::string& urlHost)
+{
+  pugi::xml_document doc;
+  if (!doc.load_buffer(content.data(), content.size())) {
+    return false;
+  }
+  const auto feedNode = doc.child("feed");
+  const auto revisionNode = feedNode.child("revision");
+  if (!revisionNode) {
+    return false;
+  }
+
+  for (auto node = feedNode.first_child(); node; node = node.next_sibling()) {
+    // The name without the namespace prefix
+    std::string name = node.name();
+    name.erase(0, name.find(':') + 1);
+    if (name == "entry") {
+      addBookFromOpdsEntry(node, urlHost);
+    } else if (name == "deleted-entry") {
+      std::string bookId = node.attribute("ref").value();
+      if (startsWith(bookId, "urn:uuid:")) {
+        bookId.erase(0, 9);
+      }
+      manipulator->removeBookFromLibrary(bookId);
+    }
+  }
+  parseOpdsFeedNode(feedNode);
+  if (m_startIndex == 0) {
+    // The next changes start from the revision of the first page.
+    m_catalogRevision = strtoull(revisionNode.child_value(), 0, 0);
+  }
+  return true;
+}
+
 bool Manager::readFile(
   const std::string& path,
   bool readOnly,
@@ -215,8 +604,10 @@ bool Manager::readBookFromPath(const std::string& path, kiwix::Book* book)
     tmp_path = computeAbsolutePath(getCurrentDirectory(), path);
   }
   try {
-    kiwix::Reader reader(tmp_path);
-    book->update(reader);
+    // Only the metadata is needed, don't create a full Reader.
+    const zim::Archive archive(getArchivePath(tmp_path));
+    book->update(archive);
+    book->setPath(tmp_path);
     book->setPathValid(true);
   } catch (const std::exception& e) {
     book->setPathValid(false);
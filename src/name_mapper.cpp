@@ -24,7 +24,7 @@
 
 namespace kiwix {
 
-HumanReadableNameMapper::HumanReadableNameMapper(kiwix::Library& library, bool withAlias) {
+HumanReadableNameMapper::HumanReadableNameMapper(const kiwix::Library& library, bool withAlias) {
   for (auto& bookId: library.filter(kiwix::Filter().local(true).valid(true))) {
     auto& currentBook = library.getBookById(bookId);
     auto bookName = currentBook.getHumanReadableIdFromPath();
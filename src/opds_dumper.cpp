@@ -18,6 +18,7 @@
  */
 
 #include "opds_dumper.h"
+#include "opds_entry_cache.h"
 #include "book.h"
 
 #include "kiwixlib-resources.h"
@@ -26,6 +27,8 @@
 #include "tools/stringTools.h"
 #include "tools/otherTools.h"
 
+#include <unicode/locid.h>
+
 namespace kiwix
 {
 
@@ -50,44 +53,124 @@ namespace
 {
 
 typedef kainjow::mustache::data MustacheData;
-typedef kainjow::mustache::list BookData;
 
-BookData getBookData(const Library* library, const std::vector<std::string>& bookIds)
+std::string getLanguageSelfName(const std::string& lang)
+{
+  const icu::Locale locale(lang.c_str());
+  icu::UnicodeString ustring;
+  locale.getDisplayLanguage(locale, ustring);
+  std::string result;
+  ustring.toUTF8String(result);
+  return result;
+}
+
+// Same escaping as the one of mustache for {{variables}}
+void appendEscaped(std::string& out, const std::string& value)
+{
+  for (const char c : value) {
+    switch (c) {
+      case '&':  out += "&amp;"; break;
+      case '<':  out += "&lt;"; break;
+      case '>':  out += "&gt;"; break;
+      case '"':  out += "&quot;"; break;
+      case '\'': out += "&apos;"; break;
+      default:   out += c;
+    }
+  }
+}
+
+void appendElement(std::string& out, const char* indent, const char* tag, const std::string& value)
+{
+  out.append(indent).append("<").append(tag).append(">");
+  appendEscaped(out, value);
+  out.append("</").append(tag).append(">\n");
+}
+
+// Write the entry of a book in the feed. This is what the {{#books}}
+// sections of the catalog templates used to render.
+void appendBookEntry(std::string& out, const Book& book, const std::string& rootLocation)
+{
+  const char* const indent = "    ";
+  out += "  <entry>\n";
+  appendElement(out, indent, "id", "urn:uuid:" + book.getId());
+  appendElement(out, indent, "title", book.getTitle());
+  appendElement(out, indent, "summary", book.getDescription());
+  appendElement(out, indent, "language", book.getLanguage());
+  appendElement(out, indent, "updated", book.getDate() + "T00:00:00Z");
+  appendElement(out, indent, "name", book.getName());
+  appendElement(out, indent, "flavour", book.getFlavour());
+  appendElement(out, indent, "category", book.getCategory());
+  appendElement(out, indent, "tags", book.getTags());
+  appendElement(out, indent, "articleCount", to_string(book.getArticleCount()));
+  appendElement(out, indent, "mediaCount", to_string(book.getMediaCount()));
+  const auto iconUrl = rootLocation + "/catalog/v2/illustration/" + urlEncode(book.getId());
+  appendElement(out, indent, "icon", iconUrl);
+  out += "    <link rel=\"http://opds-spec.org/image/thumbnail\" href=\"";
+  appendEscaped(out, iconUrl);
+  out += "\" />\n";
+  out += "    <link type=\"text/html\" href=\"/";
+  out += book.getHumanReadableIdFromPath();
+  out += "\" />\n";
+  out += "    <author>\n";
+  appendElement(out, "      ", "name", book.getCreator());
+  out += "    </author>\n";
+  out += "    <publisher>\n";
+  appendElement(out, "      ", "name", book.getPublisher());
+  out += "    </publisher>\n";
+  if (!book.getUrl().empty()) {
+    out += "    <link rel=\"http://opds-spec.org/acquisition/open-access\" type=\"application/x-zim\" href=\"";
+    out += book.getUrl();
+    out += "\" length=\"";
+    out += to_string(book.getSize());
+    out += "\" />\n";
+  }
+  out += "  </entry>\n";
+}
+
+std::string renderBookEntry(const Book& book, const std::string& rootLocation)
 {
-  BookData bookData;
+  std::string entry;
+  entry.reserve(1024);
+  appendBookEntry(entry, book, rootLocation);
+  return entry;
+}
+
+std::string getBookEntries(const Library* library,
+                           const std::string& rootLocation,
+                           const std::vector<std::string>& bookIds,
+                           OPDSEntryCache* entryCache)
+{
+  std::string entries;
+  if (!entryCache) {
+    entries.reserve(bookIds.size() * 1024);
+    for ( const auto& bookId : bookIds ) {
+      appendBookEntry(entries, library->getBookById(bookId), rootLocation);
+    }
+    return entries;
+  }
+
+  std::vector<OPDSEntryCache::Entry> cachedEntries;
+  cachedEntries.reserve(bookIds.size());
+  size_t size = 0;
   for ( const auto& bookId : bookIds ) {
     const Book& book = library->getBookById(bookId);
-    const MustacheData bookUrl = book.getUrl().empty()
-                               ? MustacheData(false)
-                               : MustacheData(book.getUrl());
-    bookData.push_back(kainjow::mustache::object{
-      {"id", "urn:uuid:"+book.getId()},
-      {"name", book.getName()},
-      {"title", book.getTitle()},
-      {"description", book.getDescription()},
-      {"language", book.getLanguage()},
-      {"content_id",  book.getHumanReadableIdFromPath()},
-      {"updated", book.getDate() + "T00:00:00Z"},
-      {"category", book.getCategory()},
-      {"flavour", book.getFlavour()},
-      {"tags", book.getTags()},
-      {"article_count", to_string(book.getArticleCount())},
-      {"media_count", to_string(book.getMediaCount())},
-      {"author_name", book.getCreator()},
-      {"publisher_name", book.getPublisher()},
-      {"url", bookUrl},
-      {"size", to_string(book.getSize())},
-    });
+    cachedEntries.push_back(entryCache->get(
+      bookId, library->getBookRevision(bookId), rootLocation,
+      [&]() { return renderBookEntry(book, rootLocation); }
+    ));
+    size += cachedEntries.back()->size();
   }
-
-  return bookData;
+  entries.reserve(size);
+  for ( const auto& entry : cachedEntries ) {
+    entries += *entry;
+  }
+  return entries;
 }
 
 } // unnamed namespace
 
 string OPDSDumper::dumpOPDSFeed(const std::vector<std::string>& bookIds, const std::string& query) const
 {
-  const auto bookData = getBookData(library, bookIds);
   const kainjow::mustache::object template_data{
      {"date", gen_date_str()},
      {"root", rootLocation},
@@ -96,7 +179,7 @@ string OPDSDumper::dumpOPDSFeed(const std::vector<std::string>& bookIds, const s
      {"totalResults", to_string(m_totalResults)},
      {"startIndex", to_string(m_startIndex)},
      {"itemsPerPage", to_string(m_count)},
-     {"books", bookData }
+     {"entries", getBookEntries(library, rootLocation, bookIds, m_entryCache) }
   };
 
   return render_template(RESOURCE::templates::catalog_entries_xml, template_data);
@@ -104,8 +187,6 @@ string OPDSDumper::dumpOPDSFeed(const std::vector<std::string>& bookIds, const s
 
 string OPDSDumper::dumpOPDSFeedV2(const std::vector<std::string>& bookIds, const std::string& query) const
 {
-  const auto bookData = getBookData(library, bookIds);
-
   const kainjow::mustache::object template_data{
      {"date", gen_date_str()},
      {"endpoint_root", rootLocation + "/catalog/v2"},
@@ -115,21 +196,49 @@ string OPDSDumper::dumpOPDSFeedV2(const std::vector<std::string>& bookIds, const
      {"totalResults", to_string(m_totalResults)},
      {"startIndex", to_string(m_startIndex)},
      {"itemsPerPage", to_string(m_count)},
-     {"books", bookData }
+     {"entries", getBookEntries(library, rootLocation, bookIds, m_entryCache) }
   };
 
   return render_template(RESOURCE::templates::catalog_v2_entries_xml, template_data);
 }
 
-std::string OPDSDumper::categoriesOPDSFeed(const std::vector<std::string>& categories) const
+std::string OPDSDumper::dumpOPDSChangesFeed(const Library::Changes& changes, uint64_t since, uint64_t revision) const
+{
+  const auto now = gen_date_str();
+  kainjow::mustache::list removedBooks;
+  for ( const auto& bookId : changes.removedBooks ) {
+    removedBooks.push_back(kainjow::mustache::object{{"id", bookId}});
+  }
+  auto bookIds = changes.addedBooks;
+  bookIds.insert(bookIds.end(), changes.updatedBooks.begin(), changes.updatedBooks.end());
+
+  const kainjow::mustache::object template_data{
+     {"date", now},
+     {"endpoint_root", rootLocation + "/catalog/v2"},
+     {"feed_id", gen_uuid(libraryId + "/changes?since=" + to_string(since))},
+     {"since", to_string(since)},
+     {"revision", to_string(revision)},
+     {"totalResults", to_string(m_totalResults)},
+     {"startIndex", to_string(m_startIndex)},
+     {"itemsPerPage", to_string(m_count)},
+     {"removed_books", removedBooks},
+     {"entries", getBookEntries(library, rootLocation, bookIds, m_entryCache) }
+  };
+
+  return render_template(RESOURCE::templates::catalog_v2_changes_xml, template_data);
+}
+
+std::string OPDSDumper::categoriesOPDSFeed(const Library::AttributeCounts& categories) const
 {
   const auto now = gen_date_str();
   kainjow::mustache::list categoryData;
-  for ( const auto& category : categories ) {
+  for ( const auto& categoryCount : categories ) {
+    const auto& category = categoryCount.first;
     const auto urlencodedCategoryName = urlEncode(category);
     categoryData.push_back(kainjow::mustache::object{
       {"name", category},
       {"urlencoded_name",  urlencodedCategoryName},
+      {"book_count", to_string(categoryCount.second)},
       {"updated", now},
       {"id", gen_uuid(libraryId + "/categories/" + urlencodedCategoryName)}
     });
@@ -146,4 +255,31 @@ std::string OPDSDumper::categoriesOPDSFeed(const std::vector<std::string>& categ
   );
 }
 
+std::string OPDSDumper::languagesOPDSFeed(const Library::AttributeCounts& languages) const
+{
+  const auto now = gen_date_str();
+  kainjow::mustache::list languageData;
+  for ( const auto& languageCount : languages ) {
+    const auto& lang = languageCount.first;
+    languageData.push_back(kainjow::mustache::object{
+      {"lang_code", lang},
+      {"lang_code_url", urlEncode(lang, true)},
+      {"lang_self_name", getLanguageSelfName(lang)},
+      {"book_count", to_string(languageCount.second)},
+      {"updated", now},
+      {"id", gen_uuid(libraryId + "/languages/" + lang)}
+    });
+  }
+
+  return render_template(
+             RESOURCE::templates::catalog_v2_languages_xml,
+             kainjow::mustache::object{
+               {"date", now},
+               {"endpoint_root", rootLocation + "/catalog/v2"},
+               {"feed_id", gen_uuid(libraryId + "/languages")},
+               {"languages", languageData }
+             }
+  );
+}
+
 }
@@ -0,0 +1,66 @@
+/*
+ * Copyright 2021 Kiwix <contact@kiwix.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU  General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include "opds_entry_cache.h"
+
+namespace kiwix
+{
+
+OPDSEntryCache::OPDSEntryCache(size_t maxSize)
+  : m_size(0),
+    m_maxSize(maxSize)
+{
+}
+
+OPDSEntryCache::Entry OPDSEntryCache::get(const std::string& bookId,
+                                          uint64_t bookRevision,
+                                          const std::string& rootLocation,
+                                          const std::function<std::string()>& render)
+{
+  const auto key = rootLocation + '\n' + bookId;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto it = m_entries.find(key);
+    if (it != m_entries.end() && it->second.bookRevision == bookRevision) {
+      return it->second.entry;
+    }
+  }
+
+  // Render without the lock, another thread may render the same entry.
+  const auto entry = std::make_shared<const std::string>(render());
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto& cached = m_entries[key];
+  if (cached.entry) {
+    if (cached.bookRevision > bookRevision) {
+      // A newer version of the book has been rendered meanwhile.
+      return entry;
+    }
+    m_size -= cached.entry->size();
+  }
+  if (m_size + entry->size() > m_maxSize) {
+    m_entries.clear();
+    m_size = 0;
+  }
+  m_entries[key] = CachedEntry{bookRevision, entry};
+  m_size += entry->size();
+  return entry;
+}
+
+}
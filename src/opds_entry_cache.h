@@ -0,0 +1,73 @@
+/*
+ * Copyright 2021 Kiwix <contact@kiwix.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU  General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef KIWIX_OPDS_ENTRY_CACHE_H
+#define KIWIX_OPDS_ENTRY_CACHE_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace kiwix
+{
+
+/**
+ * Cache of the rendered OPDS entries of the books.
+ *
+ * An entry is identified by the book id and the root location of the urls
+ * it contains. It is valid as long as the revision of the book (as given by
+ * Library::getBookRevision()) doesn't change.
+ *
+ * The cache is bounded by the total size of the entries. When the bound is
+ * reached, the cache is emptied.
+ *
+ * All the methods can be called from several threads.
+ */
+class OPDSEntryCache
+{
+  public:
+    typedef std::shared_ptr<const std::string> Entry;
+
+    explicit OPDSEntryCache(size_t maxSize);
+
+    /* Return the cached entry of the book, or the one returned by
+     * `render` (which is then cached). */
+    Entry get(const std::string& bookId,
+              uint64_t bookRevision,
+              const std::string& rootLocation,
+              const std::function<std::string()>& render);
+
+  private:
+    struct CachedEntry {
+      uint64_t bookRevision;
+      Entry entry;
+    };
+
+    std::mutex m_mutex;
+    std::unordered_map<std::string, CachedEntry> m_entries;
+    size_t m_size;
+    size_t m_maxSize;
+};
+
+}
+
+#endif // KIWIX_OPDS_ENTRY_CACHE_H
@@ -29,61 +29,59 @@
 #include "tools/otherTools.h"
 #include "tools/archiveTools.h"
 
-inline char hi(char v)
+#include <algorithm>
+#include <iterator>
+#include <mutex>
+#include <unordered_set>
+
+namespace kiwix
 {
-  char hex[] = "0123456789abcdef";
-  return hex[(v >> 4) & 0xf];
-}
 
-inline char lo(char v)
+namespace
 {
-  char hex[] = "0123456789abcdef";
-  return hex[v & 0xf];
-}
 
-std::string hexUUID(std::string in)
+/* Identify a suggestion by its normalized title and its final path. */
+std::string suggestionKey(const SuggestionItem& suggestion)
 {
-  std::ostringstream out;
-  for (unsigned n = 0; n < 4; ++n) {
-    out << hi(in[n]) << lo(in[n]);
-  }
-  out << '-';
-  for (unsigned n = 4; n < 6; ++n) {
-    out << hi(in[n]) << lo(in[n]);
-  }
-  out << '-';
-  for (unsigned n = 6; n < 8; ++n) {
-    out << hi(in[n]) << lo(in[n]);
-  }
-  out << '-';
-  for (unsigned n = 8; n < 10; ++n) {
-    out << hi(in[n]) << lo(in[n]);
-  }
-  out << '-';
-  for (unsigned n = 10; n < 16; ++n) {
-    out << hi(in[n]) << lo(in[n]);
-  }
-  std::string op = out.str();
-  return op;
+  return suggestion.getNormalizedTitle() + '\0' + suggestion.getPath();
 }
 
-namespace kiwix
+/* The metadata returned by getMetadata() without reading the archive. */
+const char* const CACHED_METADATA[] = {
+  "Name", "Title", "Creator", "Publisher", "Date", "Description", "Subtitle",
+  "LongDescription", "Language", "License", "Tags", "Relation", "Flavour",
+  "Source", "Scraper", "Counter"
+};
+
+} // unnamed namespace
+
+struct Reader::Metadata
 {
+  std::once_flag readFlag;
+
+  // The values of the CACHED_METADATA found in the archive.
+  std::map<std::string, std::string> values;
+  std::string name;
+  std::string title;
+  std::string creator;
+  std::string publisher;
+  std::string date;
+  std::string description;
+  std::string language;
+  std::string tags;
+  std::vector<std::string> tagList;
+  std::string origId;
+  uint64_t articleCount = 0;
+  uint64_t mediaCount = 0;
+};
+
 /* Constructor */
 Reader::Reader(const string zimFilePath)
   :  zimArchive(nullptr),
-     zimFilePath(zimFilePath)
+     zimFilePath(zimFilePath),
+     mp_metadata(std::make_shared<Metadata>())
 {
-  string tmpZimFilePath = zimFilePath;
-
-  /* Remove potential trailing zimaa */
-  size_t found = tmpZimFilePath.rfind("zimaa");
-  if (found != string::npos && tmpZimFilePath.size() > 5
-      && found == tmpZimFilePath.size() - 5) {
-    tmpZimFilePath.resize(tmpZimFilePath.size() - 2);
-  }
-
-  zimArchive.reset(new zim::Archive(tmpZimFilePath));
+  zimArchive.reset(new zim::Archive(getArchivePath(zimFilePath)));
 
   /* initialize random seed: */
   srand(time(nullptr));
@@ -91,13 +89,15 @@ Reader::Reader(const string zimFilePath)
 
 Reader::Reader(const std::shared_ptr<zim::Archive> archive)
   : zimArchive(archive),
-    zimFilePath(archive->getFilename())
+    zimFilePath(archive->getFilename()),
+    mp_metadata(std::make_shared<Metadata>())
   {}
 
 #ifndef _WIN32
 Reader::Reader(int fd)
   :  zimArchive(new zim::Archive(fd)),
-     zimFilePath("")
+     zimFilePath(""),
+     mp_metadata(std::make_shared<Metadata>())
 {
   /* initialize random seed: */
   srand(time(nullptr));
@@ -105,7 +105,8 @@ Reader::Reader(int fd)
 
 Reader::Reader(int fd, zim::offset_type offset, zim::size_type size)
   :  zimArchive(new zim::Archive(fd, offset, size)),
-     zimFilePath("")
+     zimFilePath(""),
+     mp_metadata(std::make_shared<Metadata>())
 {
   /* initialize random seed: */
   srand(time(nullptr));
@@ -117,48 +118,46 @@ zim::Archive* Reader::getZimArchive() const
   return zimArchive.get();
 }
 
-MimeCounterType Reader::parseCounterMetadata() const
+const Reader::Metadata& Reader::getCachedMetadata() const
 {
-  try {
-    auto counterContent = zimArchive->getMetadata("Counter");
-    return parseMimetypeCounter(counterContent);
-  } catch (zim::EntryNotFound& e) {
-    return {};
-  }
+  std::call_once(mp_metadata->readFlag, [this]() {
+    auto& metadata = *mp_metadata;
+    for (const auto name : CACHED_METADATA) {
+      try {
+        metadata.values[name] = zimArchive->getMetadata(name);
+      } catch (zim::EntryNotFound& e) {}
+    }
+    const auto value = [&metadata](const std::string& name) {
+      const auto it = metadata.values.find(name);
+      return it == metadata.values.end() ? std::string() : it->second;
+    };
+    metadata.name = value("Name");
+    metadata.creator = value("Creator");
+    metadata.publisher = value("Publisher");
+    metadata.date = value("Date");
+    metadata.language = value("Language");
+    metadata.tagList = convertTags(value("Tags"));
+    metadata.tags = join(metadata.tagList, ";");
+    // With fallbacks on other metadata or on the file name.
+    metadata.title = kiwix::getArchiveTitle(*zimArchive);
+    metadata.description = kiwix::getMetaDescription(*zimArchive);
+    metadata.origId = kiwix::getArchiveOrigId(*zimArchive);
+
+    countArticlesAndMedias(value("Counter"), metadata.articleCount, metadata.mediaCount);
+  });
+  return *mp_metadata;
 }
 
 /* Get the count of articles which can be indexed/displayed */
 unsigned int Reader::getArticleCount() const
 {
-  std::map<const std::string, unsigned int> counterMap
-      = this->parseCounterMetadata();
-  unsigned int counter = 0;
-
-  for(auto &pair:counterMap) {
-    if (startsWith(pair.first, "text/html")) {
-      counter += pair.second;
-    }
-  }
-
-  return counter;
+  return getCachedMetadata().articleCount;
 }
 
 /* Get the count of medias content in the ZIM file */
 unsigned int Reader::getMediaCount() const
 {
-  std::map<const std::string, unsigned int> counterMap
-      = this->parseCounterMetadata();
-  unsigned int counter = 0;
-
-  for (auto &pair:counterMap) {
-    if (startsWith(pair.first, "image/") ||
-        startsWith(pair.first, "video/") ||
-        startsWith(pair.first, "audio/")) {
-      counter += pair.second;
-    }
-  }
-
-  return counter;
+  return getCachedMetadata().mediaCount;
 }
 
 /* Get the total of all items of a ZIM file, redirects included */
@@ -201,6 +200,16 @@ string Reader::getZimFilePath() const
 /* Return a metatag value */
 bool Reader::getMetadata(const string& name, string& value) const
 {
+  const auto& cachedNames = CACHED_METADATA;
+  if (std::find(std::begin(cachedNames), std::end(cachedNames), name) != std::end(cachedNames)) {
+    const auto& values = getCachedMetadata().values;
+    const auto it = values.find(name);
+    if (it == values.end()) {
+      return false;
+    }
+    value = it->second;
+    return true;
+  }
   try {
     value = zimArchive->getMetadata(name);
     return true;
@@ -213,32 +222,32 @@ bool Reader::getMetadata(const string& name, string& value) const
 
 string Reader::getName() const
 {
-  return kiwix::getMetaName(*zimArchive);
+  return getCachedMetadata().name;
 }
 
 string Reader::getTitle() const
 {
-  return kiwix::getArchiveTitle(*zimArchive);
+  return getCachedMetadata().title;
 }
 
 string Reader::getCreator() const
 {
-  return kiwix::getMetaCreator(*zimArchive);
+  return getCachedMetadata().creator;
 }
 
 string Reader::getPublisher() const
 {
-  return kiwix::getMetaPublisher(*zimArchive);
+  return getCachedMetadata().publisher;
 }
 
 string Reader::getDate() const
 {
-  return kiwix::getMetaDate(*zimArchive);
+  return getCachedMetadata().date;
 }
 
 string Reader::getDescription() const
 {
-  return kiwix::getMetaDescription(*zimArchive);
+  return getCachedMetadata().description;
 }
 
 string Reader::getLongDescription() const
@@ -248,7 +257,7 @@ string Reader::getLongDescription() const
 
 string Reader::getLanguage() const
 {
-  return kiwix::getMetaLanguage(*zimArchive);
+  return getCachedMetadata().language;
 }
 
 string Reader::getLicense() const
@@ -258,15 +267,16 @@ string Reader::getLicense() const
 
 string Reader::getTags(bool original) const
 {
-  return kiwix::getMetaTags(*zimArchive, original);
+  if (original) {
+    METADATA("Tags")
+  }
+  return getCachedMetadata().tags;
 }
 
 
 string Reader::getTagStr(const std::string& tagName) const
 {
-  string tags_str;
-  getMetadata("Tags", tags_str);
-  return getTagValueFromTagList(convertTags(tags_str), tagName);
+  return getTagValueFromTagList(getCachedMetadata().tagList, tagName);
 }
 
 bool Reader::getTagBool(const std::string& tagName) const
@@ -297,27 +307,7 @@ string Reader::getScraper() const
 
 string Reader::getOrigId() const
 {
-  string value;
-  this->getMetadata("startfileuid", value);
-  if (value.empty()) {
-    return "";
-  }
-  std::string id = value;
-  std::string origID;
-  std::string temp = "";
-  unsigned int k = 0;
-  char tempArray[16] = "";
-  for (unsigned int i = 0; i < id.size(); i++) {
-    if (id[i] == '\n') {
-      tempArray[k] = atoi(temp.c_str());
-      temp = "";
-      k++;
-    } else {
-      temp += id[i];
-    }
-  }
-  origID = hexUUID(tempArray);
-  return origID;
+  return getCachedMetadata().origId;
 }
 
 Entry Reader::getEntryFromPath(const std::string& path) const
@@ -391,6 +381,13 @@ bool Reader::searchSuggestions(const string& prefix,
     return false;
   }
 
+  // The suggestions already found, to skip the duplicates.
+  std::unordered_set<std::string> knownSuggestions;
+  for (const auto& suggestion : results) {
+    knownSuggestions.insert(suggestionKey(suggestion));
+  }
+  const auto previousCount = results.size();
+
   for (auto& entry: zimArchive->findByTitle(prefix)) {
     if (results.size() >= suggestionsCount) {
       break;
@@ -403,33 +400,26 @@ bool Reader::searchSuggestions(const string& prefix,
     auto item = entry.getItem(true);
     std::string articleFinalUrl = item.getPath();
 
-    /* Go through all already found suggestions and skip if this
-       article is already in the suggestions list (with an other
-       title) */
-    bool insert = true;
-    std::vector<SuggestionItem>::iterator suggestionItr;
-    for (suggestionItr = results.begin();
-         suggestionItr != results.end();
-         suggestionItr++) {
-      int result = normalizedArticleTitle.compare((*suggestionItr).getNormalizedTitle());
-      if (result == 0 && articleFinalUrl.compare((*suggestionItr).getPath()) == 0) {
-        insert = false;
-        break;
-      } else if (result < 0) {
-        break;
-      }
-    }
-
-    /* Insert if possible */
-    if (insert) {
-      SuggestionItem suggestion(entry.getTitle(), normalizedArticleTitle, articleFinalUrl);
-      results.insert(suggestionItr, suggestion);
+    /* Skip the article if it is already in the suggestions list (with an
+       other title) */
+    SuggestionItem suggestion(entry.getTitle(), normalizedArticleTitle, articleFinalUrl);
+    if (knownSuggestions.insert(suggestionKey(suggestion)).second) {
+      results.push_back(suggestion);
     }
 
     /* Suggestions where found */
     retVal = true;
   }
 
+  /* Keep the suggestions sorted by normalized title, the new ones after the
+     previous ones with the same normalized title */
+  const auto normalizedTitleLess = [](const SuggestionItem& a, const SuggestionItem& b) {
+    return a.getNormalizedTitle() < b.getNormalizedTitle();
+  };
+  const auto firstNew = results.begin() + previousCount;
+  std::stable_sort(firstNew, results.end(), normalizedTitleLess);
+  std::inplace_merge(results.begin(), firstNew, results.end(), normalizedTitleLess);
+
   return retVal;
 }
 
@@ -480,7 +470,7 @@ bool Reader::searchSuggestionsSmart(const string& prefix,
     retVal = true;
   } else {
     for (std::vector<std::string>::iterator variantsItr = variants.begin();
-         variantsItr != variants.end();
+         variantsItr != variants.end() && results.size() < suggestionsCount;
          variantsItr++) {
       retVal = this->searchSuggestions(*variantsItr, suggestionsCount, results)
                || retVal;
@@ -19,6 +19,7 @@
 
 
 #include <cmath>
+#include <sstream>
 
 #include "search_renderer.h"
 #include "searcher.h"
@@ -35,9 +36,31 @@
 namespace kiwix
 {
 
+namespace
+{
+
+std::vector<SearchRenderer::Result> getResults(const zim::SearchResultSet& srs)
+{
+  std::vector<SearchRenderer::Result> results;
+  for (auto it = srs.begin(); it != srs.end(); it++) {
+    SearchRenderer::Result result;
+    result.title = it.getTitle();
+    result.path = it.getPath();
+    result.snippet = it.getSnippet();
+    std::ostringstream s;
+    s << it.getZimId();
+    result.bookId = s.str();
+    result.wordCount = it.getWordCount();
+    results.push_back(result);
+  }
+  return results;
+}
+
+} // unnamed namespace
+
 /* Constructor */
 SearchRenderer::SearchRenderer(Searcher* searcher, NameMapper* mapper)
-    : m_srs(searcher->getSearchResultSet()),
+    : m_results(getResults(searcher->getSearchResultSet())),
       mp_nameMapper(mapper),
       protocolPrefix("zim://"),
       searchProtocolPrefix("search://?"),
@@ -47,7 +70,17 @@ SearchRenderer::SearchRenderer(Searcher* searcher, NameMapper* mapper)
 
 SearchRenderer::SearchRenderer(zim::SearchResultSet srs, NameMapper* mapper,
                       unsigned int start, unsigned int estimatedResultCount)
-    : m_srs(srs),
+    : m_results(getResults(srs)),
+      mp_nameMapper(mapper),
+      protocolPrefix("zim://"),
+      searchProtocolPrefix("search://?"),
+      estimatedResultCount(estimatedResultCount),
+      resultStart(start)
+{}
+
+SearchRenderer::SearchRenderer(std::vector<Result> results, NameMapper* mapper,
+                      unsigned int start, unsigned int estimatedResultCount)
+    : m_results(std::move(results)),
       mp_nameMapper(mapper),
       protocolPrefix("zim://"),
       searchProtocolPrefix("search://?"),
@@ -82,17 +115,15 @@ std::string SearchRenderer::getHtml()
 {
   kainjow::mustache::data results{kainjow::mustache::data::type::list};
 
-  for (auto it = m_srs.begin(); it != m_srs.end(); it++) {
+  for (const auto& r : m_results) {
     kainjow::mustache::data result;
-    result.set("title", it.getTitle());
-    result.set("url", it.getPath());
-    result.set("snippet", it.getSnippet());
-    std::ostringstream s;
-    s << it.getZimId();
-    result.set("resultContentId", mp_nameMapper->getNameForId(s.str()));
+    result.set("title", r.title);
+    result.set("url", r.path);
+    result.set("snippet", r.snippet);
+    result.set("resultContentId", mp_nameMapper->getNameForId(r.bookId));
 
-    if (it.getWordCount() >= 0) {
-      result.set("wordCount", kiwix::beautifyInteger(it.getWordCount()));
+    if (r.wordCount >= 0) {
+      result.set("wordCount", kiwix::beautifyInteger(r.wordCount));
     }
 
     results.push_back(result);
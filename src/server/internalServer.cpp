@@ -67,6 +67,9 @@ extern "C" {
 #include <string>
 #include <vector>
 #include <chrono>
+#include <algorithm>
+#include <set>
+#include <thread>
 #include "kiwixlib-resources.h"
 
 #ifndef _WIN32
@@ -94,6 +97,15 @@ inline std::string normalizeRootUrl(std::string rootUrl)
   return rootUrl.empty() ? rootUrl : "/" + rootUrl;
 }
 
+// Maximum size of the OPDS entries kept by the server.
+const size_t OPDS_ENTRY_CACHE_SIZE = 64 * 1024 * 1024;
+
+// The number of threads searching the archives of the library.
+unsigned int getFederatedSearchThreadCount()
+{
+  return std::max(2U, std::min(8U, std::thread::hardware_concurrency()));
+}
+
 } // unnamed namespace
 
 static IdNameMapper defaultNameMapper;
@@ -128,7 +140,10 @@ InternalServer::InternalServer(Library* library,
   m_blockExternalLinks(blockExternalLinks),
   mp_daemon(nullptr),
   mp_library(library),
-  mp_nameMapper(nameMapper ? nameMapper : &defaultNameMapper)
+  mp_nameMapper(nameMapper ? nameMapper : &defaultNameMapper),
+  m_opdsEntryCache(OPDS_ENTRY_CACHE_SIZE),
+  m_federatedSearcher(getFederatedSearchThreadCount(),
+                      kiwix::Filter().local(true).valid(true))
 {}
 
 bool InternalServer::start() {
@@ -305,7 +320,9 @@ MustacheData InternalServer::get_default_data() const
 bool InternalServer::etag_not_needed(const RequestContext& request) const
 {
   const std::string url = request.get_url();
-  return kiwix::startsWith(url, "/catalog")
+  // Illustrations don't change as long as the library doesn't change.
+  return (kiwix::startsWith(url, "/catalog")
+          && !kiwix::startsWith(url, "/catalog/v2/illustration/"))
       || url == "/search"
       || url == "/suggest"
       || url == "/random"
@@ -510,6 +527,112 @@ std::unique_ptr<Response> InternalServer::handle_skin(const RequestContext& requ
   }
 }
 
+namespace
+{
+
+// The books searched by a search without content, selected with the same
+// arguments as the catalog.
+struct SearchScope
+{
+  Filter filter;
+  // The names of the books (the `books` argument).
+  std::vector<std::string> bookNames;
+  // The arguments of the scope, in a fixed order, each one followed by a
+  // '&'. It is added to the links of the other pages of results.
+  std::string arguments;
+  // The normalized arguments of the scope: the same books always give the
+  // same key, whatever the order and the duplicates of the values.
+  std::string key;
+};
+
+// The values without the empty ones and the duplicates, sorted.
+std::vector<std::string> normalize_values(std::vector<std::string> values)
+{
+  values.erase(std::remove(values.begin(), values.end(), std::string()), values.end());
+  std::sort(values.begin(), values.end());
+  values.erase(std::unique(values.begin(), values.end()), values.end());
+  return values;
+}
+
+void add_scope_key(std::string& key, const std::string& name, const std::vector<std::string>& values)
+{
+  if (values.empty()) {
+    return;
+  }
+  key += name + "=";
+  for (const auto& value : values) {
+    key += urlEncode(value, true) + ";";
+  }
+  key += "&";
+}
+
+SearchScope get_search_scope(const RequestContext& request)
+{
+  static const std::string ARGUMENT_NAMES[] = {"books", "category", "lang", "name", "notag", "tag"};
+
+  SearchScope scope;
+  scope.filter.valid(true).local(true);
+  for (const auto& name : ARGUMENT_NAMES) {
+    std::string value;
+    try {
+      value = request.get_argument(name);
+    } catch (const std::out_of_range&) {}
+    if (value.empty()) {
+      continue;
+    }
+    scope.arguments += name + "=" + urlEncode(value, true) + "&";
+    if (name == "books") {
+      scope.bookNames = normalize_values(kiwix::split(value, ";"));
+    } else if (name == "category") {
+      scope.filter.category(value);
+    } else if (name == "lang") {
+      scope.filter.lang(value);
+    } else if (name == "name") {
+      scope.filter.name(value);
+    } else if (name == "notag") {
+      scope.filter.rejectTags(normalize_values(kiwix::split(value, ";")));
+    } else {
+      scope.filter.acceptTags(normalize_values(kiwix::split(value, ";")));
+    }
+  }
+
+  const auto& filter = scope.filter;
+  add_scope_key(scope.key, "books", scope.bookNames);
+  if (filter.hasCategory()) {
+    add_scope_key(scope.key, "category", {filter.getCategory()});
+  }
+  if (filter.hasLang()) {
+    add_scope_key(scope.key, "lang", {filter.getLang()});
+  }
+  if (filter.hasName()) {
+    add_scope_key(scope.key, "name", {filter.getName()});
+  }
+  add_scope_key(scope.key, "notag", filter.getRejectTags());
+  add_scope_key(scope.key, "tag", filter.getAcceptTags());
+  return scope;
+}
+
+Library::BookIdCollection get_scope_book_ids(const Library& library,
+                                             NameMapper* nameMapper,
+                                             const SearchScope& scope)
+{
+  auto bookIds = library.filter(scope.filter);
+  if (!scope.bookNames.empty()) {
+    std::set<std::string> namedBookIds;
+    for (const auto& name : scope.bookNames) {
+      try {
+        namedBookIds.insert(nameMapper->getIdForName(name));
+      } catch (const std::out_of_range&) {}
+    }
+    bookIds.erase(std::remove_if(bookIds.begin(), bookIds.end(),
+                                 [&](const std::string& id) { return namedBookIds.count(id) == 0; }),
+                  bookIds.end());
+  }
+  return bookIds;
+}
+
+} // unnamed namespace
+
 std::unique_ptr<Response> InternalServer::handle_search(const RequestContext& request)
 {
   if (m_verbose.load()) {
@@ -558,19 +681,13 @@ std::unique_ptr<Response> InternalServer::handle_search(const RequestContext& re
   }
 
   std::shared_ptr<zim::Searcher> searcher;
+  SearchScope scope;
   if (archive) {
     searcher = std::make_shared<zim::Searcher>(*archive);
   } else {
-    for (auto& bookId: mp_library->filter(kiwix::Filter().local(true).valid(true))) {
-      auto currentArchive = mp_library->getArchiveById(bookId);
-      if (currentArchive) {
-        if (! searcher) {
-          searcher = std::make_shared<zim::Searcher>(*currentArchive);
-        } else {
-          searcher->add_archive(*currentArchive);
-        }
-      }
-    }
+    // The archives of the library are searched by the federated searcher.
+    m_federatedSearcher.update(*mp_library);
+    scope = get_search_scope(request);
   }
 
   auto start = 0;
@@ -614,15 +731,25 @@ std::unique_ptr<Response> InternalServer::handle_search(const RequestContext& re
       query.setVerbose(m_verbose.load());
     }
 
-    zim::Search search = searcher->search(query);
-    SearchRenderer renderer(search.getResults(start, end), mp_nameMapper, start,
-                            search.getEstimatedMatches());
-    renderer.setSearchPattern(patternString);
-    renderer.setSearchContent(bookName);
-    renderer.setProtocolPrefix(m_root + "/");
-    renderer.setSearchProtocolPrefix(m_root + "/search?");
-    renderer.setPageLength(pageLength);
-    auto response = ContentResponse::build(*this, renderer.getHtml(), "text/html; charset=utf-8");
+    std::unique_ptr<SearchRenderer> renderer;
+    if (searcher) {
+      zim::Search search = searcher->search(query);
+      renderer.reset(new SearchRenderer(search.getResults(start, end), mp_nameMapper,
+                                        start, search.getEstimatedMatches()));
+    } else {
+      auto results = scope.key.empty()
+                   ? m_federatedSearcher.search(query, start, pageLength)
+                   : m_federatedSearcher.search(query, start, pageLength, scope.key,
+                                                [&]() { return get_scope_book_ids(*mp_library, mp_nameMapper, scope); });
+      renderer.reset(new SearchRenderer(std::move(results.results), mp_nameMapper,
+                                        start, results.estimatedMatches));
+    }
+    renderer->setSearchPattern(patternString);
+    renderer->setSearchContent(bookName);
+    renderer->setProtocolPrefix(m_root + "/");
+    renderer->setSearchProtocolPrefix(m_root + "/search?" + scope.arguments);
+    renderer->setPageLength(pageLength);
+    auto response = ContentResponse::build(*this, renderer->getHtml(), "text/html; charset=utf-8");
     response->set_taskbar(bookName, archive ? getArchiveTitle(*archive) : "");
 
     return std::move(response);
@@ -708,6 +835,7 @@ std::unique_ptr<Response> InternalServer::handle_catalog(const RequestContext& r
   kiwix::OPDSDumper opdsDumper(mp_library);
   opdsDumper.setRootLocation(m_root);
   opdsDumper.setLibraryId(m_library_id);
+  opdsDumper.setEntryCache(&m_opdsEntryCache);
   std::vector<std::string> bookIdsToDump;
   if (url == "root.xml") {
     uuid = zim::Uuid::generate(host);
@@ -754,11 +882,23 @@ Filter get_search_filter(const RequestContext& request)
     return filter;
 }
 
-template<class T>
-std::vector<T> subrange(const std::vector<T>& v, size_t s, size_t n)
+supportedListSortBy get_sort_by(const RequestContext& request)
 {
-  const size_t e = std::min(v.size(), s+n);
-  return std::vector<T>(v.begin()+std::min(v.size(), s), v.begin()+e);
+  std::string sortBy;
+  try {
+    sortBy = request.get_argument("sort");
+  } catch (const std::out_of_range&) {}
+  if (sortBy == "title")
+    return TITLE;
+  if (sortBy == "size")
+    return SIZE;
+  if (sortBy == "date")
+    return DATE;
+  if (sortBy == "creator")
+    return CREATOR;
+  if (sortBy == "publisher")
+    return PUBLISHER;
+  return UNSORTED;
 }
 
 } // unnamed namespace
@@ -771,11 +911,12 @@ InternalServer::search_catalog(const RequestContext& request,
     const std::string q = filter.hasQuery()
                         ? filter.getQuery()
                         : "<Empty query>";
-    std::vector<std::string> bookIdsToDump = mp_library->filter(filter);
-    const auto totalResults = bookIdsToDump.size();
+    const auto sortBy = get_sort_by(request);
+    const bool ascending = request.get_optional_param<std::string>("order", "asc") != "desc";
     const size_t count = request.get_optional_param("count", 10UL);
     const size_t startIndex = request.get_optional_param("start", 0UL);
-    bookIdsToDump = subrange(bookIdsToDump, startIndex, count);
+    size_t totalResults = 0;
+    const auto bookIdsToDump = mp_library->filter(filter, sortBy, ascending, startIndex, count, totalResults);
     opdsDumper.setOpenSearchInfo(totalResults, startIndex, bookIdsToDump.size());
     return bookIdsToDump;
 }
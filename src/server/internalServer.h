@@ -27,6 +27,8 @@ extern "C" {
 
 #include "library.h"
 #include "name_mapper.h"
+#include "opds_entry_cache.h"
+#include "federated_search.h"
 
 #include <mustache.hpp>
 
@@ -77,6 +79,9 @@ class InternalServer {
     std::unique_ptr<Response> handle_catalog_v2_root(const RequestContext& request);
     std::unique_ptr<Response> handle_catalog_v2_entries(const RequestContext& request);
     std::unique_ptr<Response> handle_catalog_v2_categories(const RequestContext& request);
+    std::unique_ptr<Response> handle_catalog_v2_languages(const RequestContext& request);
+    std::unique_ptr<Response> handle_catalog_v2_illustration(const RequestContext& request);
+    std::unique_ptr<Response> handle_catalog_v2_changes(const RequestContext& request);
     std::unique_ptr<Response> handle_meta(const RequestContext& request);
     std::unique_ptr<Response> handle_search(const RequestContext& request);
     std::unique_ptr<Response> handle_suggest(const RequestContext& request);
@@ -109,6 +114,9 @@ class InternalServer {
     std::string m_server_id;
     std::string m_library_id;
 
+    OPDSEntryCache m_opdsEntryCache;
+    FederatedSearcher m_federatedSearcher;
+
     friend std::unique_ptr<Response> Response::build(const InternalServer& server);
     friend std::unique_ptr<ContentResponse> ContentResponse::build(const InternalServer& server, const std::string& content, const std::string& mimetype, bool isHomePage);
     friend std::unique_ptr<Response> ItemResponse::build(const InternalServer& server, const RequestContext& request, const zim::Item& item);
@@ -59,6 +59,12 @@ std::unique_ptr<Response> InternalServer::handle_catalog_v2(const RequestContext
     return handle_catalog_v2_entries(request);
   } else if (url == "categories") {
     return handle_catalog_v2_categories(request);
+  } else if (url == "languages") {
+    return handle_catalog_v2_languages(request);
+  } else if (url == "illustration") {
+    return handle_catalog_v2_illustration(request);
+  } else if (url == "changes") {
+    return handle_catalog_v2_changes(request);
   } else {
     return Response::build_404(*this, request, "", "");
   }
@@ -74,7 +80,8 @@ std::unique_ptr<Response> InternalServer::handle_catalog_v2_root(const RequestCo
                {"endpoint_root", m_root + "/catalog/v2"},
                {"feed_id", gen_uuid(m_library_id)},
                {"all_entries_feed_id", gen_uuid(m_library_id + "/entries")},
-               {"category_list_feed_id", gen_uuid(m_library_id + "/categories")}
+               {"category_list_feed_id", gen_uuid(m_library_id + "/categories")},
+               {"language_list_feed_id", gen_uuid(m_library_id + "/languages")}
              },
              "application/atom+xml;profile=opds-catalog;kind=navigation"
   );
@@ -85,6 +92,7 @@ std::unique_ptr<Response> InternalServer::handle_catalog_v2_entries(const Reques
   OPDSDumper opdsDumper(mp_library);
   opdsDumper.setRootLocation(m_root);
   opdsDumper.setLibraryId(m_library_id);
+  opdsDumper.setEntryCache(&m_opdsEntryCache);
   const auto bookIds = search_catalog(request, opdsDumper);
   const auto opdsFeed = opdsDumper.dumpOPDSFeedV2(bookIds, request.get_query());
   return ContentResponse::build(
@@ -101,9 +109,81 @@ std::unique_ptr<Response> InternalServer::handle_catalog_v2_categories(const Req
   opdsDumper.setLibraryId(m_library_id);
   return ContentResponse::build(
              *this,
-             opdsDumper.categoriesOPDSFeed(mp_library->getBooksCategories()),
+             opdsDumper.categoriesOPDSFeed(mp_library->getBooksCategoriesWithCounts()),
              "application/atom+xml;profile=opds-catalog;kind=navigation"
   );
 }
 
+std::unique_ptr<Response> InternalServer::handle_catalog_v2_languages(const RequestContext& request)
+{
+  OPDSDumper opdsDumper(mp_library);
+  opdsDumper.setRootLocation(m_root);
+  opdsDumper.setLibraryId(m_library_id);
+  return ContentResponse::build(
+             *this,
+             opdsDumper.languagesOPDSFeed(mp_library->getBooksLanguagesWithCounts()),
+             "application/atom+xml;profile=opds-catalog;kind=navigation"
+  );
+}
+
+std::unique_ptr<Response> InternalServer::handle_catalog_v2_illustration(const RequestContext& request)
+{
+  try {
+    const auto bookId = request.get_url_part(3);
+    const auto illustration = mp_library->getBookIllustration(bookId);
+    if (illustration.data) {
+      auto response = ContentResponse::build(*this, *illustration.data, illustration.mimeType);
+      response->set_cacheable();
+      return std::move(response);
+    }
+  } catch (const std::out_of_range&) {}
+  return Response::build_404(*this, request, "", "");
+}
+
+std::unique_ptr<Response> InternalServer::handle_catalog_v2_changes(const RequestContext& request)
+{
+  const auto since = request.get_optional_param<uint64_t>("since", 0);
+  const size_t count = request.get_optional_param("count", 10UL);
+  const size_t startIndex = request.get_optional_param("start", 0UL);
+  const auto revision = mp_library->getRevision();
+  Library::Changes changes;
+  try {
+    // The books of /catalog/v2/entries.
+    changes = mp_library->getChangesSince(since, kiwix::Filter().valid(true).local(true));
+  } catch (const std::out_of_range&) {
+    // The client must read the whole catalog again.
+    auto response = Response::build(*this);
+    response->set_code(MHD_HTTP_GONE);
+    return response;
+  }
+
+  // The page of the changes: the removed books first, then the added and
+  // updated ones.
+  Library::Changes page;
+  size_t index = 0;
+  const size_t end = startIndex + count;
+  for (const auto& changeList : { std::make_pair(&changes.removedBooks, &page.removedBooks),
+                                  std::make_pair(&changes.addedBooks, &page.addedBooks),
+                                  std::make_pair(&changes.updatedBooks, &page.updatedBooks) }) {
+    for (const auto& id : *changeList.first) {
+      if (index >= startIndex && index < end) {
+        changeList.second->push_back(id);
+      }
+      index++;
+    }
+  }
+
+  OPDSDumper opdsDumper(mp_library);
+  opdsDumper.setRootLocation(m_root);
+  opdsDumper.setLibraryId(m_library_id);
+  opdsDumper.setEntryCache(&m_opdsEntryCache);
+  opdsDumper.setOpenSearchInfo(index, startIndex,
+                               page.removedBooks.size() + page.addedBooks.size() + page.updatedBooks.size());
+  return ContentResponse::build(
+             *this,
+             opdsDumper.dumpOPDSChangesFeed(page, since, revision),
+             "application/atom+xml;profile=opds-catalog;kind=acquisition"
+  );
+}
+
 } // namespace kiwix
@@ -27,8 +27,65 @@
 #include <zim/error.h>
 #include <zim/item.h>
 
+#include <cstdlib>
+#include <sstream>
+
+namespace
+{
+
+inline char hi(char v)
+{
+  char hex[] = "0123456789abcdef";
+  return hex[(v >> 4) & 0xf];
+}
+
+inline char lo(char v)
+{
+  char hex[] = "0123456789abcdef";
+  return hex[v & 0xf];
+}
+
+std::string hexUUID(std::string in)
+{
+  std::ostringstream out;
+  for (unsigned n = 0; n < 4; ++n) {
+    out << hi(in[n]) << lo(in[n]);
+  }
+  out << '-';
+  for (unsigned n = 4; n < 6; ++n) {
+    out << hi(in[n]) << lo(in[n]);
+  }
+  out << '-';
+  for (unsigned n = 6; n < 8; ++n) {
+    out << hi(in[n]) << lo(in[n]);
+  }
+  out << '-';
+  for (unsigned n = 8; n < 10; ++n) {
+    out << hi(in[n]) << lo(in[n]);
+  }
+  out << '-';
+  for (unsigned n = 10; n < 16; ++n) {
+    out << hi(in[n]) << lo(in[n]);
+  }
+  std::string op = out.str();
+  return op;
+}
+
+} // unnamed namespace
+
 namespace kiwix
 {
+std::string getArchivePath(const std::string& zimFilePath) {
+  /* Remove potential trailing zimaa */
+  std::string path = zimFilePath;
+  const size_t found = path.rfind("zimaa");
+  if (found != std::string::npos && path.size() > 5
+      && found == path.size() - 5) {
+    path.resize(path.size() - 2);
+  }
+  return path;
+}
+
 std::string getMetadata(const zim::Archive& archive, const std::string& name) {
     try {
         return archive.getMetadata(name);
@@ -101,6 +158,30 @@ std::string getMetaPublisher(const zim::Archive& archive) {
   return getMetadata(archive, "Publisher");
 }
 
+std::string getMetaFlavour(const zim::Archive& archive) {
+  return getMetadata(archive, "Flavour");
+}
+
+std::string getArchiveOrigId(const zim::Archive& archive) {
+  std::string id = getMetadata(archive, "startfileuid");
+  if (id.empty()) {
+    return "";
+  }
+  std::string temp = "";
+  unsigned int k = 0;
+  char tempArray[16] = "";
+  for (unsigned int i = 0; i < id.size(); i++) {
+    if (id[i] == '\n') {
+      tempArray[k] = atoi(temp.c_str());
+      temp = "";
+      k++;
+    } else {
+      temp += id[i];
+    }
+  }
+  return hexUUID(tempArray);
+}
+
 zim::Item getFinalItem(const zim::Archive& archive, const zim::Entry& entry)
 {
   return entry.getItem(true);
@@ -29,6 +29,9 @@
 
 namespace kiwix
 {
+    /* The path to open as an archive: the path of the first part of a split
+     * zim file (`foo.zimaa`) is the path of the zim file (`foo.zim`). */
+    std::string getArchivePath(const std::string& zimFilePath);
     std::string getMetadata(const zim::Archive& archive, const std::string& name);
     std::string getArchiveTitle(const zim::Archive& archive);
     std::string getMetaDescription(const zim::Archive& archive);
@@ -40,6 +43,8 @@ namespace kiwix
     std::string getMetaDate(const zim::Archive& archive);
     std::string getMetaCreator(const zim::Archive& archive);
     std::string getMetaPublisher(const zim::Archive& archive);
+    std::string getMetaFlavour(const zim::Archive& archive);
+    std::string getArchiveOrigId(const zim::Archive& archive);
     zim::Item getFinalItem(const zim::Archive& archive, const zim::Entry& entry);
     zim::Entry getEntryFromPath(const zim::Archive& archive, const std::string& path);
 }
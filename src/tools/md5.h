@@ -0,0 +1,56 @@
+/*
+ * Copyright 2021 Kiwix <contact@kiwix.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU  General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef KIWIX_MD5_H
+#define KIWIX_MD5_H
+
+#include <cstdint>
+#include <string>
+
+namespace kiwix
+{
+
+/**
+ * Compute the MD5 digest of a stream of bytes, given by chunks.
+ *
+ * Only used to check the checksum of the zim files. MD5 must not be used
+ * for anything related to security.
+ */
+class Md5
+{
+  public:
+    Md5();
+
+    void update(const char* data, size_t size);
+
+    /* The (binary, 16 bytes) digest of all the bytes given.
+     * No byte can be given after. */
+    std::string digest();
+
+  private:
+    void transform(const unsigned char* block);
+
+    uint32_t m_state[4];
+    uint64_t m_size;
+    unsigned char m_buffer[64];
+};
+
+}
+
+#endif // KIWIX_MD5_H
@@ -33,6 +33,7 @@
 
 #include "tools/stringTools.h"
 
+#include <limits>
 #include <map>
 #include <sstream>
 #include <pugixml.hpp>
@@ -298,37 +299,25 @@ namespace
 // So the final format may be complex to parse:
 // key0=value0;key1;foo=bar=value1;key2=value2
 
-typedef kiwix::MimeCounterType::value_type MimetypeAndCounter;
-
-std::string readFullMimetypeAndCounterString(std::istream& in)
+// Parse the number of an item, returning false if it is not a number (or
+// doesn't fit in an entry index).
+bool parseCounter(const char* begin, const char* end, zim::entry_index_type* counter)
 {
-  std::string mtcStr, params;
-  getline(in, mtcStr, ';');
-  if ( mtcStr.find('=') == std::string::npos )
-  {
-    do
-    {
-      if ( !getline(in, params, ';' ) )
-        return std::string();
-      mtcStr += ";" + params;
-    }
-    while ( std::count(params.begin(), params.end(), '=') != 2 );
+  if (begin == end) {
+    return false;
   }
-  return mtcStr;
-}
-
-MimetypeAndCounter parseASingleMimetypeCounter(const std::string& s)
-{
-  const std::string::size_type k = s.find_last_of("=");
-  if ( k != std::string::npos )
-  {
-    const std::string mimeType = s.substr(0, k);
-    std::istringstream counterSS(s.substr(k+1));
-    unsigned int counter;
-    if (counterSS >> counter && counterSS.eof())
-      return MimetypeAndCounter{mimeType, counter};
+  uint64_t value = 0;
+  for (const char* p = begin; p != end; ++p) {
+    if (*p < '0' || *p > '9') {
+      return false;
+    }
+    value = value * 10 + (*p - '0');
+    if (value > std::numeric_limits<zim::entry_index_type>::max()) {
+      return false;
+    }
   }
-  return MimetypeAndCounter{"", 0};
+  *counter = static_cast<zim::entry_index_type>(value);
+  return true;
 }
 
 } // unnamed namespace
@@ -336,19 +325,55 @@ MimetypeAndCounter parseASingleMimetypeCounter(const std::string& s)
 kiwix::MimeCounterType kiwix::parseMimetypeCounter(const std::string& counterData)
 {
   kiwix::MimeCounterType counters;
-  std::istringstream ss(counterData);
+  const char* const data = counterData.data();
+  const char* const dataEnd = data + counterData.size();
+  const char* pos = data;
 
-  while (ss)
-  {
-    const std::string mtcStr = readFullMimetypeAndCounterString(ss);
-    const MimetypeAndCounter mtc = parseASingleMimetypeCounter(mtcStr);
-    if ( !mtc.first.empty() )
-      counters.insert(mtc);
+  while (pos != dataEnd) {
+    // An item is made of the `;` separated fields up to (and including)
+    // the first one with a `=`. If this field is not the first one, the
+    // parameters of the mimetype are followed by `param=value=number`, so
+    // the last field must contain two `=`.
+    const char* const itemBegin = pos;
+    const char* fieldEnd = std::find(pos, dataEnd, ';');
+    bool complete = std::find(pos, fieldEnd, '=') != fieldEnd;
+    pos = fieldEnd == dataEnd ? dataEnd : fieldEnd + 1;
+    while (!complete) {
+      if (pos == dataEnd) {
+        return counters;
+      }
+      fieldEnd = std::find(pos, dataEnd, ';');
+      complete = std::count(pos, fieldEnd, '=') == 2;
+      pos = fieldEnd == dataEnd ? dataEnd : fieldEnd + 1;
+    }
+
+    const char* equal = fieldEnd;
+    while (*--equal != '=') {}
+    zim::entry_index_type counter;
+    if (equal != itemBegin && parseCounter(equal + 1, fieldEnd, &counter)) {
+      counters.insert({std::string(itemBegin, equal), counter});
+    }
   }
 
   return counters;
 }
 
+void kiwix::countArticlesAndMedias(const std::string& counterData,
+                                   uint64_t& articleCount, uint64_t& mediaCount)
+{
+  articleCount = 0;
+  mediaCount = 0;
+  for (const auto& pair : parseMimetypeCounter(counterData)) {
+    if (startsWith(pair.first, "text/html")) {
+      articleCount += pair.second;
+    } else if (startsWith(pair.first, "image/") ||
+               startsWith(pair.first, "video/") ||
+               startsWith(pair.first, "audio/")) {
+      mediaCount += pair.second;
+    }
+  }
+}
+
 std::string kiwix::gen_date_str()
 {
   auto now = std::time(0);
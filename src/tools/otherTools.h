@@ -20,6 +20,7 @@
 #ifndef KIWIX_OTHERTOOLS_H
 #define KIWIX_OTHERTOOLS_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <map>
@@ -44,6 +45,10 @@ namespace kiwix
 
   using MimeCounterType = std::map<const std::string, zim::entry_index_type>;
   MimeCounterType parseMimetypeCounter(const std::string& counterData);
+  /* Count the articles (html) and the medias (images, videos and sounds)
+   * of a Counter metadata. */
+  void countArticlesAndMedias(const std::string& counterData,
+                              uint64_t& articleCount, uint64_t& mediaCount);
 
   std::string gen_date_str();
   std::string gen_uuid(const std::string& s);
@@ -50,6 +50,7 @@
 # include <io.h>
 #else
 # define SEPARATOR "/"
+# include <ftw.h>
 # include <unistd.h>
 # include <sys/stat.h>
 #endif
@@ -262,6 +263,24 @@ unsigned int getFileSize(const std::string& path)
   return filestatus.st_size / 1024;
 }
 
+bool getFileStatus(const std::string& path, uint64_t* size, int64_t* mtime)
+{
+#ifdef _WIN32
+  struct _stat64 filestatus;
+  if (_wstat64(Utf8ToWide(path).c_str(), &filestatus) != 0) {
+    return false;
+  }
+#else
+  struct stat filestatus;
+  if (stat(path.c_str(), &filestatus) != 0) {
+    return false;
+  }
+#endif
+  *size = filestatus.st_size;
+  *mtime = filestatus.st_mtime;
+  return true;
+}
+
 std::string getFileSizeAsString(const std::string& path)
 {
   std::ostringstream convert;
@@ -347,6 +366,46 @@ std::string makeTmpDirectory()
 #endif
 }
 
+#ifndef _WIN32
+namespace
+{
+
+int removeEntry(const char* path, const struct stat*, int, struct FTW*)
+{
+  return remove(path);
+}
+
+} // unnamed namespace
+#endif
+
+bool removeDirectory(const std::string& path)
+{
+#ifdef _WIN32
+  const auto wpath = Utf8ToWide(path);
+  WIN32_FIND_DATAW data;
+  const HANDLE handle = FindFirstFileW((wpath + L"\\*").c_str(), &data);
+  if (handle != INVALID_HANDLE_VALUE) {
+    do {
+      const std::wstring name = data.cFileName;
+      if (name == L"." || name == L"..") {
+        continue;
+      }
+      const auto child = wpath + L"\\" + name;
+      if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+        removeDirectory(WideToUtf8(child));
+      } else {
+        DeleteFileW(child.c_str());
+      }
+    } while (FindNextFileW(handle, &data));
+    FindClose(handle);
+  }
+  return RemoveDirectoryW(wpath.c_str());
+#else
+  // Depth first, so the content of a directory is removed before it.
+  return nftw(path.c_str(), removeEntry, 16, FTW_DEPTH | FTW_PHYS) == 0;
+#endif
+}
+
 /* Try to create a link and if does not work then make a copy */
 bool copyFile(const std::string& sourcePath, const std::string& destPath)
 {
@@ -422,6 +481,37 @@ bool writeTextFile(const std::string& path, const std::string& content)
   return true;
 }
 
+FILE* openFile(const std::string& path, const char* mode)
+{
+#ifdef _WIN32
+  return _wfopen(Utf8ToWide(path).c_str(), Utf8ToWide(mode).c_str());
+#else
+  return fopen(path.c_str(), mode);
+#endif
+}
+
+bool syncFile(FILE* file)
+{
+  if (fflush(file) != 0) {
+    return false;
+  }
+#ifdef _WIN32
+  return _commit(_fileno(file)) == 0;
+#else
+  return fsync(fileno(file)) == 0;
+#endif
+}
+
+bool moveFile(const std::string& sourcePath, const std::string& destPath)
+{
+#ifdef _WIN32
+  return MoveFileExW(Utf8ToWide(sourcePath).c_str(), Utf8ToWide(destPath).c_str(),
+                     MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+  return rename(sourcePath.c_str(), destPath.c_str()) == 0;
+#endif
+}
+
 std::string kiwix::getCurrentDirectory()
 {
 #ifdef _WIN32
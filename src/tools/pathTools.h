@@ -20,6 +20,8 @@
 #ifndef KIWIX_PATHTOOLS_H
 #define KIWIX_PATHTOOLS_H
 
+#include <cstdint>
+#include <cstdio>
 #include <string>
 
 #ifdef _WIN32
@@ -28,13 +30,22 @@ std::wstring Utf8ToWide(const std::string& str);
 #endif
 
 unsigned int getFileSize(const std::string& path);
+/* Get the size (in bytes) and the modification time (in seconds since the
+ * epoch) of a file. Return false if the file cannot be read. */
+bool getFileStatus(const std::string& path, uint64_t* size, int64_t* mtime);
 std::string getFileSizeAsString(const std::string& path);
 std::string getFileContent(const std::string& path);
 bool fileExists(const std::string& path);
 bool makeDirectory(const std::string& path);
 std::string makeTmpDirectory();
+/* Remove a directory and all its content. */
+bool removeDirectory(const std::string& path);
 bool copyFile(const std::string& sourcePath, const std::string& destPath);
 bool writeTextFile(const std::string& path, const std::string& content);
+FILE* openFile(const std::string& path, const char* mode);
+bool syncFile(FILE* file);
+/* Rename sourcePath to destPath, replacing destPath if it exists. */
+bool moveFile(const std::string& sourcePath, const std::string& destPath);
 std::string getMimeTypeForFile(const std::string& filename);
 
 #endif
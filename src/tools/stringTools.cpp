@@ -30,8 +30,10 @@
 #include <unicode/ustring.h>
 
 
+#include <cstring>
 #include <iostream>
 #include <iomanip>
+#include <memory>
 
 /* tell ICU where to find its dat file (tables) */
 void kiwix::loadICUExternalTables()
@@ -49,16 +51,79 @@ void kiwix::loadICUExternalTables()
 #endif
 }
 
+namespace
+{
+
+void initICUForRemoveAccents()
+{
+  // ucnv_setDefaultName is not thread safe. Do it only once.
+  static const bool initialized = []() {
+    kiwix::loadICUExternalTables();
+    ucnv_setDefaultName("UTF-8");
+    return true;
+  }();
+  (void)initialized;
+}
+
+/* Creating the transliterator is far more expensive than using it, but a
+ * transliterator can't be shared between threads. Keep one per thread. */
+icu::Transliterator* getRemoveAccentsTransliterator()
+{
+  thread_local std::unique_ptr<icu::Transliterator> transliterator;
+  if (!transliterator) {
+    UErrorCode status = U_ZERO_ERROR;
+    transliterator.reset(icu::Transliterator::createInstance(
+        "Lower; NFD; [:M:] remove; NFC", UTRANS_FORWARD, status));
+  }
+  return transliterator.get();
+}
+
+bool isPureAscii(const char* data, size_t size)
+{
+  // Check 8 bytes at once, then the remaining bytes one by one.
+  const uint64_t highBits = 0x8080808080808080ULL;
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+    uint64_t chunk;
+    memcpy(&chunk, data + i, sizeof(chunk));
+    if (chunk & highBits) {
+      return false;
+    }
+  }
+  for (; i < size; i++) {
+    if (data[i] & 0x80) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* On pure ascii text, "Lower; NFD; [:M:] remove; NFC" is only a lowercase. */
+std::string asciiToLower(const char* data, size_t size)
+{
+  std::string result(data, size);
+  for (auto& c : result) {
+    // Branchless, so the compiler can vectorize the loop.
+    c |= (static_cast<unsigned char>(c - 'A') < 26) << 5;
+  }
+  return result;
+}
+
+} // unnamed namespace
+
 std::string kiwix::removeAccents(const std::string& text)
 {
-  loadICUExternalTables();
-  ucnv_setDefaultName("UTF-8");
-  UErrorCode status = U_ZERO_ERROR;
-  auto removeAccentsTrans = icu::Transliterator::createInstance(
-      "Lower; NFD; [:M:] remove; NFC", UTRANS_FORWARD, status);
+  initICUForRemoveAccents();
+
+  // Like the icu::UnicodeString(const char*) constructor used below, stop at
+  // the first null character.
+  const auto size = strlen(text.c_str());
+  if (isPureAscii(text.data(), size)) {
+    return asciiToLower(text.data(), size);
+  }
+
   icu::UnicodeString ustring(text.c_str());
-  removeAccentsTrans->transliterate(ustring);
-  delete removeAccentsTrans;
+  getRemoveAccentsTransliterator()->transliterate(ustring);
   std::string unaccentedText;
   ustring.toUTF8String(unaccentedText);
   return unaccentedText;
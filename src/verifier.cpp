@@ -0,0 +1,421 @@
+/*
+ * Copyright 2021 Kiwix <contact@kiwix.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU  General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include "verifier.h"
+
+#include "tools/md5.h"
+#include "tools/pathTools.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+namespace kiwix
+{
+
+namespace
+{
+
+const size_t CHUNK_SIZE = 1024 * 1024;
+// Report the progress every PROGRESS_INTERVAL chunks.
+const unsigned int PROGRESS_INTERVAL = 16;
+
+// See https://wiki.openzim.org/wiki/ZIM_file_format#Header
+const size_t HEADER_SIZE = 80;
+const uint32_t ZIM_MAGIC = 72173914;
+const size_t MIME_LIST_POS_OFFSET = 56;
+const size_t CHECKSUM_POS_OFFSET = 72;
+const size_t CHECKSUM_SIZE = 16;
+
+uint64_t getUint64(const char* data)
+{
+  uint64_t value = 0;
+  for (unsigned i = 0; i < 8; i++) {
+    value |= static_cast<uint64_t>(static_cast<unsigned char>(data[i])) << (8 * i);
+  }
+  return value;
+}
+
+/* A zim file, possibly split in several parts (path + "aa", "ab"...),
+ * read sequentially. */
+class ZimFile
+{
+  public:
+    explicit ZimFile(const std::string& path)
+    {
+      if (fileExists(path)) {
+        m_parts.push_back(path);
+      } else {
+        for (char c1 = 'a'; c1 <= 'z' && m_parts.size() == size_t(c1 - 'a') * 26; c1++) {
+          for (char c2 = 'a'; c2 <= 'z'; c2++) {
+            const auto part = path + c1 + c2;
+            if (!fileExists(part)) {
+              break;
+            }
+            m_parts.push_back(part);
+          }
+        }
+      }
+      for (const auto& part : m_parts) {
+        uint64_t size;
+        int64_t mtime;
+        if (!getFileStatus(part, &size, &mtime)) {
+          m_parts.clear();
+          break;
+        }
+        m_size += size;
+        m_mtime = std::max(m_mtime, mtime);
+      }
+    }
+
+    ~ZimFile()
+    {
+      if (mp_file) {
+        fclose(mp_file);
+      }
+    }
+
+    ZimFile(const ZimFile&) = delete;
+    ZimFile& operator=(const ZimFile&) = delete;
+
+    bool exists() const { return !m_parts.empty(); }
+    uint64_t size() const { return m_size; }
+    int64_t mtime() const { return m_mtime; }
+
+    /* Read exactly `size` bytes. Return false if they cannot be read. */
+    bool read(char* buffer, size_t size)
+    {
+      while (size) {
+        if (!mp_file) {
+          if (m_nextPart == m_parts.size()) {
+            return false;
+          }
+          mp_file = openFile(m_parts[m_nextPart++], "rb");
+          if (!mp_file) {
+            return false;
+          }
+        }
+        const auto count = fread(buffer, 1, size, mp_file);
+        buffer += count;
+        size -= count;
+        if (size) {
+          if (ferror(mp_file)) {
+            return false;
+          }
+          fclose(mp_file);
+          mp_file = nullptr;
+        }
+      }
+      return true;
+    }
+
+  private:
+    std::vector<std::string> m_parts;
+    uint64_t m_size = 0;
+    int64_t m_mtime = 0;
+    size_t m_nextPart = 0;
+    FILE* mp_file = nullptr;
+};
+
+bool sameFile(const Book::Integrity& integrity, const ZimFile& file)
+{
+  return integrity.fileSize == file.size() && integrity.fileMtime == file.mtime();
+}
+
+} // unnamed namespace
+
+Verifier::Verifier(unsigned int workerCount)
+{
+  for (unsigned int i = 0; i < std::max(workerCount, 1U); i++) {
+    m_workers.emplace_back(&Verifier::work, this);
+  }
+}
+
+Verifier::~Verifier()
+{
+  {
+    std::unique_lock<std::mutex> lock(m_lock);
+    m_stopping = true;
+  }
+  m_workCondition.notify_all();
+  for (auto& worker : m_workers) {
+    worker.join();
+  }
+}
+
+void Verifier::setMaxBytesPerSecond(uint64_t bytesPerSecond)
+{
+  std::unique_lock<std::mutex> lock(m_lock);
+  m_maxBytesPerSecond = bytesPerSecond;
+  m_workCondition.notify_all();
+}
+
+void Verifier::verify(const std::string& path, Callback callback)
+{
+  Progress progress;
+  progress.path = path;
+  if (!findResult(path, &progress.integrity)) {
+    std::unique_lock<std::mutex> lock(m_lock);
+    auto it = m_callbacks.find(path);
+    if (it == m_callbacks.end()) {
+      it = m_callbacks.emplace(path, std::vector<Callback>()).first;
+      m_queue.push_back(path);
+      // Also wakes up the throttled workers, only an idle one takes it.
+      m_workCondition.notify_all();
+    }
+    if (callback) {
+      it->second.push_back(callback);
+    }
+    return;
+  }
+  progress.bytesRead = progress.bytesTotal = progress.integrity.fileSize;
+  progress.finished = true;
+  if (callback) {
+    callback(progress);
+  }
+}
+
+void Verifier::verify(const Book& book, Callback callback)
+{
+  if (book.getIntegrity().status != Book::Integrity::UNKNOWN) {
+    std::unique_lock<std::mutex> lock(m_lock);
+    m_results.emplace(book.getPath(), book.getIntegrity());
+  }
+  verify(book.getPath(), callback);
+}
+
+void Verifier::cancel(const std::string& path)
+{
+  std::vector<Callback> callbacks;
+  {
+    std::unique_lock<std::mutex> lock(m_lock);
+    const auto it = std::find(m_queue.begin(), m_queue.end(), path);
+    if (it == m_queue.end()) {
+      if (m_callbacks.count(path)) {
+        // Running, the worker stops reading the file.
+        m_cancelled.insert(path);
+        m_workCondition.notify_all();
+      }
+      return;
+    }
+    m_queue.erase(it);
+    callbacks.swap(m_callbacks[path]);
+    m_callbacks.erase(path);
+    m_finishingCount++;
+  }
+  Progress progress;
+  progress.path = path;
+  progress.finished = true;
+  for (auto& callback : callbacks) {
+    callback(progress);
+  }
+  std::unique_lock<std::mutex> lock(m_lock);
+  m_finishingCount--;
+  m_doneCondition.notify_all();
+}
+
+Book::Integrity Verifier::getIntegrity(const std::string& path) const
+{
+  Book::Integrity integrity;
+  findResult(path, &integrity);
+  return integrity;
+}
+
+bool Verifier::updateIntegrity(Book& book) const
+{
+  const auto integrity = getIntegrity(book.getPath());
+  const auto& current = book.getIntegrity();
+  if (integrity.status == current.status
+   && integrity.fileSize == current.fileSize
+   && integrity.fileMtime == current.fileMtime) {
+    return false;
+  }
+  book.setIntegrity(integrity);
+  return true;
+}
+
+void Verifier::wait()
+{
+  std::unique_lock<std::mutex> lock(m_lock);
+  m_doneCondition.wait(lock, [this]() {
+    return m_callbacks.empty() && !m_finishingCount;
+  });
+}
+
+bool Verifier::findResult(const std::string& path, Book::Integrity* integrity) const
+{
+  Book::Integrity result;
+  {
+    std::unique_lock<std::mutex> lock(m_lock);
+    const auto it = m_results.find(path);
+    if (it == m_results.end()) {
+      return false;
+    }
+    result = it->second;
+  }
+  // Without the lock: all the parts of a split file may be looked for.
+  const ZimFile file(path);
+  if (!file.exists() || !sameFile(result, file)) {
+    return false;
+  }
+  *integrity = result;
+  return true;
+}
+
+void Verifier::work()
+{
+  std::unique_lock<std::mutex> lock(m_lock);
+  while (true) {
+    m_workCondition.wait(lock, [this]() { return m_stopping || !m_queue.empty(); });
+    if (m_stopping) {
+      return;
+    }
+    const auto path = m_queue.front();
+    m_queue.pop_front();
+    lock.unlock();
+
+    Progress progress;
+    progress.path = path;
+    progress.integrity = check(path);
+    progress.bytesRead = progress.bytesTotal = progress.integrity.fileSize;
+    progress.finished = true;
+
+    lock.lock();
+    if (m_stopping) {
+      // The callbacks are not called once the verifier is being destroyed.
+      return;
+    }
+    if (m_cancelled.erase(path)) {
+      progress.integrity = Book::Integrity();
+      progress.bytesRead = 0;
+    } else if (progress.integrity.status != Book::Integrity::UNKNOWN) {
+      m_results[path] = progress.integrity;
+    }
+    std::vector<Callback> callbacks;
+    callbacks.swap(m_callbacks[path]);
+    m_callbacks.erase(path);
+    m_finishingCount++;
+    lock.unlock();
+    for (auto& callback : callbacks) {
+      callback(progress);
+    }
+    lock.lock();
+    m_finishingCount--;
+    m_doneCondition.notify_all();
+  }
+}
+
+/* Check the file as libzim does: the checksum is the MD5 digest of all the
+ * bytes of the file before it. */
+Book::Integrity Verifier::check(const std::string& path)
+{
+  Book::Integrity integrity;
+  ZimFile file(path);
+  if (!file.exists()) {
+    return integrity;
+  }
+  integrity.fileSize = file.size();
+  integrity.fileMtime = file.mtime();
+
+  Progress progress;
+  progress.path = path;
+  progress.bytesTotal = file.size();
+
+  integrity.status = Book::Integrity::CORRUPTED;
+  char header[HEADER_SIZE];
+  if (!file.read(header, HEADER_SIZE)) {
+    return integrity;
+  }
+  uint32_t magic = 0;
+  for (unsigned i = 0; i < 4; i++) {
+    magic |= static_cast<uint32_t>(static_cast<unsigned char>(header[i])) << (8 * i);
+  }
+  if (magic != ZIM_MAGIC) {
+    return integrity;
+  }
+  // Old zim files have a shorter header, without checksum.
+  if (getUint64(header + MIME_LIST_POS_OFFSET) < HEADER_SIZE) {
+    integrity.status = Book::Integrity::NO_CHECKSUM;
+    return integrity;
+  }
+  const uint64_t checksumPos = getUint64(header + CHECKSUM_POS_OFFSET);
+  if (checksumPos < HEADER_SIZE || checksumPos > file.size() - CHECKSUM_SIZE) {
+    return integrity;
+  }
+
+  Md5 md5;
+  md5.update(header, HEADER_SIZE);
+  progress.bytesRead = HEADER_SIZE;
+  std::unique_ptr<char[]> buffer(new char[CHUNK_SIZE]);
+  for (unsigned int chunk = 1; progress.bytesRead < checksumPos; chunk++) {
+    const size_t size = std::min<uint64_t>(CHUNK_SIZE, checksumPos - progress.bytesRead);
+    if (!throttle(path, size)) {
+      return Book::Integrity();
+    }
+    if (!file.read(buffer.get(), size)) {
+      return integrity;
+    }
+    md5.update(buffer.get(), size);
+    progress.bytesRead += size;
+    if (chunk % PROGRESS_INTERVAL == 0) {
+      report(progress);
+    }
+  }
+
+  char checksum[CHECKSUM_SIZE];
+  if (file.read(checksum, CHECKSUM_SIZE)
+   && md5.digest() == std::string(checksum, CHECKSUM_SIZE)) {
+    integrity.status = Book::Integrity::VALID;
+  }
+  return integrity;
+}
+
+void Verifier::report(const Progress& progress)
+{
+  std::vector<Callback> callbacks;
+  {
+    std::unique_lock<std::mutex> lock(m_lock);
+    if (m_stopping) {
+      return;
+    }
+    callbacks = m_callbacks[progress.path];
+  }
+  for (auto& callback : callbacks) {
+    callback(progress);
+  }
+}
+
+bool Verifier::throttle(const std::string& path, size_t size)
+{
+  std::unique_lock<std::mutex> lock(m_lock);
+  if (m_maxBytesPerSecond) {
+    const auto now = std::chrono::steady_clock::now();
+    const auto readTime = std::max(m_nextReadTime, now);
+    m_nextReadTime = readTime + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      std::chrono::duration<double>(double(size) / m_maxBytesPerSecond));
+    m_workCondition.wait_until(lock, readTime, [&]() {
+      return m_stopping || m_cancelled.count(path);
+    });
+  }
+  return !m_stopping && !m_cancelled.count(path);
+}
+
+}
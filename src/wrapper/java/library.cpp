@@ -61,7 +61,8 @@ Java_org_kiwix_kiwixlib_Library_addBook(
 
 METHOD(jobject, Library, getBookById, jstring id) {
   auto cId = jni2c(id, env);
-  auto cBook = new kiwix::Book(LIBRARY->getBookById(cId));
+  const kiwix::Library& library = *LIBRARY;
+  auto cBook = new kiwix::Book(library.getBookById(cId));
   jclass cls = env->FindClass("org/kiwix/kiwixlib/Book");
   jmethodID constructorId = env->GetMethodID(cls, "<init>", "()V");
   jobject book = env->NewObject(cls, constructorId);
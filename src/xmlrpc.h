@@ -4,7 +4,7 @@
 #define KIWIX_XMLRPC_H_
 
 #include <stdexcept>
-#include <tools/otherTools.h>
+#include "tools/otherTools.h"
 #include <pugixml.hpp>
 
 namespace kiwix {
@@ -0,0 +1,266 @@
+/*
+ * Copyright (C) 2021 Kiwix <contact@kiwix.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef KIWIX_TEST_ARIA2_STUB_H
+#define KIWIX_TEST_ARIA2_STUB_H
+
+// A fake aria2 rpc server, implementing the few methods used by kiwix-lib.
+//
+// The downloads are not downloaded: their state is set by the tests.
+
+#include "./httplib.h"
+
+#include <pugixml.hpp>
+
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+class Aria2Stub
+{
+  public:
+    struct Download
+    {
+      std::string status;
+      std::string followedBy;
+      uint64_t totalLength = 0;
+      uint64_t completedLength = 0;
+      std::string path;
+      std::string uri;
+    };
+
+    const std::string secret = "stubsecret";
+
+    /* If `start` is false, the connections are accepted but not answered
+     * until start() is called (as for an aria2c still starting). */
+    explicit Aria2Stub(bool start = true)
+    {
+      m_server.Post("/rpc", [this](const httplib::Request& req, httplib::Response& res) {
+        res.set_content(handle(req.body), "text/xml");
+      });
+      m_port = m_server.bind_to_any_port("127.0.0.1");
+      if (start) {
+        this->start();
+      }
+    }
+
+    ~Aria2Stub()
+    {
+      m_server.stop();
+      if (m_thread.joinable()) {
+        m_thread.join();
+      }
+    }
+
+    void start()
+    {
+      m_thread = std::thread([this]() { m_server.listen_after_bind(); });
+    }
+
+    int port() const { return m_port; }
+
+    void setDownload(const std::string& gid, const Download& download)
+    {
+      std::lock_guard<std::mutex> lock(m_lock);
+      m_downloads[gid] = download;
+    }
+
+    Download getDownload(const std::string& gid)
+    {
+      std::lock_guard<std::mutex> lock(m_lock);
+      return m_downloads.at(gid);
+    }
+
+    // The number of http requests made for each method.
+    int getRequestCount(const std::string& method)
+    {
+      std::lock_guard<std::mutex> lock(m_lock);
+      return m_requestCounts[method];
+    }
+
+  private:
+    typedef std::vector<pugi::xml_node> Values;
+
+    static std::string str(const std::string& value)
+    {
+      return "<value><string>" + value + "</string></value>";
+    }
+
+    static std::string member(const std::string& name, const std::string& value)
+    {
+      return "<member><name>" + name + "</name>" + value + "</member>";
+    }
+
+    static std::string array(const std::string& values)
+    {
+      return "<value><array><data>" + values + "</data></array></value>";
+    }
+
+    static std::string fault(const std::string& message)
+    {
+      return "<value><struct>"
+             + member("faultCode", "<value><int>1</int></value>")
+             + member("faultString", str(message))
+             + "</struct></value>";
+    }
+
+    static Values children(const pugi::xml_node& node)
+    {
+      Values values;
+      for (auto value = node.child("value"); value; value = value.next_sibling("value")) {
+        values.push_back(value);
+      }
+      return values;
+    }
+
+    static std::string asString(const pugi::xml_node& value)
+    {
+      return value.child("string").child_value();
+    }
+
+    std::string status(const std::string& gid, const Download& download)
+    {
+      std::ostringstream ss;
+      ss << "<value><struct>"
+         << member("gid", str(gid))
+         << member("status", str(download.status))
+         << member("totalLength", str(std::to_string(download.totalLength)))
+         << member("completedLength", str(std::to_string(download.completedLength)))
+         << member("downloadSpeed", str("0"))
+         << member("files", array("<value><struct>"
+                                  + member("path", str(download.path))
+                                  + member("uris", array("<value><struct>"
+                                                         + member("uri", str(download.uri))
+                                                         + "</struct></value>"))
+                                  + "</struct></value>"));
+      if (!download.followedBy.empty()) {
+        ss << member("followedBy", array(str(download.followedBy)));
+      }
+      ss << "</struct></value>";
+      return ss.str();
+    }
+
+    std::string gids(const std::vector<std::string>& statuses, size_t offset, size_t count)
+    {
+      std::string values;
+      size_t index = 0;
+      for (const auto& p : m_downloads) {
+        if (std::find(statuses.begin(), statuses.end(), p.second.status) == statuses.end()) {
+          continue;
+        }
+        if (index >= offset && index < offset + count) {
+          values += "<value><struct>" + member("gid", str(p.first)) + "</struct></value>";
+        }
+        index++;
+      }
+      return array(values);
+    }
+
+    // Return the value returned by the method, or a fault.
+    std::string call(const std::string& method, const Values& params, bool* isFault)
+    {
+      *isFault = true;
+      if (params.empty() || asString(params[0]) != "token:" + secret) {
+        return fault("Unauthorized");
+      }
+      if (method == "aria2.tellStatus" && params.size() >= 2) {
+        const auto it = m_downloads.find(asString(params[1]));
+        if (it == m_downloads.end()) {
+          return fault("GID not found");
+        }
+        *isFault = false;
+        return status(it->first, it->second);
+      }
+      if (method == "aria2.tellActive") {
+        *isFault = false;
+        return gids({"active"}, 0, m_downloads.size());
+      }
+      if (method == "aria2.tellWaiting" && params.size() >= 3) {
+        *isFault = false;
+        return gids({"waiting", "paused"},
+                    params[1].child("int").text().as_int(),
+                    params[2].child("int").text().as_int());
+      }
+      if (method == "aria2.addUri" && params.size() >= 2) {
+        const auto gid = "added" + std::to_string(m_downloads.size());
+        auto& download = m_downloads[gid];
+        download.status = "waiting";
+        download.uri = asString(children(params[1].child("array").child("data"))[0]);
+        *isFault = false;
+        return str(gid);
+      }
+      return fault("Unknown method " + method);
+    }
+
+    std::string handle(const std::string& body)
+    {
+      pugi::xml_document doc;
+      doc.load_string(body.c_str());
+      const auto methodCall = doc.child("methodCall");
+      const std::string method = methodCall.child("methodName").child_value();
+      Values params;
+      for (auto param = methodCall.child("params").child("param"); param; param = param.next_sibling("param")) {
+        params.push_back(param.child("value"));
+      }
+
+      std::lock_guard<std::mutex> lock(m_lock);
+      m_requestCounts[method]++;
+      bool isFault = false;
+      std::string result;
+      if (method == "system.multicall" && !params.empty()) {
+        std::string results;
+        for (auto call_ : children(params[0].child("array").child("data"))) {
+          std::string name;
+          Values callParams;
+          for (auto m = call_.child("struct").child("member"); m; m = m.next_sibling("member")) {
+            const std::string memberName = m.child("name").child_value();
+            if (memberName == "methodName") {
+              name = asString(m.child("value"));
+            } else if (memberName == "params") {
+              callParams = children(m.child("value").child("array").child("data"));
+            }
+          }
+          bool callFault;
+          const auto value = call(name, callParams, &callFault);
+          results += callFault ? value : array(value);
+        }
+        result = array(results);
+      } else {
+        result = call(method, params, &isFault);
+      }
+
+      if (isFault) {
+        return "<?xml version=\"1.0\"?><methodResponse><fault>" + result + "</fault></methodResponse>";
+      }
+      return "<?xml version=\"1.0\"?><methodResponse><params><param>"
+             + result + "</param></params></methodResponse>";
+    }
+
+    httplib::Server m_server;
+    int m_port;
+    std::thread m_thread;
+    std::mutex m_lock;
+    std::map<std::string, Download> m_downloads;
+    std::map<std::string, int> m_requestCounts;
+};
+
+#endif // KIWIX_TEST_ARIA2_STUB_H
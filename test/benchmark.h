@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2021 Kiwix <contact@kiwix.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef KIWIX_TEST_BENCHMARK_H
+#define KIWIX_TEST_BENCHMARK_H
+
+// Small helpers shared by the benchmark executables.
+// They are not unit tests: they only measure and report numbers as JSON so
+// that runs can be compared between two builds.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace benchmark
+{
+
+typedef std::chrono::steady_clock Clock;
+
+inline uint64_t elapsedNs(Clock::time_point start, Clock::time_point end)
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+}
+
+/* Collected measures (in nanoseconds) of a single benchmark case. */
+class Samples
+{
+  public:
+    void add(uint64_t ns) { m_values.push_back(ns); }
+    void merge(const Samples& other) {
+      m_values.insert(m_values.end(), other.m_values.begin(), other.m_values.end());
+    }
+    size_t size() const { return m_values.size(); }
+
+    /* Return the `q` quantile (0 <= q <= 1). Sorts the samples. */
+    uint64_t quantile(double q) {
+      if (m_values.empty()) {
+        return 0;
+      }
+      std::sort(m_values.begin(), m_values.end());
+      size_t index = static_cast<size_t>(q * (m_values.size() - 1) + 0.5);
+      return m_values[std::min(index, m_values.size() - 1)];
+    }
+
+    uint64_t mean() const {
+      if (m_values.empty()) {
+        return 0;
+      }
+      long double total = 0;
+      for (auto v : m_values) {
+        total += v;
+      }
+      return static_cast<uint64_t>(total / m_values.size());
+    }
+
+  private:
+    std::vector<uint64_t> m_values;
+};
+
+inline std::string jsonEscape(const std::string& s)
+{
+  std::string ret;
+  for (auto c : s) {
+    switch (c) {
+      case '"':  ret += "\\\""; break;
+      case '\\': ret += "\\\\"; break;
+      case '\n': ret += "\\n"; break;
+      default:   ret += c;
+    }
+  }
+  return ret;
+}
+
+/* Minimal JSON object writer (flat key/value pairs and nested objects). */
+class JsonObject
+{
+  public:
+    JsonObject& add(const std::string& key, const std::string& value) {
+      return addRaw(key, "\"" + jsonEscape(value) + "\"");
+    }
+    JsonObject& add(const std::string& key, const char* value) {
+      return add(key, std::string(value));
+    }
+    template<typename T>
+    JsonObject& add(const std::string& key, T value) {
+      std::ostringstream ss;
+      ss << value;
+      return addRaw(key, ss.str());
+    }
+    JsonObject& add(const std::string& key, const JsonObject& value) {
+      return addRaw(key, value.str());
+    }
+    JsonObject& add(const std::string& key, const std::vector<JsonObject>& values) {
+      std::string list = "[";
+      for (size_t i = 0; i < values.size(); i++) {
+        list += (i ? ", " : "") + values[i].str();
+      }
+      return addRaw(key, list + "]");
+    }
+    std::string str() const { return "{" + m_content + "}"; }
+
+  private:
+    JsonObject& addRaw(const std::string& key, const std::string& value) {
+      if (!m_content.empty()) {
+        m_content += ", ";
+      }
+      m_content += "\"" + jsonEscape(key) + "\": " + value;
+      return *this;
+    }
+    std::string m_content;
+};
+
+/* Latency summary (in microseconds) of a set of samples. */
+inline JsonObject latencySummary(Samples& samples)
+{
+  JsonObject o;
+  o.add("mean", samples.mean() / 1000.0)
+   .add("p50", samples.quantile(0.5) / 1000.0)
+   .add("p99", samples.quantile(0.99) / 1000.0)
+   .add("p999", samples.quantile(0.999) / 1000.0)
+   .add("max", samples.quantile(1) / 1000.0);
+  return o;
+}
+
+/* Write the report on stdout, and in `outputPath` if not empty. */
+inline void writeReport(const JsonObject& report, const std::string& outputPath)
+{
+  const auto content = report.str();
+  std::cout << content << std::endl;
+  if (!outputPath.empty()) {
+    std::ofstream out(outputPath);
+    out << content << std::endl;
+  }
+}
+
+/* Parse the `--name value` option from the command line. */
+inline std::string getOption(int argc, char** argv, const std::string& name, const std::string& defaultValue)
+{
+  for (int i = 1; i + 1 < argc; i++) {
+    if (name == argv[i]) {
+      return argv[i + 1];
+    }
+  }
+  return defaultValue;
+}
+
+inline long getOption(int argc, char** argv, const std::string& name, long defaultValue)
+{
+  const auto value = getOption(argc, argv, name, std::string());
+  return value.empty() ? defaultValue : std::strtol(value.c_str(), nullptr, 10);
+}
+
+} // namespace benchmark
+
+#endif // KIWIX_TEST_BENCHMARK_H
@@ -68,6 +68,9 @@ TEST(BookTest, updateFromXMLTest)
             articleCount="123456"
             mediaCount="234567"
             size="345678"
+            integrity="valid"
+            integrityFileSize="353974272"
+            integrityFileMtime="1600000000"
           >
       </book>
     )");
@@ -85,6 +88,9 @@ TEST(BookTest, updateFromXMLTest)
     EXPECT_EQ(book.getArticleCount(), 123456U);
     EXPECT_EQ(book.getMediaCount(), 234567U);
     EXPECT_EQ(book.getSize(), 345678U*1024U);
+    EXPECT_EQ(book.getIntegrity().status, kiwix::Book::Integrity::VALID);
+    EXPECT_EQ(book.getIntegrity().fileSize, 353974272U);
+    EXPECT_EQ(book.getIntegrity().fileMtime, 1600000000);
 }
 
 TEST(BookTest, updateFromXMLCategoryHandlingTest)
@@ -166,3 +172,32 @@ TEST(BookTest, updateCopiesCategory)
     newBook.update(book);
     EXPECT_EQ(newBook.getCategory(), "ted");
 }
+
+TEST(BookTest, equality)
+{
+    kiwix::Book book;
+    book.setId("xyz");
+    book.setTitle("title");
+    book.setFavicon("favicon");
+
+    kiwix::Book other = book;
+    EXPECT_TRUE(book == other);
+
+    // Same favicon content in another string
+    other.setFavicon("favicon");
+    EXPECT_TRUE(book == other);
+    other.setFavicon("other favicon");
+    EXPECT_FALSE(book == other);
+    other.setFavicon("");
+    EXPECT_TRUE(book != other);
+
+    other = book;
+    other.setTitle("other title");
+    EXPECT_TRUE(book != other);
+
+    other = book;
+    auto integrity = other.getIntegrity();
+    integrity.status = kiwix::Book::Integrity::VALID;
+    other.setIntegrity(integrity);
+    EXPECT_FALSE(book == other);
+}
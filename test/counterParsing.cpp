@@ -21,11 +21,14 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <cstdint>
 #include <zim/zim.h>
 
 namespace kiwix {
 using CounterType = std::map<const std::string, zim::entry_index_type>;
 CounterType parseMimetypeCounter(const std::string& counterData);
+void countArticlesAndMedias(const std::string& counterData,
+                            uint64_t& articleCount, uint64_t& mediaCount);
 };
 
 using namespace kiwix;
@@ -140,4 +143,18 @@ TEST(ParseCounterTest, wrongType)
   }
 }
 
+TEST(ParseCounterTest, articlesAndMedias)
+{
+  uint64_t articleCount = 1, mediaCount = 1;
+  countArticlesAndMedias("text/html=50;text/html;raw=true=3;image/png=7;video/webm=2;"
+                         "audio/ogg=1;application/javascript=9",
+                         articleCount, mediaCount);
+  EXPECT_EQ(articleCount, 53U);
+  EXPECT_EQ(mediaCount, 10U);
+
+  countArticlesAndMedias("", articleCount, mediaCount);
+  EXPECT_EQ(articleCount, 0U);
+  EXPECT_EQ(mediaCount, 0U);
+}
+
 };
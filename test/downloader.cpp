@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2021 Kiwix <contact@kiwix.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#include "gtest/gtest.h"
+#include "aria2_stub.h"
+
+#include "../include/downloader.h"
+#include "../src/aria2.h"
+
+#include <chrono>
+#include <condition_variable>
+
+namespace
+{
+
+Aria2Stub::Download stubDownload(const std::string& status, uint64_t completedLength = 0)
+{
+  Aria2Stub::Download download;
+  download.status = status;
+  download.totalLength = 1000;
+  download.completedLength = completedLength;
+  download.path = "/data/" + status + ".zim";
+  download.uri = "http://example.com/" + status + ".zim";
+  return download;
+}
+
+class DownloaderTest : public ::testing::Test
+{
+  protected:
+    void SetUp() override {
+      stub.setDownload("active", stubDownload("active", 10));
+      stub.setDownload("paused", stubDownload("paused", 20));
+      for (int i = 0; i < 150; i++) {
+        stub.setDownload("waiting" + std::to_string(i), stubDownload("waiting"));
+      }
+      stub.setDownload("complete", stubDownload("complete", 1000));
+    }
+
+    std::unique_ptr<kiwix::Downloader> createDownloader() {
+      auto aria = std::make_shared<kiwix::Aria2>(stub.port(), stub.secret);
+      std::unique_ptr<kiwix::Downloader> downloader(new kiwix::Downloader(aria));
+      downloader->getReadyFuture().get();
+      return downloader;
+    }
+
+    Aria2Stub stub;
+};
+
+} // unnamed namespace
+
+TEST_F(DownloaderTest, readKnownDownloads)
+{
+  auto downloader = createDownloader();
+  // All the running downloads (the complete one is not running).
+  EXPECT_EQ(downloader->getNbDownload(), 152U);
+  EXPECT_EQ(stub.getRequestCount("aria2.tellWaiting"), 2);
+  // The statuses are read with one request
+  EXPECT_EQ(stub.getRequestCount("aria2.tellStatus"), 0);
+  EXPECT_EQ(stub.getRequestCount("system.multicall"), 1);
+}
+
+TEST_F(DownloaderTest, updateDownloads)
+{
+  auto downloader = createDownloader();
+  auto active = downloader->getDownload("active");
+  EXPECT_EQ(active->getStatus(), kiwix::Download::K_ACTIVE);
+  EXPECT_EQ(active->getCompletedLength(), 10U);
+  EXPECT_EQ(active->getPath(), "/data/active.zim");
+
+  // A metalink download, followed by the download of the zim file.
+  auto metalink = stubDownload("complete", 1000);
+  metalink.followedBy = "zim";
+  stub.setDownload("active", metalink);
+  stub.setDownload("zim", stubDownload("active", 500));
+  stub.setDownload("paused", stubDownload("active", 30));
+
+  const auto multicalls = stub.getRequestCount("system.multicall");
+  downloader->updateDownloads();
+  // One request for all the downloads, and one for the followed download.
+  EXPECT_EQ(stub.getRequestCount("system.multicall"), multicalls + 2);
+  EXPECT_EQ(active->getStatus(), kiwix::Download::K_ACTIVE);
+  EXPECT_EQ(active->getFollowedBy(), "zim");
+  EXPECT_EQ(active->getCompletedLength(), 500U);
+  auto paused = downloader->getDownload("paused");
+  EXPECT_EQ(paused->getStatus(), kiwix::Download::K_ACTIVE);
+  EXPECT_EQ(paused->getCompletedLength(), 30U);
+
+  downloader->updateDownloads();
+  EXPECT_EQ(stub.getRequestCount("system.multicall"), multicalls + 3);
+}
+
+TEST_F(DownloaderTest, getDownload)
+{
+  auto downloader = createDownloader();
+  stub.setDownload("new", stubDownload("active", 42));
+  const auto download = downloader->getDownload("new");
+  EXPECT_EQ(download->getCompletedLength(), 42U);
+  EXPECT_EQ(downloader->getNbDownload(), 153U);
+
+  EXPECT_THROW(downloader->getDownload("complete"), std::out_of_range);
+  EXPECT_THROW(downloader->getDownload("unknown"), std::exception);
+  EXPECT_EQ(downloader->getNbDownload(), 153U);
+}
+
+TEST_F(DownloaderTest, polling)
+{
+  auto downloader = createDownloader();
+  std::mutex lock;
+  std::condition_variable changed;
+  std::vector<std::pair<std::string, kiwix::Download::StatusResult>> changes;
+
+  downloader->startPolling(10, [&](const kiwix::Download& download,
+                                   kiwix::Download::StatusResult previousStatus) {
+    std::lock_guard<std::mutex> l(lock);
+    if (previousStatus != kiwix::Download::K_UNKNOWN) {
+      changes.emplace_back(download.getDid(), previousStatus);
+      changed.notify_all();
+    }
+  });
+
+  // Wait for a first poll
+  const auto start = std::chrono::steady_clock::now();
+  while (downloader->getDownloadSnapshots().size() != 152U
+      && std::chrono::steady_clock::now() - start < std::chrono::seconds(10)) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  auto snapshots = downloader->getDownloadSnapshots();
+  ASSERT_EQ(snapshots.size(), 152U);
+  EXPECT_EQ(snapshots.at("paused").getStatus(), kiwix::Download::K_PAUSED);
+
+  stub.setDownload("paused", stubDownload("complete", 1000));
+  {
+    std::unique_lock<std::mutex> l(lock);
+    ASSERT_TRUE(changed.wait_for(l, std::chrono::seconds(10), [&]() { return !changes.empty(); }));
+    EXPECT_EQ(changes[0].first, "paused");
+    EXPECT_EQ(changes[0].second, kiwix::Download::K_PAUSED);
+  }
+  downloader->stopPolling();
+
+  snapshots = downloader->getDownloadSnapshots();
+  EXPECT_EQ(snapshots.at("paused").getStatus(), kiwix::Download::K_COMPLETE);
+  // The poller only sends multicall requests
+  EXPECT_EQ(stub.getRequestCount("aria2.tellStatus"), 0);
+}
+
+TEST(DownloaderStartTest, queueDownloadsUntilReady)
+{
+  Aria2Stub stub(false);
+  auto aria = std::make_shared<kiwix::Aria2>(stub.port(), stub.secret);
+  kiwix::Downloader downloader(aria);
+  EXPECT_FALSE(aria->isReady());
+  EXPECT_FALSE(downloader.isReady());
+
+  auto download = downloader.startDownload("http://example.com/queued.zim");
+  EXPECT_EQ(download->getDid(), "");
+  EXPECT_EQ(download->getStatus(), kiwix::Download::K_UNKNOWN);
+  EXPECT_EQ(downloader.startDownload("http://example.com/queued.zim"), download);
+  EXPECT_EQ(downloader.getNbDownload(), 0U);
+
+  stub.start();
+  auto ready = downloader.getReadyFuture();
+  ASSERT_EQ(ready.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+  ready.get();
+  EXPECT_TRUE(aria->isReady());
+  EXPECT_TRUE(downloader.isReady());
+
+  EXPECT_EQ(stub.getRequestCount("aria2.addUri"), 1);
+  EXPECT_NE(download->getDid(), "");
+  EXPECT_EQ(downloader.getDownload(download->getDid()), download);
+  EXPECT_EQ(stub.getDownload(download->getDid()).uri, "http://example.com/queued.zim");
+  EXPECT_EQ(downloader.getNbDownload(), 1U);
+}
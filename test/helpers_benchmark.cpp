@@ -0,0 +1,348 @@
+/*
+ * Copyright (C) 2021 Kiwix <contact@kiwix.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+// Microbenchmarks of the helpers sitting on the hot paths of the library
+// and of the server.
+//
+// Inputs are generated to look like real ones (a ~200KB wikipedia article,
+// a 10k books library, multilingual queries) so that no big data file has
+// to be stored in the repository.
+//
+// Usage:
+//   helpers_benchmark [--filter <substring>] [--samples N] [--output report.json]
+
+#include "benchmark.h"
+
+#include "../include/library.h"
+#include "../include/manager.h"
+#include "../src/server/byte_range.h"
+#include "../src/server/etag.h"
+#include "../src/tools/otherTools.h"
+#include "../src/tools/pathTools.h"
+#include "../src/tools/regexTools.h"
+#include "../src/tools/stringTools.h"
+
+#include <functional>
+
+namespace
+{
+
+const std::vector<std::string> QUERIES {
+  "ray charles",
+  "Ray CHARLES piano",
+  "Érdős Pál és a gráfelmélet",
+  "Ελληνική Βικιπαίδεια",
+  "Москва — столица России",
+  "東京都の歴史",
+  "الموسوعة الحرة",
+  "naïve café à la crème brûlée",
+};
+
+const std::vector<std::string> LANGS { "eng", "fra", "deu", "rus", "jpn", "ara", "hun", "ell" };
+
+std::string wikipediaLikeArticle()
+{
+  std::string html =
+    "<!DOCTYPE html>\n<html class=\"client-js\"><head>\n"
+    "<meta charset=\"UTF-8\">\n<title>Ray Charles</title>\n"
+    "<link rel=\"stylesheet\" href=\"../-/s/css_modules/style.css\">\n"
+    "<script src=\"../-/j/js_modules/script.js\"></script>\n"
+    "</head>\n<body class=\"mw-body\" id=\"mw-content-text\">\n";
+  size_t paragraph = 0;
+  while (html.size() < 200 * 1024) {
+    html += "<h2 id=\"Section_" + std::to_string(paragraph) + "\">Section "
+          + std::to_string(paragraph) + "</h2>\n<p>Ray Charles Robinson "
+            "(<a href=\"./September_23\" title=\"September 23\">September 23</a>, 1930 – "
+            "June 10, 2004) was an American singer, songwriter, pianist and composer. "
+            "Among friends and fellow musicians he preferred being called \"Brother Ray\". "
+            "He was often referred to as \"The Genius\". Charles was blind from the age of seven."
+            "<sup id=\"cite_ref-" + std::to_string(paragraph) + "\" class=\"reference\">"
+            "<a href=\"#cite_note-" + std::to_string(paragraph) + "\">[" + std::to_string(paragraph) + "]</a></sup>"
+            " Éléments — Ελληνικά — Русский — 日本語.</p>\n";
+    paragraph++;
+  }
+  html += "</body>\n</html>\n";
+  return html;
+}
+
+std::string libraryXml(size_t bookCount)
+{
+  std::string xml = "<library version=\"20110515\">\n";
+  for (size_t i = 0; i < bookCount; i++) {
+    const auto n = std::to_string(i);
+    const auto& lang = LANGS[i % LANGS.size()];
+    const auto& title = QUERIES[i % QUERIES.size()];
+    xml += "  <book id=\"" + kiwix::gen_uuid(n) + "\""
+           " path=\"/data/zim/book_" + n + ".zim\""
+           " url=\"https://download.kiwix.org/zim/book_" + n + ".zim.meta4\""
+           " title=\"" + title + " " + n + "\""
+           " description=\"Description of the book number " + n + " about " + title + "\""
+           " language=\"" + lang + "\""
+           " creator=\"Creator " + std::to_string(i % 97) + "\""
+           " publisher=\"Publisher " + std::to_string(i % 13) + "\""
+           " date=\"20" + std::to_string(10 + i % 12) + "-0" + std::to_string(1 + i % 9) + "-15\""
+           " name=\"book_" + lang + "_" + std::to_string(i % 500) + "\""
+           " tags=\"_category:" + (i % 3 ? "wikipedia" : "wiktionary") + ";_pictures:no;_ftindex:yes\""
+           " articleCount=\"" + std::to_string(1000 + i * 7) + "\""
+           " mediaCount=\"" + std::to_string(i * 3) + "\""
+           " size=\"" + std::to_string(1024 + (i * 7919) % 1000000) + "\""
+           "></book>\n";
+  }
+  xml += "</library>\n";
+  return xml;
+}
+
+std::string counterMetadata()
+{
+  return "application/javascript=8;text/html=111;application/warc-headers=28364;"
+         "text/html;raw=true=6336;text/css=47;text/javascript=98;image/png=968;"
+         "image/webp=24;application/json=3694;image/gif=10274;image/jpeg=1582;"
+         "font/woff2=25;text/plain=284;application/atom+xml=247;"
+         "application/x-www-form-urlencoded=9;video/mp4=9;"
+         "application/x-javascript=7;application/xml=1;image/svg+xml=5";
+}
+
+const char CATALOG_TEMPLATE[] = R"(<feed>
+  <id>{{feed_id}}</id>
+  <updated>{{date}}</updated>
+  {{#books}}
+  <entry>
+    <id>urn:uuid:{{id}}</id>
+    <title>{{title}}</title>
+    <summary>{{description}}</summary>
+    <language>{{language}}</language>
+    <name>{{name}}</name>
+    <tags>{{tags}}</tags>
+    <link type="text/html" href="{{root}}/{{{content_id}}}" />
+  </entry>
+  {{/books}}
+</feed>
+)";
+
+kainjow::mustache::data catalogTemplateData(size_t bookCount)
+{
+  kainjow::mustache::list books;
+  for (size_t i = 0; i < bookCount; i++) {
+    const auto n = std::to_string(i);
+    books.push_back(kainjow::mustache::object{
+      {"id", kiwix::gen_uuid(n)},
+      {"title", QUERIES[i % QUERIES.size()] + " & co"},
+      {"description", "Description of <book> " + n},
+      {"language", LANGS[i % LANGS.size()]},
+      {"name", "book_" + n},
+      {"tags", "_category:wikipedia;_pictures:no"},
+      {"root", "/kiwix"},
+      {"content_id", "book_" + n},
+    });
+  }
+  return kainjow::mustache::object{
+    {"feed_id", kiwix::gen_uuid("feed")},
+    {"date", "2021-06-01T00:00:00Z"},
+    {"books", books}
+  };
+}
+
+class BenchmarkRunner
+{
+  public:
+    BenchmarkRunner(const std::string& filter, size_t nbSamples)
+      : m_filter(filter), m_nbSamples(nbSamples) {}
+
+    // Run `fn` `nbSamples` times, each sample calling it `batchSize` times.
+    // Reported times are per call of `fn`.
+    void run(const std::string& name, size_t batchSize, const std::function<void()>& fn)
+    {
+      if (name.find(m_filter) == std::string::npos) {
+        return;
+      }
+      fn(); // warm up
+      benchmark::Samples samples;
+      for (size_t s = 0; s < m_nbSamples; s++) {
+        const auto start = benchmark::Clock::now();
+        for (size_t i = 0; i < batchSize; i++) {
+          fn();
+        }
+        samples.add(benchmark::elapsedNs(start, benchmark::Clock::now()) / batchSize);
+      }
+      benchmark::JsonObject o;
+      o.add("name", name)
+       .add("samples", m_nbSamples)
+       .add("calls_per_sample", batchSize)
+       .add("mean_ns", samples.mean())
+       .add("p50_ns", samples.quantile(0.5))
+       .add("p99_ns", samples.quantile(0.99))
+       .add("min_ns", samples.quantile(0));
+      m_results.push_back(o);
+      std::cerr << name << ": " << samples.quantile(0.5) << " ns" << std::endl;
+    }
+
+    const std::vector<benchmark::JsonObject>& results() const { return m_results; }
+
+  private:
+    std::string m_filter;
+    size_t m_nbSamples;
+    std::vector<benchmark::JsonObject> m_results;
+};
+
+// Prevent the compiler from optimizing out unused results.
+volatile size_t sink;
+
+} // unnamed namespace
+
+int main(int argc, char** argv)
+{
+  const std::string filter = benchmark::getOption(argc, argv, "--filter", std::string());
+  const size_t nbSamples = benchmark::getOption(argc, argv, "--samples", 50L);
+  const std::string outputPath = benchmark::getOption(argc, argv, "--output", std::string());
+
+  BenchmarkRunner runner(filter, nbSamples);
+
+  // String tools
+  for (size_t i = 0; i < QUERIES.size(); i++) {
+    const auto& query = QUERIES[i];
+    runner.run("removeAccents/" + std::to_string(i), 100, [&]() {
+      sink = kiwix::removeAccents(query).size();
+    });
+  }
+
+  std::string longUrl;
+  for (const auto& query : QUERIES) {
+    longUrl += "/search?content=wikipedia&pattern=" + query + "&lang=" + LANGS[0] + "#";
+  }
+  const auto encodedUrl = kiwix::urlEncode(longUrl, true);
+  runner.run("urlEncode", 100, [&]() {
+    sink = kiwix::urlEncode(longUrl, true).size();
+  });
+  runner.run("urlDecode", 100, [&]() {
+    sink = kiwix::urlDecode(encodedUrl, true).size();
+  });
+
+  // Html injection
+  const auto article = wikipediaLikeArticle();
+  runner.run("prependToFirstOccurence/head", 10, [&]() {
+    sink = prependToFirstOccurence(article, "</head[ \\t]*>", "<link type=\"root\" href=\"/kiwix\">").size();
+  });
+  runner.run("appendToFirstOccurence/body", 10, [&]() {
+    sink = appendToFirstOccurence(article, "<body[^>]*>", "<span class=\"kiwix\"></span>").size();
+  });
+
+  // Templates
+  const auto templateData = catalogTemplateData(100);
+  runner.run("render_template/catalog100", 5, [&]() {
+    sink = kiwix::render_template(CATALOG_TEMPLATE, templateData).size();
+  });
+
+  // Server helpers
+  const std::vector<std::string> ranges {
+    "bytes=0-1023", "bytes=123456-", "bytes=-500", "bytes=0-0,-1", "items=0-10"
+  };
+  runner.run("ByteRange::parse", 1000, [&]() {
+    for (const auto& r : ranges) {
+      sink = kiwix::ByteRange::parse(r).kind();
+    }
+  });
+  const std::string etags = "\"abcdefghijk/c\", W/\"0123456789/z\", \"serverid1234/cz\"";
+  runner.run("ETag::match", 1000, [&]() {
+    sink = bool(kiwix::ETag::match(etags, "serverid1234"));
+  });
+  const auto counter = counterMetadata();
+  runner.run("parseMimetypeCounter", 1000, [&]() {
+    sink = kiwix::parseMimetypeCounter(counter).size();
+  });
+
+  // Library
+  kiwix::Library library;
+  {
+    const auto start = benchmark::Clock::now();
+    kiwix::Manager manager(&library);
+    manager.readXml(libraryXml(10000), true, "", true);
+    std::cerr << "Library loading: " << benchmark::elapsedNs(start, benchmark::Clock::now()) / 1000000 << " ms" << std::endl;
+  }
+  runner.run("Library::filter/all", 1, [&]() {
+    sink = library.filter(kiwix::Filter()).size();
+  });
+  runner.run("Library::filter/local_valid", 1, [&]() {
+    sink = library.filter(kiwix::Filter().local(true).valid(true)).size();
+  });
+  runner.run("Library::filter/lang", 1, [&]() {
+    sink = library.filter(kiwix::Filter().lang("fra")).size();
+  });
+  runner.run("Library::filter/category_lang", 1, [&]() {
+    sink = library.filter(kiwix::Filter().category("wiktionary").lang("rus")).size();
+  });
+  for (size_t i = 0; i < QUERIES.size(); i++) {
+    const auto& query = QUERIES[i];
+    runner.run("Library::filter/query/" + std::to_string(i), 1, [&]() {
+      sink = library.filter(kiwix::Filter().query(query)).size();
+    });
+  }
+  runner.run("Library::filter/page/lang", 1, [&]() {
+    size_t total;
+    sink = library.filter(kiwix::Filter().lang("fra"), kiwix::UNSORTED, true, 100, 10, total).size();
+  });
+  runner.run("Library::filter/page/query_sorted", 1, [&]() {
+    size_t total;
+    sink = library.filter(kiwix::Filter().query(QUERIES[0]), kiwix::TITLE, true, 0, 10, total).size();
+  });
+  const auto allBooks = library.getBooksIds();
+  for (const auto& sortBy : { std::make_pair("title", kiwix::TITLE),
+                              std::make_pair("size", kiwix::SIZE),
+                              std::make_pair("date", kiwix::DATE),
+                              std::make_pair("creator", kiwix::CREATOR),
+                              std::make_pair("publisher", kiwix::PUBLISHER) }) {
+    runner.run(std::string("Library::sort/") + sortBy.first, 1, [&]() {
+      auto ids = allBooks;
+      library.sort(ids, sortBy.second, true);
+      sink = ids.size();
+    });
+  }
+
+  // Library snapshots, the indexes being built from scratch or the
+  // documents of a book database being reused.
+  const auto tmpDir = makeTmpDirectory();
+  const std::string snapshotPath = tmpDir + "/benchmark_snapshot.bin";
+  const std::string bookDBPath = tmpDir + "/benchmark_bookdb";
+  if (library.writeSnapshot(snapshotPath)) {
+    {
+      kiwix::Library dbLibrary;
+      dbLibrary.openBookDB(bookDBPath);
+      dbLibrary.readSnapshot(snapshotPath);
+      dbLibrary.commitBookDB();
+    }
+    runner.run("Library::readSnapshot/in_memory", 1, [&]() {
+      kiwix::Library lib;
+      lib.readSnapshot(snapshotPath);
+      sink = lib.getBookCount(true, true);
+    });
+    runner.run("Library::readSnapshot/bookdb", 1, [&]() {
+      kiwix::Library lib;
+      lib.openBookDB(bookDBPath);
+      lib.readSnapshot(snapshotPath);
+      lib.commitBookDB();
+      sink = lib.getBookCount(true, true);
+    });
+  }
+  removeDirectory(tmpDir);
+
+  benchmark::JsonObject report;
+  report.add("benchmark", "helpers")
+        .add("results", runner.results());
+  benchmark::writeReport(report, outputPath);
+  return 0;
+}
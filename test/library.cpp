@@ -18,7 +18,12 @@
  */
 
 #include "gtest/gtest.h"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
 #include <string>
+#include <thread>
 
 
 const char * sampleOpdsStream = R"(
@@ -220,6 +225,31 @@ const char sampleLibraryXML[] = R"(
 #include "../include/library.h"
 #include "../include/manager.h"
 #include "../include/bookmark.h"
+#include "../include/opds_dumper.h"
+#include "../include/name_mapper.h"
+#include "../src/opds_entry_cache.h"
+#include "../src/tools/pathTools.h"
+
+#include <xapian.h>
+
+namespace
+{
+
+// A temporary directory, removed with its content.
+class TmpDir
+{
+  public:
+    TmpDir() : path(makeTmpDirectory()) {}
+    ~TmpDir() { removeDirectory(path); }
+    TmpDir(const TmpDir&) = delete;
+    TmpDir& operator=(const TmpDir&) = delete;
+
+    std::string file(const std::string& name) const { return path + "/" + name; }
+
+    const std::string path;
+};
+
+} // unnamed namespace
 
 namespace
 {
@@ -272,6 +302,33 @@ TEST_F(LibraryTest, getBookMarksTest)
     EXPECT_EQ(allBookmarks[2].getBookId(), bookId2);
 }
 
+TEST_F(LibraryTest, removeBookmark)
+{
+    auto bookId = lib.getBooksIds()[0];
+    auto bookmark = createBookmark(bookId);
+    bookmark.setUrl("A/first");
+    lib.addBookmark(bookmark);
+    bookmark.setUrl("A/second");
+    bookmark.setTitle("Second");
+    lib.addBookmark(bookmark);
+    bookmark.setTitle("Second again");
+    lib.addBookmark(bookmark);
+
+    EXPECT_FALSE(lib.removeBookmark("invalid-bookmark-id", "A/first"));
+    EXPECT_FALSE(lib.removeBookmark(bookId, "A/third"));
+    EXPECT_TRUE(lib.removeBookmark(bookId, "A/second"));
+
+    auto bookmarks = lib.getBookmarks();
+    ASSERT_EQ(bookmarks.size(), 2U);
+    EXPECT_EQ(bookmarks[0].getUrl(), "A/first");
+    EXPECT_EQ(bookmarks[1].getTitle(), "Second again");
+
+    EXPECT_TRUE(lib.removeBookmark(bookId, "A/first"));
+    EXPECT_TRUE(lib.removeBookmark(bookId, "A/second"));
+    EXPECT_FALSE(lib.removeBookmark(bookId, "A/second"));
+    EXPECT_TRUE(lib.getBookmarks(false).empty());
+}
+
 TEST_F(LibraryTest, sanityCheck)
 {
   EXPECT_EQ(lib.getBookCount(true, true), 12U);
@@ -280,6 +337,47 @@ TEST_F(LibraryTest, sanityCheck)
   EXPECT_EQ(lib.getBooksPublishers().size(), 3U);
 }
 
+TEST_F(LibraryTest, attributeCounts)
+{
+  typedef kiwix::Library::AttributeCounts AttributeCounts;
+  EXPECT_EQ(lib.getBooksLanguagesWithCounts(),
+            AttributeCounts({{"deu", 1}, {"eng", 6}, {"fra", 5}}));
+  EXPECT_EQ(lib.getBooksLanguages(), TitleCollection({"deu", "eng", "fra"}));
+
+  const auto categories = lib.getBooksCategoriesWithCounts();
+  EXPECT_NE(std::find(categories.begin(), categories.end(),
+                      std::make_pair(std::string("category_element_overrides_tags"), size_t(2))),
+            categories.end());
+
+  lib.removeBookById("raycharles");
+  EXPECT_EQ(lib.getBooksLanguagesWithCounts(),
+            AttributeCounts({{"deu", 1}, {"eng", 5}, {"fra", 5}}));
+
+  lib.removeBookById("1123e574-6eef-6d54-28fc-13e4caeae474");
+  lib.removeBookById("14829621-c490-c376-0792-9de558b57efa");
+  EXPECT_EQ(lib.getBooksLanguagesWithCounts(),
+            AttributeCounts({{"deu", 1}, {"eng", 5}, {"fra", 3}}));
+  const auto remainingCategories = lib.getBooksCategories();
+  EXPECT_EQ(std::count(remainingCategories.begin(), remainingCategories.end(),
+                       "category_element_overrides_tags"), 0);
+}
+
+TEST_F(LibraryTest, multiLanguageBookCounts)
+{
+  typedef kiwix::Library::AttributeCounts AttributeCounts;
+  kiwix::Book book;
+  book.setId("multilingual");
+  book.setLanguage("eng,fra;eng");
+  lib.addBook(book);
+
+  EXPECT_EQ(lib.getBooksLanguagesWithCounts(),
+            AttributeCounts({{"deu", 1}, {"eng", 7}, {"fra", 6}}));
+  for (const auto& languageCount : lib.getBooksLanguagesWithCounts()) {
+    const auto bookIds = lib.filter(kiwix::Filter().lang(languageCount.first));
+    EXPECT_EQ(bookIds.size(), languageCount.second) << languageCount.first;
+  }
+}
+
 TEST_F(LibraryTest, categoryHandling)
 {
   EXPECT_EQ("", lib.getBookById("0c45160e-f917-760a-9159-dfe3c53cdcdd").getCategory());
@@ -642,6 +740,173 @@ TEST_F(LibraryTest, filterByMultipleCriteria)
   );
 }
 
+TEST_F(LibraryTest, filterByQueryAndFacets)
+{
+  EXPECT_FILTER_RESULTS(kiwix::Filter().query("Exchange").acceptTags({"stackexchange"}).lang("eng"),
+    "Islam Stack Exchange",
+    "Movies & TV Stack Exchange",
+    "Mythology & Folklore Stack Exchange"
+  );
+
+  EXPECT_FILTER_RESULTS(kiwix::Filter().query("Wiki").lang("fra").rejectTags({"nopic"}),
+    "Encyclopédie de la Tunisie"
+  );
+
+  EXPECT_FILTER_RESULTS(kiwix::Filter().query("Exchange").lang("fra"),
+    /* no results */
+  );
+}
+
+TEST_F(LibraryTest, filterByFacetsAfterRemovingAndAddingBooks)
+{
+  const auto book = lib.getBookById("raycharles");
+  lib.removeBookById("raycharles");
+
+  EXPECT_FILTER_RESULTS(kiwix::Filter().acceptTags({"wikipedia"}).rejectTags({"nopic"}),
+    "Encyclopédie de la Tunisie"
+  );
+
+  kiwix::Book otherBook = book;
+  otherBook.setId("raycharles-copy");
+  otherBook.setLanguage("fra");
+  lib.addBook(otherBook);
+  lib.addBook(book);
+
+  EXPECT_FILTER_RESULTS(kiwix::Filter().acceptTags({"wikipedia"}).rejectTags({"nopic"}),
+    "Encyclopédie de la Tunisie",
+    "Ray Charles",
+    "Ray Charles"
+  );
+  EXPECT_FILTER_RESULTS(kiwix::Filter().lang("fra").acceptTags({"wikipedia"}).rejectTags({"nopic"}),
+    "Encyclopédie de la Tunisie",
+    "Ray Charles"
+  );
+  EXPECT_EQ(lib.filter(kiwix::Filter().name(book.getName()).lang("eng")),
+            BookIdCollection{"raycharles"});
+}
+
+TEST_F(LibraryTest, sortByTitle)
+{
+  auto bookIds = lib.filter(kiwix::Filter().query("Wiki"));
+  lib.sort(bookIds, kiwix::TITLE, true);
+  TitleCollection titles;
+  for ( const auto& bookId : bookIds ) {
+    titles.push_back(lib.getBookById(bookId).getTitle());
+  }
+  EXPECT_EQ(titles, TitleCollection({
+    "Encyclopédie de la Tunisie",
+    "Géographie par Wikipédia",
+    "Granblue Fantasy Wiki",
+    "Ray Charles",
+    "Wikiquote"
+  }));
+
+  lib.sort(bookIds, kiwix::TITLE, false);
+  titles.clear();
+  for ( const auto& bookId : bookIds ) {
+    titles.push_back(lib.getBookById(bookId).getTitle());
+  }
+  EXPECT_EQ(titles, TitleCollection({
+    "Wikiquote",
+    "Ray Charles",
+    "Granblue Fantasy Wiki",
+    "Géographie par Wikipédia",
+    "Encyclopédie de la Tunisie"
+  }));
+}
+
+TEST_F(LibraryTest, sortBySize)
+{
+  auto bookIds = lib.getBooksIds();
+  lib.sort(bookIds, kiwix::SIZE, true);
+  ASSERT_EQ(bookIds.size(), lib.getBooksIds().size());
+  for ( size_t i = 1; i < bookIds.size(); ++i ) {
+    EXPECT_LE(lib.getBookById(bookIds[i-1]).getSize(), lib.getBookById(bookIds[i]).getSize());
+  }
+
+  // The order is maintained when books are replaced
+  auto book = lib.getBookById(bookIds.front());
+  book.setSize(lib.getBookById(bookIds.back()).getSize() + 1);
+  lib.removeBookById(book.getId());
+  lib.addBook(book);
+  lib.sort(bookIds, kiwix::SIZE, false);
+  EXPECT_EQ(bookIds.front(), book.getId());
+
+  BookIdCollection someBooks{bookIds[3], book.getId()};
+  lib.sort(someBooks, kiwix::SIZE, true);
+  EXPECT_EQ(someBooks.back(), book.getId());
+
+  EXPECT_THROW(lib.sort(someBooks = {"unknown-book-id"}, kiwix::SIZE, true), std::out_of_range);
+}
+
+TEST_F(LibraryTest, sortTiedKeys)
+{
+  auto book = lib.getBookById("raycharles");
+  book.setId("raycharles-copy");
+  lib.addBook(book);
+
+  for ( auto sortBy : {kiwix::TITLE, kiwix::SIZE, kiwix::DATE} ) {
+    auto ascending = lib.getBooksIds();
+    lib.sort(ascending, sortBy, true);
+    auto descending = lib.getBooksIds();
+    lib.sort(descending, sortBy, false);
+    EXPECT_EQ(BookIdCollection(descending.rbegin(), descending.rend()), ascending);
+
+    // The tied books are next to each other, in the same order as filter().
+    const auto first = std::find(ascending.begin(), ascending.end(), "raycharles");
+    const auto copy = std::find(ascending.begin(), ascending.end(), "raycharles-copy");
+    ASSERT_TRUE(first != ascending.end() && copy != ascending.end());
+    EXPECT_EQ(std::abs(first - copy), 1);
+    size_t totalCount = 0;
+    EXPECT_EQ(lib.filter(kiwix::Filter(), sortBy, true, 0, ascending.size(), totalCount), ascending);
+    EXPECT_EQ(lib.filter(kiwix::Filter(), sortBy, false, 0, descending.size(), totalCount), descending);
+
+    // The order of the tied books doesn't depend on the books sorted.
+    const BookIdCollection expected = first < copy
+                                    ? BookIdCollection{*first, *copy}
+                                    : BookIdCollection{*copy, *first};
+    BookIdCollection tied{expected.back(), expected.front()};
+    lib.sort(tied, sortBy, true);
+    EXPECT_EQ(tied, expected);
+  }
+}
+
+TEST_F(LibraryTest, filterRange)
+{
+  const std::vector<kiwix::Filter> filters{
+    kiwix::Filter(),
+    kiwix::Filter().local(true),
+    kiwix::Filter().lang("fra"),
+    kiwix::Filter().acceptTags({"wikipedia"}).rejectTags({"nopic"}),
+    kiwix::Filter().query("Wiki"),
+    kiwix::Filter().query("Wiki").lang("fra").local(false),
+    kiwix::Filter().creator("Wikipedia"),
+    kiwix::Filter().lang("none"),
+  };
+  const std::vector<kiwix::supportedListSortBy> sorts{
+    kiwix::UNSORTED, kiwix::TITLE, kiwix::SIZE, kiwix::DATE
+  };
+
+  for ( const auto& f : filters ) {
+    for ( const auto sortBy : sorts ) {
+      for ( const bool ascending : {true, false} ) {
+        auto allBooks = lib.filter(f);
+        lib.sort(allBooks, sortBy, ascending);
+        for ( size_t start : {0, 1, 3, 20} ) {
+          for ( size_t count : {0, 1, 2, 100} ) {
+            size_t totalCount = 12345;
+            const auto books = lib.filter(f, sortBy, ascending, start, count, totalCount);
+            EXPECT_EQ(totalCount, allBooks.size());
+            const auto begin = allBooks.begin() + std::min(start, allBooks.size());
+            const auto end = allBooks.begin() + std::min(start + count, allBooks.size());
+            EXPECT_EQ(books, BookIdCollection(begin, end));
+          }
+        }
+      }
+    }
+  }
+}
+
 TEST_F(LibraryTest, getBookByPath)
 {
   auto& book = lib.getBookById(lib.getBooksIds()[0]);
@@ -655,6 +920,68 @@ TEST_F(LibraryTest, getBookByPath)
   EXPECT_THROW(lib.getBookByPath("non/existant/path.zim"), std::out_of_range);
 }
 
+TEST_F(LibraryTest, getBookByPathNormalizesThePaths)
+{
+#ifdef _WIN32
+  const std::string dir = "C:\\data\\zims\\";
+  const std::string otherDir = "C:\\data\\other\\..\\zims\\.\\";
+#else
+  const std::string dir = "/data/zims/";
+  const std::string otherDir = "/data/other/../zims/./";
+#endif
+  kiwix::Book book;
+  book.setId("shared-path-b");
+  book.setPath(dir + "shared.zim");
+  lib.addBook(book);
+  book.setId("shared-path-a");
+  lib.addBook(book);
+  book.setId("relative-path");
+  book.setPath("relative.zim");
+  lib.addBook(book);
+
+  // The book with the smallest id is returned.
+  EXPECT_EQ(lib.getBookByPath(otherDir + "shared.zim").getId(), "shared-path-a");
+  EXPECT_EQ(lib.getBookByPath("sub/../relative.zim").getId(), "relative-path");
+
+  lib.removeBookById("shared-path-a");
+  EXPECT_EQ(lib.getBookByPath(dir + "shared.zim").getId(), "shared-path-b");
+
+  book = lib.getBookById("shared-path-b");
+  book.setPath(dir + "moved.zim");
+  lib.addBook(book);
+  EXPECT_THROW(lib.getBookByPath(dir + "shared.zim"), std::out_of_range);
+  EXPECT_EQ(lib.getBookByPath(otherDir + "moved.zim").getId(), "shared-path-b");
+}
+
+TEST_F(LibraryTest, getBookByPathFromSeveralThreads)
+{
+#ifdef _WIN32
+  const std::string dir = "C:\\data\\zims\\";
+#else
+  const std::string dir = "/data/zims/";
+#endif
+  // A path changed through a non const getter, without touching the book.
+  lib.getBookById("raycharles").setPath(dir + "moved.zim");
+
+  const kiwix::Library& constLib = lib;
+  std::vector<std::thread> threads;
+  std::vector<int> found(4, 0);
+  for (size_t i = 0; i < found.size(); i++) {
+    threads.emplace_back([&, i]() {
+      for (int j = 0; j < 100; j++) {
+        if (constLib.getBookByPath(dir + "moved.zim").getId() == "raycharles") {
+          found[i]++;
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(found, std::vector<int>(4, 100));
+  EXPECT_THROW(constLib.getBookByPath(dir + "missing.zim"), std::out_of_range);
+}
+
 TEST_F(LibraryTest, removeBookByIdRemovesTheBook)
 {
   const auto initialBookCount = lib.getBookCount(true, true);
@@ -690,4 +1017,448 @@ TEST_F(LibraryTest, removeBookByIdUpdatesTheSearchDB)
   EXPECT_THROW(lib.getBookById("raycharles"), std::out_of_range);
 };
 
+TEST_F(LibraryTest, getBookRevision)
+{
+  const auto revision = lib.getBookRevision("raycharles");
+  const kiwix::Library& constLib = lib;
+  constLib.getBookById("raycharles");
+  EXPECT_EQ(lib.getBookRevision("raycharles"), revision);
+
+  // Getting a modifiable book doesn't change it
+  lib.getBookById("raycharles");
+  EXPECT_EQ(lib.getBookRevision("raycharles"), revision);
+  lib.getBookByPath(lib.getBookById("raycharles").getPath());
+  EXPECT_EQ(lib.getBookRevision("raycharles"), revision);
+
+  // Until it is touched
+  lib.getBookById("raycharles").setTitle("Zyxwv");
+  const auto libraryRevision = lib.getRevision();
+  lib.touchBook("raycharles");
+  const auto revision2 = lib.getBookRevision("raycharles");
+  EXPECT_GT(revision2, revision);
+  EXPECT_GT(lib.getRevision(), libraryRevision);
+  EXPECT_EQ(lib.getChangesSince(libraryRevision).updatedBooks,
+            kiwix::Library::BookIdCollection{"raycharles"});
+  EXPECT_EQ(lib.filter(kiwix::Filter().query("zyxwv")),
+            kiwix::Library::BookIdCollection{"raycharles"});
+
+  const std::string id = "0c45160e-f917-760a-9159-dfe3c53cdcdd";
+  auto book = constLib.getBookById(id);
+  book.setTitle("Tunisie");
+  lib.addBook(book);
+  const auto revision3 = lib.getBookRevision(id);
+  EXPECT_GT(revision3, revision2);
+
+  // Adding the same book doesn't change it
+  lib.addBook(book);
+  EXPECT_EQ(lib.getBookRevision(id), revision3);
+
+  lib.removeBookById(id);
+  EXPECT_THROW(lib.getBookRevision(id), std::out_of_range);
+};
+
+TEST_F(LibraryTest, opdsEntryCacheKeptByReadOnlyLookups)
+{
+  kiwix::OPDSEntryCache cache(1024 * 1024);
+  int renderCount = 0;
+  const auto getEntry = [&]() {
+    return cache.get("raycharles", lib.getBookRevision("raycharles"), "/root",
+                     [&]() { renderCount++; return std::string("<entry/>"); });
+  };
+  getEntry();
+  EXPECT_EQ(renderCount, 1);
+
+  const kiwix::Library& constLib = lib;
+  constLib.getBookById("raycharles");
+  lib.getBookById("raycharles");
+  kiwix::HumanReadableNameMapper nameMapper(lib, true);
+  getEntry();
+  EXPECT_EQ(renderCount, 1);
+
+  lib.touchBook("raycharles");
+  getEntry();
+  EXPECT_EQ(renderCount, 2);
+}
+
+TEST_F(LibraryTest, mergeBooks)
+{
+  const auto remoteOnly = kiwix::Filter().local(false).remote(true);
+  const auto catalogIds = lib.filter(remoteOnly);
+  ASSERT_GT(catalogIds.size(), 2U);
+  const auto localIds = lib.filter(kiwix::Filter().local(true));
+
+  std::vector<kiwix::Book> catalog;
+  for (const auto& id : catalogIds) {
+    catalog.push_back(lib.getBookById(id));
+  }
+  const auto revision = lib.getBookRevision(catalogIds[2]);
+
+  // The same catalog
+  auto changes = lib.mergeBooks(catalog, remoteOnly);
+  EXPECT_TRUE(changes.addedBooks.empty());
+  EXPECT_TRUE(changes.updatedBooks.empty());
+  EXPECT_TRUE(changes.removedBooks.empty());
+  EXPECT_EQ(lib.getBookRevision(catalogIds[2]), revision);
+
+  // One book changed, one book removed and one book added
+  catalog[0].setTitle("A new title");
+  catalog.erase(catalog.begin() + 1);
+  kiwix::Book newBook;
+  newBook.setId("new-book");
+  newBook.setUrl("http://example.com/new-book.zim");
+  catalog.push_back(newBook);
+  changes = lib.mergeBooks(catalog, remoteOnly);
+  EXPECT_EQ(changes.addedBooks, BookIdCollection({"new-book"}));
+  EXPECT_EQ(changes.updatedBooks, BookIdCollection({catalogIds[0]}));
+  EXPECT_EQ(changes.removedBooks, BookIdCollection({catalogIds[1]}));
+  EXPECT_EQ(lib.getBookRevision(catalogIds[2]), revision);
+
+  EXPECT_EQ(lib.getBookById(catalogIds[0]).getTitle(), "A new title");
+  EXPECT_THROW(lib.getBookById(catalogIds[1]), std::out_of_range);
+  EXPECT_EQ(lib.filter(kiwix::Filter().local(true)), localIds);
+};
+
+TEST_F(LibraryTest, getChangesSince)
+{
+  const auto revision = lib.getRevision();
+  EXPECT_THROW(lib.getChangesSince(revision + 1), std::out_of_range);
+  // Revisions of a new library start after the ones of the previous libraries.
+  EXPECT_THROW(lib.getChangesSince(1), std::out_of_range);
+  EXPECT_EQ(lib.getChangesSince(0).addedBooks, lib.getBooksIds());
+
+  auto changes = lib.getChangesSince(revision);
+  EXPECT_TRUE(changes.addedBooks.empty());
+  EXPECT_TRUE(changes.updatedBooks.empty());
+  EXPECT_TRUE(changes.removedBooks.empty());
+
+  const std::string updatedId = "0c45160e-f917-760a-9159-dfe3c53cdcdd";
+  auto book = lib.getBookById(updatedId);
+  book.setTitle("Tunisie");
+  lib.addBook(book);
+  kiwix::Book newBook;
+  newBook.setId("new-book");
+  lib.addBook(newBook);
+  lib.removeBookById("raycharles");
+  // Added and removed since revision
+  newBook.setId("removed-new-book");
+  lib.addBook(newBook);
+  lib.removeBookById("removed-new-book");
+
+  changes = lib.getChangesSince(revision);
+  EXPECT_EQ(changes.addedBooks, BookIdCollection({"new-book"}));
+  EXPECT_EQ(changes.updatedBooks, BookIdCollection({updatedId}));
+  EXPECT_EQ(changes.removedBooks, BookIdCollection({"raycharles", "removed-new-book"}));
+  EXPECT_GT(lib.getRevision(), revision);
+  EXPECT_EQ(lib.getChangesSince(lib.getRevision()).addedBooks, BookIdCollection());
+};
+
+TEST_F(LibraryTest, getChangesSinceWithFilter)
+{
+  const auto filter = kiwix::Filter().lang("eng");
+  const auto accepted = lib.filter(filter);
+  ASSERT_GE(accepted.size(), 2U);
+  EXPECT_EQ(lib.getChangesSince(0, filter).addedBooks, accepted);
+
+  const auto revision = lib.getRevision();
+  const kiwix::Library& constLib = lib;
+  // Leaves the filter
+  auto book = constLib.getBookById(accepted[0]);
+  book.setLanguage("fra");
+  lib.addBook(book);
+  // Stays in the filter
+  book = constLib.getBookById(accepted[1]);
+  book.setTitle("A new title");
+  lib.addBook(book);
+  // Never in the filter
+  kiwix::Book newBook;
+  newBook.setId("new-book");
+  newBook.setLanguage("fra");
+  lib.addBook(newBook);
+
+  const auto changes = lib.getChangesSince(revision, filter);
+  EXPECT_EQ(changes.addedBooks, BookIdCollection());
+  EXPECT_EQ(changes.updatedBooks, BookIdCollection({accepted[1]}));
+  BookIdCollection removedBooks{accepted[0], "new-book"};
+  std::sort(removedBooks.begin(), removedBooks.end());
+  EXPECT_EQ(changes.removedBooks, removedBooks);
+};
+
+TEST_F(LibraryTest, readOpdsChanges)
+{
+  kiwix::OPDSDumper dumper(&lib);
+  dumper.setLibraryId("12345678-90ab-cdef-1234-567890abcdef");
+  const auto changesFeed = [&](uint64_t since) {
+    return dumper.dumpOPDSChangesFeed(lib.getChangesSince(since), since, lib.getRevision());
+  };
+
+  kiwix::Library mirror;
+  kiwix::Manager manager(&mirror);
+  EXPECT_TRUE(manager.readOpdsChanges(changesFeed(0), ""));
+  EXPECT_EQ(mirror.getBooksIds(), lib.getBooksIds());
+  EXPECT_EQ(manager.m_catalogRevision, lib.getRevision());
+
+  const std::string updatedId = "0c45160e-f917-760a-9159-dfe3c53cdcdd";
+  auto book = lib.getBookById(updatedId);
+  book.setTitle("Tunisie");
+  lib.addBook(book);
+  lib.removeBookById("raycharles");
+  EXPECT_TRUE(manager.readOpdsChanges(changesFeed(manager.m_catalogRevision), ""));
+  EXPECT_EQ(mirror.getBooksIds(), lib.getBooksIds());
+  EXPECT_EQ(mirror.getBookById(updatedId).getTitle(), "Tunisie");
+  EXPECT_EQ(manager.m_catalogRevision, lib.getRevision());
+
+  EXPECT_FALSE(manager.readOpdsChanges(sampleOpdsStream, ""));
+};
+
+TEST_F(LibraryTest, getBookIllustration)
+{
+  // Read from the zim file of the book
+  const auto illustration = lib.getBookIllustration("raycharles");
+  ASSERT_NE(illustration.data, nullptr);
+  EXPECT_FALSE(illustration.data->empty());
+  EXPECT_EQ(illustration.mimeType.substr(0, 6), "image/");
+  EXPECT_EQ(lib.getBookIllustration("raycharles").data, illustration.data);
+
+  // Identical illustrations are stored once
+  kiwix::Book book1, book2;
+  book1.setId("book1");
+  book1.setFavicon("favicon");
+  book1.setFaviconMimeType("image/png");
+  book2.setId("book2");
+  book2.setFavicon("favicon");
+  lib.addBook(book1);
+  lib.addBook(book2);
+  const auto illustration1 = lib.getBookIllustration("book1");
+  ASSERT_NE(illustration1.data, nullptr);
+  EXPECT_EQ(*illustration1.data, "favicon");
+  EXPECT_EQ(illustration1.mimeType, "image/png");
+  EXPECT_EQ(lib.getBookIllustration("book2").data, illustration1.data);
+
+  EXPECT_THROW(lib.getBookIllustration("non-existent-book"), std::out_of_range);
+};
+
+TEST_F(LibraryTest, snapshot)
+{
+  const TmpDir tmpDir;
+  const std::string path = tmpDir.file("library_snapshot.bin");
+  kiwix::Book::Integrity integrity;
+  integrity.status = kiwix::Book::Integrity::CORRUPTED;
+  integrity.fileSize = 1234;
+  integrity.fileMtime = 5678;
+  lib.getBookById(lib.getBooksIds()[0]).setIntegrity(integrity);
+  ASSERT_TRUE(lib.writeSnapshot(path));
+
+  kiwix::Library lib2;
+  ASSERT_TRUE(lib2.readSnapshot(path));
+  EXPECT_EQ(lib2.getBooksIds(), lib.getBooksIds());
+  for ( const auto& id : lib.getBooksIds() ) {
+    const auto& book = lib.getBookById(id);
+    const auto& book2 = lib2.getBookById(id);
+    EXPECT_EQ(book2.readOnly(), book.readOnly());
+    EXPECT_EQ(book2.getPath(), book.getPath());
+    EXPECT_EQ(book2.isPathValid(), book.isPathValid());
+    EXPECT_EQ(book2.getTitle(), book.getTitle());
+    EXPECT_EQ(book2.getDescription(), book.getDescription());
+    EXPECT_EQ(book2.getLanguage(), book.getLanguage());
+    EXPECT_EQ(book2.getCreator(), book.getCreator());
+    EXPECT_EQ(book2.getPublisher(), book.getPublisher());
+    EXPECT_EQ(book2.getDate(), book.getDate());
+    EXPECT_EQ(book2.getUrl(), book.getUrl());
+    EXPECT_EQ(book2.getName(), book.getName());
+    EXPECT_EQ(book2.getCategory(), book.getCategory());
+    EXPECT_EQ(book2.getTags(), book.getTags());
+    EXPECT_EQ(book2.getFlavour(), book.getFlavour());
+    EXPECT_EQ(book2.getOrigId(), book.getOrigId());
+    EXPECT_EQ(book2.getArticleCount(), book.getArticleCount());
+    EXPECT_EQ(book2.getMediaCount(), book.getMediaCount());
+    EXPECT_EQ(book2.getSize(), book.getSize());
+    EXPECT_EQ(book2.getFaviconUrl(), book.getFaviconUrl());
+    EXPECT_EQ(book2.getFaviconMimeType(), book.getFaviconMimeType());
+    EXPECT_EQ(book2.getDownloadId(), book.getDownloadId());
+    EXPECT_EQ(book2.getIntegrity().status, book.getIntegrity().status);
+    EXPECT_EQ(book2.getIntegrity().fileSize, book.getIntegrity().fileSize);
+    EXPECT_EQ(book2.getIntegrity().fileMtime, book.getIntegrity().fileMtime);
+    if ( book.getFaviconUrl().empty() ) {
+      EXPECT_EQ(book2.getFavicon(), book.getFavicon());
+    }
+  }
+  EXPECT_EQ(lib2.getBooksLanguagesWithCounts(), lib.getBooksLanguagesWithCounts());
+  EXPECT_EQ(lib2.filter(kiwix::Filter().query("Exchange")).size(), 3U);
+
+  // An invalid snapshot is not loaded
+  std::string content;
+  {
+    std::ifstream in(path, std::ios::binary);
+    content.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+  content.resize(content.size() - 1);
+  std::ofstream(path, std::ios::binary | std::ios::trunc) << content;
+  kiwix::Library lib3;
+  EXPECT_FALSE(lib3.readSnapshot(path));
+  EXPECT_TRUE(lib3.getBooksIds().empty());
+  EXPECT_FALSE(lib3.readSnapshot(tmpDir.file("no_such_snapshot.bin")));
+};
+
 };
+
+TEST(LibraryBookDBTest, persistentBookDB)
+{
+  const TmpDir tmpDir;
+  const std::string dbPath = tmpDir.file("library_bookdb");
+  const auto titles = [](const kiwix::Library& lib, const kiwix::Filter& filter) {
+    std::vector<std::string> titles;
+    for ( const auto& bookId : lib.filter(filter) ) {
+      titles.push_back(lib.getBookById(bookId).getTitle());
+    }
+    std::sort(titles.begin(), titles.end());
+    return titles;
+  };
+  typedef std::vector<std::string> TitleCollection;
+
+  {
+    kiwix::Library lib;
+    ASSERT_TRUE(lib.openBookDB(dbPath));
+    // A new database
+    EXPECT_EQ(Xapian::Database(dbPath).get_doccount(), 0U);
+    kiwix::Manager manager(&lib);
+    manager.readOpds(sampleOpdsStream, "foo.urlHost");
+    manager.readXml(sampleLibraryXML, true, "./test/library.xml", true);
+    lib.commitBookDB();
+    EXPECT_EQ(Xapian::Database(dbPath).get_doccount(), lib.getBookCount(true, true));
+    EXPECT_EQ(titles(lib, kiwix::Filter().query("Exchange")), TitleCollection({
+      "Islam Stack Exchange",
+      "Movies & TV Stack Exchange",
+      "Mythology & Folklore Stack Exchange"
+    }));
+  }
+
+  {
+    kiwix::Library lib;
+    ASSERT_TRUE(lib.openBookDB(dbPath));
+    // Books of the database are ignored until they are added to the library
+    EXPECT_EQ(titles(lib, kiwix::Filter().query("Charles")), TitleCollection());
+
+    kiwix::Manager manager(&lib);
+    manager.readXml(sampleLibraryXML, true, "./test/library.xml", true);
+    EXPECT_EQ(titles(lib, kiwix::Filter().query("Charles")), TitleCollection({"Ray Charles"}));
+    EXPECT_EQ(titles(lib, kiwix::Filter().query("Exchange")), TitleCollection());
+
+    // Changed books are indexed again
+    auto book = lib.getBookById("raycharles");
+    book.setTitle("Georgia on my mind");
+    lib.removeBookById("raycharles");
+    lib.addBook(book);
+    lib.commitBookDB();
+    EXPECT_EQ(titles(lib, kiwix::Filter().query("Charles")), TitleCollection());
+    EXPECT_EQ(titles(lib, kiwix::Filter().query("Georgia")), TitleCollection({"Georgia on my mind"}));
+  }
+
+  {
+    kiwix::Library lib;
+    ASSERT_TRUE(lib.openBookDB(dbPath));
+    kiwix::Manager manager(&lib);
+    manager.readOpds(sampleOpdsStream, "foo.urlHost");
+    manager.readXml(sampleLibraryXML, true, "./test/library.xml", true);
+    lib.commitBookDB();
+    EXPECT_EQ(titles(lib, kiwix::Filter().query("Charles")), TitleCollection({"Ray Charles"}));
+    EXPECT_EQ(titles(lib, kiwix::Filter().query("Georgia")), TitleCollection());
+    EXPECT_EQ(titles(lib, kiwix::Filter().query("Exchange")).size(), 3U);
+  }
+}
+
+TEST(LibraryOpdsTest, readOpdsByChunks)
+{
+  kiwix::Library referenceLib;
+  kiwix::Manager(&referenceLib).readOpds(sampleOpdsStream, "foo.urlHost");
+  const std::string stream(sampleOpdsStream);
+
+  for (size_t chunkSize : {1, 7, 100, 100000}) {
+    kiwix::Library lib;
+    kiwix::Manager manager(&lib);
+    for (size_t pos = 0; pos < stream.size(); pos += chunkSize) {
+      EXPECT_TRUE(manager.readOpdsChunk(stream.substr(pos, chunkSize), "foo.urlHost"));
+    }
+    EXPECT_TRUE(manager.endOpdsStream());
+    ASSERT_EQ(lib.getBooksIds(), referenceLib.getBooksIds());
+    for (const auto& id : lib.getBooksIds()) {
+      EXPECT_EQ(lib.getBookById(id).getTitle(), referenceLib.getBookById(id).getTitle());
+      EXPECT_EQ(lib.getBookById(id).getFaviconUrl(), referenceLib.getBookById(id).getFaviconUrl());
+    }
+  }
+
+  // Markup looking like entries, which must not be taken for entries.
+  {
+    std::string trickyStream(stream);
+    const std::string header = "<id>00000000-0000-0000-0000-000000000000</id>";
+    trickyStream.replace(trickyStream.find(header), header.size(),
+        header + "<!-- <entry> --><entryCount value=\"a>b\">3</entryCount><?pi <entry>?>");
+    const std::string summary = "<summary>Tania Louis videos</summary>";
+    trickyStream.replace(trickyStream.find(summary), summary.size(),
+        "<summary><![CDATA[Tania Louis videos</entry>]]></summary><!-- </entry> -->");
+    kiwix::Library trickyReferenceLib;
+    kiwix::Manager(&trickyReferenceLib).readOpds(trickyStream, "foo.urlHost");
+    ASSERT_EQ(trickyReferenceLib.getBooksIds(), referenceLib.getBooksIds());
+
+    for (size_t chunkSize : {1, 7, 100000}) {
+      kiwix::Library lib;
+      kiwix::Manager manager(&lib);
+      for (size_t pos = 0; pos < trickyStream.size(); pos += chunkSize) {
+        EXPECT_TRUE(manager.readOpdsChunk(trickyStream.substr(pos, chunkSize), "foo.urlHost"));
+      }
+      EXPECT_TRUE(manager.endOpdsStream());
+      ASSERT_EQ(lib.getBooksIds(), referenceLib.getBooksIds());
+      EXPECT_EQ(lib.getBookById("0d0bcd57-d3f6-cb22-44cc-a723ccb4e1b2").getDescription(),
+                "Tania Louis videos</entry>");
+    }
+  }
+
+  // A truncated stream
+  kiwix::Library lib;
+  kiwix::Manager manager(&lib);
+  EXPECT_TRUE(manager.readOpdsChunk(stream.substr(0, stream.size() / 2), "foo.urlHost"));
+  EXPECT_FALSE(manager.endOpdsStream());
+  EXPECT_GT(lib.getBookCount(true, true), 0U);
+}
+
+TEST(LibraryFileTest, writeAndAppendBooksToFile)
+{
+  const std::string path = "./test/library_written.xml";
+  const auto readLibrary = [&](kiwix::Library& lib) {
+    kiwix::Manager manager(&lib);
+    return manager.readFile(path, false, true);
+  };
+
+  kiwix::Library lib;
+  {
+    kiwix::Manager manager(&lib);
+    manager.readXml(sampleLibraryXML, false, "./test/library.xml", true);
+  }
+  ASSERT_TRUE(lib.writeToFile(path));
+  {
+    kiwix::Library lib2;
+    ASSERT_TRUE(readLibrary(lib2));
+    EXPECT_EQ(lib2.getBooksIds(), lib.getBooksIds());
+    EXPECT_EQ(lib2.getBookById("raycharles").getPath(), lib.getBookById("raycharles").getPath());
+  }
+
+  auto book = lib.getBookById("example");
+  book.setTitle("An updated example");
+  lib.addBook(book);
+  book.setId("newbook");
+  book.setTitle("A new book");
+  lib.addBook(book);
+  ASSERT_TRUE(lib.appendBooksToFile(path, {"example", "newbook"}));
+  {
+    kiwix::Library lib2;
+    ASSERT_TRUE(readLibrary(lib2));
+    EXPECT_EQ(lib2.getBooksIds(), lib.getBooksIds());
+    EXPECT_EQ(lib2.getBookById("example").getTitle(), "An updated example");
+    EXPECT_EQ(lib2.getBookById("newbook").getTitle(), "A new book");
+    EXPECT_EQ(lib2.getBookById("raycharles").getTitle(), "Ray Charles");
+  }
+
+  // An empty library file has no end tag to append to.
+  ASSERT_TRUE(kiwix::Library().writeToFile(path));
+  EXPECT_FALSE(lib.appendBooksToFile(path, {"example"}));
+  EXPECT_FALSE(lib.appendBooksToFile("./test/no_such_library.xml", {"example"}));
+}
@@ -67,3 +67,76 @@ TEST(ManagerTest, readXml)
     EXPECT_EQ(45U, book.getMediaCount());
     EXPECT_EQ(678U*1024, book.getSize());
 }
+
+namespace
+{
+
+class BookListManipulator : public kiwix::LibraryManipulator {
+ public:
+  bool addBookToLibrary(kiwix::Book book) {
+    books.push_back(book);
+    return true;
+  }
+  void addBookmarkToLibrary(kiwix::Bookmark bookmark) {}
+
+  std::vector<kiwix::Book> books;
+};
+
+} // unnamed namespace
+
+TEST(ManagerTest, readXmlWithoutTrustingTheLibrary)
+{
+    std::string xml = "<library version=\"1.0\">\n";
+    const std::vector<std::string> paths{
+      "zimfile.zim", "missing.zim", "corner_cases.zim", "example.zim",
+      "zimfile.zim", "corner_cases.zim", "example.zim", "missing.zim",
+      "example.zim", "zimfile.zim", "corner_cases.zim"
+    };
+    const auto absolutePath = [](const std::string& path) {
+      return kiwix::computeAbsolutePath(kiwix::getCurrentDirectory(), "./test/" + path);
+    };
+    for ( size_t i = 0; i < paths.size(); i++ ) {
+      xml += "<book id=\"book" + std::to_string(i) + "\""
+             " path=\"" + absolutePath(paths[i]) + "\""
+             " title=\"Book " + std::to_string(i) + "\"></book>\n";
+    }
+    xml += "</library>\n";
+
+    BookListManipulator manipulator;
+    kiwix::Manager manager(&manipulator);
+    EXPECT_TRUE(manager.readXml(xml, false, "/data/lib.xml", false));
+
+    ASSERT_EQ(manipulator.books.size(), paths.size());
+    for ( size_t i = 0; i < paths.size(); i++ ) {
+      const auto& book = manipulator.books[i];
+      const auto path = absolutePath(paths[i]);
+      if ( paths[i] == "missing.zim" ) {
+        EXPECT_FALSE(book.isPathValid());
+        EXPECT_EQ(book.getId(), "book" + std::to_string(i));
+        EXPECT_EQ(book.getTitle(), "Book " + std::to_string(i));
+        continue;
+      }
+      // The book has the same metadata as if it was read with a Reader.
+      kiwix::Book expected;
+      expected.update(kiwix::Reader(path));
+      EXPECT_TRUE(book.isPathValid());
+      EXPECT_EQ(book.getPath(), path);
+      EXPECT_EQ(book.getId(), expected.getId());
+      EXPECT_EQ(book.getTitle(), expected.getTitle());
+      EXPECT_EQ(book.getDescription(), expected.getDescription());
+      EXPECT_EQ(book.getLanguage(), expected.getLanguage());
+      EXPECT_EQ(book.getCreator(), expected.getCreator());
+      EXPECT_EQ(book.getPublisher(), expected.getPublisher());
+      EXPECT_EQ(book.getDate(), expected.getDate());
+      EXPECT_EQ(book.getName(), expected.getName());
+      EXPECT_EQ(book.getFlavour(), expected.getFlavour());
+      EXPECT_EQ(book.getTags(), expected.getTags());
+      EXPECT_EQ(book.getCategory(), expected.getCategory());
+      EXPECT_EQ(book.getOrigId(), expected.getOrigId());
+      EXPECT_EQ(book.getArticleCount(), expected.getArticleCount());
+      EXPECT_EQ(book.getMediaCount(), expected.getMediaCount());
+      EXPECT_EQ(book.getSize(), expected.getSize());
+      EXPECT_EQ(book.getFavicon(), expected.getFavicon());
+      EXPECT_EQ(book.getFaviconMimeType(), expected.getFaviconMimeType());
+    }
+}
@@ -235,6 +235,18 @@ TEST(pathTools, goUp)
 #endif
 }
 
+TEST(pathTools, removeDirectory)
+{
+  const auto dir = makeTmpDirectory();
+  ASSERT_TRUE(makeDirectory(dir + "/sub"));
+  ASSERT_TRUE(writeTextFile(dir + "/file", "content"));
+  ASSERT_TRUE(writeTextFile(dir + "/sub/file", "content"));
+  EXPECT_TRUE(removeDirectory(dir));
+  EXPECT_FALSE(fileExists(dir + "/sub/file"));
+  EXPECT_FALSE(makeDirectory(dir + "/sub"));
+  EXPECT_FALSE(removeDirectory(dir));
+}
+
 
 #ifdef _WIN32
 TEST(pathTools, dirChange)
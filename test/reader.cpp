@@ -3,6 +3,8 @@
 #include "../include/reader.h"
 #include "zim/archive.h"
 
+#include <set>
+
 namespace kiwix
 {
   /**
@@ -39,6 +41,27 @@ namespace kiwix
     ASSERT_EQ(readerEntry.getTitle(), archiveEntry.getTitle());
   }
 
+  TEST (Reader, metadata) {
+    zim::Archive archive("./test/zimfile.zim");
+    Reader reader("./test/zimfile.zim");
+
+    ASSERT_EQ(reader.getTitle(), archive.getMetadata("Title"));
+    ASSERT_EQ(reader.getLanguage(), archive.getMetadata("Language"));
+    ASSERT_EQ(reader.getTags(true), archive.getMetadata("Tags"));
+    std::string value;
+    ASSERT_TRUE(reader.getMetadata("Creator", value));
+    ASSERT_EQ(value, archive.getMetadata("Creator"));
+    ASSERT_FALSE(reader.getMetadata("Relation", value));
+    ASSERT_FALSE(reader.getMetadata("NotAMetadata", value));
+    ASSERT_GT(reader.getArticleCount(), 0U);
+
+    // Copies share the metadata read.
+    const Reader copy(reader);
+    ASSERT_EQ(copy.getTitle(), reader.getTitle());
+    ASSERT_EQ(copy.getArticleCount(), reader.getArticleCount());
+    ASSERT_EQ(copy.getMediaCount(), reader.getMediaCount());
+  }
+
   TEST (Reader, suggestions) {
     Reader reader("./test/zimfile.zim");
     SuggestionsList_t suggestions;
@@ -59,4 +82,25 @@ namespace kiwix
 
     ASSERT_EQ(suggestionResult, expectedResult);
   }
-}
\ No newline at end of file
+
+  TEST (Reader, suggestionsWithoutDuplicates) {
+    Reader reader("./test/zimfile.zim");
+    SuggestionsList_t suggestions;
+    ASSERT_TRUE(reader.searchSuggestions("The ", 10, suggestions));
+    ASSERT_FALSE(suggestions.empty());
+
+    // Searching again doesn't add the same suggestions
+    SuggestionsList_t suggestions2 = suggestions;
+    ASSERT_TRUE(reader.searchSuggestions("The ", 20, suggestions2));
+    std::set<std::pair<std::string, std::string>> keys;
+    for (size_t i = 0; i < suggestions2.size(); i++) {
+      ASSERT_TRUE(keys.insert({suggestions2[i].getNormalizedTitle(), suggestions2[i].getPath()}).second);
+      if (i) {
+        ASSERT_LE(suggestions2[i-1].getNormalizedTitle(), suggestions2[i].getNormalizedTitle());
+      }
+    }
+    for (const auto& suggestion : suggestions) {
+      ASSERT_EQ(keys.count({suggestion.getNormalizedTitle(), suggestion.getPath()}), 1U);
+    }
+  }
+}
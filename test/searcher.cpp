@@ -1,6 +1,12 @@
 #include "gtest/gtest.h"
 #include "../include/searcher.h"
 #include "../include/reader.h"
+#include "../include/library.h"
+#include "../include/book.h"
+#include "../src/federated_search.h"
+
+#include <zim/archive.h>
+#include <zim/search.h>
 
 namespace kiwix
 {
@@ -22,4 +28,97 @@ TEST(Searcher, search) {
 	ASSERT_EQ(result->get_title(), "Wikibooks");
 }
 
-}
\ No newline at end of file
+TEST(FederatedSearcher, search) {
+  Library library;
+  zim::Archive archive("./test/example.zim");
+  for (auto id : {"a", "b"}) {
+    Book book;
+    book.update(archive);
+    book.setId(id);
+    book.setPath("./test/example.zim");
+    book.setPathValid(true);
+    library.addBook(book);
+  }
+
+  FederatedSearcher searcher(2, Filter().local(true).valid(true));
+  searcher.update(library);
+  EXPECT_EQ(searcher.getArchiveCount(), 2U);
+
+  zim::Query query;
+  query.setQuery("wiki", false);
+  auto results = searcher.search(query, 0, 10);
+  // Each archive gives the same results: they are interleaved.
+  EXPECT_EQ(results.estimatedMatches, 4U);
+  ASSERT_EQ(results.results.size(), 4U);
+  EXPECT_EQ(results.results[0].title, "FreedomBox for Communities/Offline Wikipedia - Wikibooks, open books for an open world");
+  EXPECT_EQ(results.results[0].bookId, "a");
+  EXPECT_EQ(results.results[1].title, results.results[0].title);
+  EXPECT_EQ(results.results[1].bookId, "b");
+  EXPECT_EQ(results.results[2].title, "Wikibooks");
+  EXPECT_EQ(results.results[2].bookId, "a");
+  EXPECT_EQ(results.results[3].bookId, "b");
+
+  // Only the requested page is returned.
+  results = searcher.search(query, 1, 2);
+  EXPECT_EQ(results.estimatedMatches, 4U);
+  ASSERT_EQ(results.results.size(), 2U);
+  EXPECT_EQ(results.results[0].bookId, "b");
+  EXPECT_EQ(results.results[1].title, "Wikibooks");
+  EXPECT_EQ(searcher.search(query, 4, 2).results.size(), 0U);
+
+  // The changes of the library are followed.
+  library.removeBookById("a");
+  searcher.update(library);
+  EXPECT_EQ(searcher.getArchiveCount(), 1U);
+  results = searcher.search(query, 0, 10);
+  EXPECT_EQ(results.estimatedMatches, 2U);
+  ASSERT_EQ(results.results.size(), 2U);
+  EXPECT_EQ(results.results[0].bookId, "b");
+}
+
+TEST(FederatedSearcher, searchScope) {
+  Library library;
+  zim::Archive archive("./test/example.zim");
+  for (auto id : {"a", "b", "c"}) {
+    Book book;
+    book.update(archive);
+    book.setId(id);
+    book.setPath("./test/example.zim");
+    book.setPathValid(true);
+    library.addBook(book);
+  }
+
+  FederatedSearcher searcher(2, Filter().local(true).valid(true));
+  searcher.update(library);
+  zim::Query query;
+  query.setQuery("wiki", false);
+
+  int calls = 0;
+  const auto getBookIds = [&]() {
+    calls++;
+    return Library::BookIdCollection{"c", "a", "unknown"};
+  };
+  auto results = searcher.search(query, 0, 10, "scope", getBookIds);
+  EXPECT_EQ(calls, 1);
+  EXPECT_EQ(results.estimatedMatches, 4U);
+  ASSERT_EQ(results.results.size(), 4U);
+  EXPECT_EQ(results.results[0].bookId, "c");
+  EXPECT_EQ(results.results[1].bookId, "a");
+
+  // The books of the scope are cached until the library changes.
+  results = searcher.search(query, 0, 10, "scope", getBookIds);
+  EXPECT_EQ(calls, 1);
+  EXPECT_EQ(results.results.size(), 4U);
+  searcher.search(query, 0, 10, "otherScope", getBookIds);
+  EXPECT_EQ(calls, 2);
+
+  library.removeBookById("a");
+  searcher.update(library);
+  results = searcher.search(query, 0, 10, "scope", getBookIds);
+  EXPECT_EQ(calls, 3);
+  EXPECT_EQ(results.estimatedMatches, 2U);
+  ASSERT_EQ(results.results.size(), 2U);
+  EXPECT_EQ(results.results[0].bookId, "c");
+}
+
+}
@@ -6,6 +6,9 @@
 #include "../include/server.h"
 #include "../include/name_mapper.h"
 #include "../include/tools.h"
+#include "../src/tools/pathTools.h"
+
+#include <set>
 
 using TestContextImpl = std::vector<std::pair<std::string, std::string> >;
 struct TestContext : TestContextImpl {
@@ -626,7 +629,8 @@ std::string maskVariableOPDSFeedData(std::string s)
     "    <tags>unittest;wikipedia;_category:jazz;_pictures:no;_videos:no;_details:no;_ftindex:yes</tags>\n" \
     "    <articleCount>284</articleCount>\n"                            \
     "    <mediaCount>2</mediaCount>\n"                                  \
-    "    <icon>/meta?name=favicon&amp;content=zimfile</icon>\n"         \
+    "    <icon>/catalog/v2/illustration/charlesray</icon>\n" \
+    "    <link rel=\"http://opds-spec.org/image/thumbnail\" href=\"/catalog/v2/illustration/charlesray\" />\n" \
     "    <link type=\"text/html\" href=\"/zimfile\" />\n"               \
     "    <author>\n"                                                    \
     "      <name>Wikipedia</name>\n"                                    \
@@ -650,7 +654,8 @@ std::string maskVariableOPDSFeedData(std::string s)
     "    <tags>unittest;wikipedia;_category:wikipedia;_pictures:no;_videos:no;_details:no;_ftindex:yes</tags>\n" \
     "    <articleCount>284</articleCount>\n"                            \
     "    <mediaCount>2</mediaCount>\n"                                  \
-    "    <icon>/meta?name=favicon&amp;content=zimfile</icon>\n"         \
+    "    <icon>/catalog/v2/illustration/raycharles</icon>\n" \
+    "    <link rel=\"http://opds-spec.org/image/thumbnail\" href=\"/catalog/v2/illustration/raycharles\" />\n" \
     "    <link type=\"text/html\" href=\"/zimfile\" />\n"               \
     "    <author>\n"                                                    \
     "      <name>Wikipedia</name>\n"                                    \
@@ -674,7 +679,8 @@ std::string maskVariableOPDSFeedData(std::string s)
     "    <tags>unittest;wikipedia;_pictures:no;_videos:no;_details:no</tags>\n" \
     "    <articleCount>284</articleCount>\n"                            \
     "    <mediaCount>2</mediaCount>\n"                                  \
-    "    <icon>/meta?name=favicon&amp;content=zimfile</icon>\n"         \
+    "    <icon>/catalog/v2/illustration/raycharles_uncategorized</icon>\n" \
+    "    <link rel=\"http://opds-spec.org/image/thumbnail\" href=\"/catalog/v2/illustration/raycharles_uncategorized\" />\n" \
     "    <link type=\"text/html\" href=\"/zimfile\" />\n"               \
     "    <author>\n"                                                    \
     "      <name>Wikipedia</name>\n"                                    \
@@ -942,6 +948,15 @@ TEST_F(LibraryServerTest, catalog_v2_root)
     <id>12345678-90ab-cdef-1234-567890abcdef</id>
     <content type="text">List of all categories in this catalog.</content>
   </entry>
+  <entry>
+    <title>List of languages</title>
+    <link rel="subsection"
+          href="/catalog/v2/languages"
+          type="application/atom+xml;profile=opds-catalog;kind=navigation"/>
+    <updated>YYYY-MM-DDThh:mm:ssZ</updated>
+    <id>12345678-90ab-cdef-1234-567890abcdef</id>
+    <content type="text">List of all languages in this catalog.</content>
+  </entry>
 </feed>
 )";
   EXPECT_EQ(maskVariableOPDSFeedData(r->body), expected_output);
@@ -971,7 +986,8 @@ TEST_F(LibraryServerTest, catalog_v2_categories)
   EXPECT_EQ(r->status, 200);
   const char expected_output[] = R"(<?xml version="1.0" encoding="UTF-8"?>
 <feed xmlns="http://www.w3.org/2005/Atom"
-      xmlns:opds="https://specs.opds.io/opds-1.2">
+      xmlns:opds="https://specs.opds.io/opds-1.2"
+      xmlns:thr="http://purl.org/syndication/thread/1.0">
   <id>12345678-90ab-cdef-1234-567890abcdef</id>
   <link rel="self"
         href="/catalog/v2/categories"
@@ -984,6 +1000,7 @@ TEST_F(LibraryServerTest, catalog_v2_categories)
 
   <entry>
     <title>jazz</title>
+    <thr:count>1</thr:count>
     <link rel="subsection"
           href="/catalog/v2/entries?category=jazz"
           type="application/atom+xml;profile=opds-catalog;kind=acquisition"/>
@@ -993,6 +1010,7 @@ TEST_F(LibraryServerTest, catalog_v2_categories)
   </entry>
   <entry>
     <title>wikipedia</title>
+    <thr:count>1</thr:count>
     <link rel="subsection"
           href="/catalog/v2/entries?category=wikipedia"
           type="application/atom+xml;profile=opds-catalog;kind=acquisition"/>
@@ -1005,6 +1023,40 @@ TEST_F(LibraryServerTest, catalog_v2_categories)
   EXPECT_EQ(maskVariableOPDSFeedData(r->body), expected_output);
 }
 
+TEST_F(LibraryServerTest, catalog_v2_languages)
+{
+  const auto r = zfs1_->GET("/catalog/v2/languages");
+  EXPECT_EQ(r->status, 200);
+  const char expected_output[] = R"(<?xml version="1.0" encoding="UTF-8"?>
+<feed xmlns="http://www.w3.org/2005/Atom"
+      xmlns:dc="http://purl.org/dc/terms/"
+      xmlns:opds="https://specs.opds.io/opds-1.2"
+      xmlns:thr="http://purl.org/syndication/thread/1.0">
+  <id>12345678-90ab-cdef-1234-567890abcdef</id>
+  <link rel="self"
+        href="/catalog/v2/languages"
+        type="application/atom+xml;profile=opds-catalog;kind=navigation"/>
+  <link rel="start"
+        href="/catalog/v2/root.xml"
+        type="application/atom+xml;profile=opds-catalog;kind=navigation"/>
+  <title>List of languages</title>
+  <updated>YYYY-MM-DDThh:mm:ssZ</updated>
+
+  <entry>
+    <title>English</title>
+    <dc:language>eng</dc:language>
+    <thr:count>3</thr:count>
+    <link rel="subsection"
+          href="/catalog/v2/entries?lang=eng"
+          type="application/atom+xml;profile=opds-catalog;kind=acquisition"/>
+    <updated>YYYY-MM-DDThh:mm:ssZ</updated>
+    <id>12345678-90ab-cdef-1234-567890abcdef</id>
+  </entry>
+</feed>
+)";
+  EXPECT_EQ(maskVariableOPDSFeedData(r->body), expected_output);
+}
+
 #define CATALOG_V2_ENTRIES_PREAMBLE(q)                        \
     "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"            \
     "<feed xmlns=\"http://www.w3.org/2005/Atom\"\n"           \
@@ -1090,6 +1142,42 @@ TEST_F(LibraryServerTest, catalog_v2_entries_filtered_by_range)
   }
 }
 
+TEST_F(LibraryServerTest, catalog_v2_entries_sorted)
+{
+  {
+    const auto r = zfs1_->GET("/catalog/v2/entries?sort=title");
+    EXPECT_EQ(r->status, 200);
+    EXPECT_EQ(maskVariableOPDSFeedData(r->body),
+      CATALOG_V2_ENTRIES_PREAMBLE("?sort=title")
+      "  <title>Filtered Entries (sort=title)</title>\n"
+      "  <updated>YYYY-MM-DDThh:mm:ssZ</updated>\n"
+      "  <totalResults>3</totalResults>\n"
+      "  <startIndex>0</startIndex>\n"
+      "  <itemsPerPage>3</itemsPerPage>\n"
+      CHARLES_RAY_CATALOG_ENTRY
+      UNCATEGORIZED_RAY_CHARLES_CATALOG_ENTRY
+      RAY_CHARLES_CATALOG_ENTRY
+      "</feed>\n"
+    );
+  }
+
+  {
+    const auto r = zfs1_->GET("/catalog/v2/entries?sort=title&order=desc&count=2");
+    EXPECT_EQ(r->status, 200);
+    EXPECT_EQ(maskVariableOPDSFeedData(r->body),
+      CATALOG_V2_ENTRIES_PREAMBLE("?count=2&order=desc&sort=title")
+      "  <title>Filtered Entries (count=2&amp;order=desc&amp;sort=title)</title>\n"
+      "  <updated>YYYY-MM-DDThh:mm:ssZ</updated>\n"
+      "  <totalResults>3</totalResults>\n"
+      "  <startIndex>0</startIndex>\n"
+      "  <itemsPerPage>2</itemsPerPage>\n"
+      RAY_CHARLES_CATALOG_ENTRY
+      UNCATEGORIZED_RAY_CHARLES_CATALOG_ENTRY
+      "</feed>\n"
+    );
+  }
+}
+
 TEST_F(LibraryServerTest, catalog_v2_entries_filtered_by_search_terms)
 {
   const auto r = zfs1_->GET("/catalog/v2/entries?q=\"ray%20charles\"");
@@ -1106,3 +1194,279 @@ TEST_F(LibraryServerTest, catalog_v2_entries_filtered_by_search_terms)
     "</feed>\n"
   );
 }
+
+TEST_F(LibraryServerTest, catalog_v2_changes)
+{
+  const auto r = zfs1_->GET("/catalog/v2/changes?since=0");
+  EXPECT_EQ(r->status, 200);
+  EXPECT_NE(r->body.find("<title>Changes since revision 0</title>"), std::string::npos);
+  EXPECT_NE(r->body.find("<id>urn:uuid:raycharles</id>"), std::string::npos);
+  EXPECT_NE(r->body.find("<id>urn:uuid:charlesray</id>"), std::string::npos);
+  EXPECT_NE(r->body.find("<id>urn:uuid:raycharles_uncategorized</id>"), std::string::npos);
+  // Only the books of /catalog/v2/entries
+  EXPECT_NE(r->body.find("<totalResults>3</totalResults>"), std::string::npos);
+  EXPECT_EQ(r->body.find("deleted-entry"), std::string::npos);
+
+  // The changes are paged
+  const auto page = zfs1_->GET("/catalog/v2/changes?since=0&start=1&count=1");
+  EXPECT_EQ(page->status, 200);
+  EXPECT_NE(page->body.find("<totalResults>3</totalResults>"), std::string::npos);
+  EXPECT_NE(page->body.find("<startIndex>1</startIndex>"), std::string::npos);
+  EXPECT_NE(page->body.find("<itemsPerPage>1</itemsPerPage>"), std::string::npos);
+  EXPECT_NE(page->body.find("<id>urn:uuid:raycharles</id>"), std::string::npos);
+  EXPECT_EQ(page->body.find("<id>urn:uuid:charlesray</id>"), std::string::npos);
+
+  std::smatch match;
+  ASSERT_TRUE(std::regex_search(r->body, match, std::regex("<revision>([0-9]+)</revision>")));
+  const std::string revision = match[1];
+  const auto r2 = zfs1_->GET(("/catalog/v2/changes?since=" + revision).c_str());
+  EXPECT_EQ(r2->status, 200);
+  EXPECT_EQ(r2->body.find("<entry>"), std::string::npos);
+  EXPECT_NE(r2->body.find("<revision>" + revision + "</revision>"), std::string::npos);
+
+  // The changes since this revision are not known
+  EXPECT_EQ(zfs1_->GET("/catalog/v2/changes?since=1")->status, 410);
+}
+
+TEST_F(LibraryServerTest, catalog_v2_illustration)
+{
+  const auto r = zfs1_->GET("/catalog/v2/illustration/raycharles");
+  EXPECT_EQ(r->status, 200);
+  EXPECT_EQ(r->get_header_value("Content-Type").substr(0, 6), "image/");
+  EXPECT_FALSE(r->body.empty());
+  const auto etag = r->get_header_value("ETag");
+  EXPECT_FALSE(etag.empty());
+
+  const auto r304 = zfs1_->GET("/catalog/v2/illustration/raycharles", { {"If-None-Match", etag} });
+  EXPECT_EQ(r304->status, 304);
+
+  // Both books use the same zim file
+  EXPECT_EQ(zfs1_->GET("/catalog/v2/illustration/charlesray")->body, r->body);
+
+  EXPECT_EQ(zfs1_->GET("/catalog/v2/illustration/non-existent-book")->status, 404);
+}
+
+// Three copies of the same zim file with different metadata: each copy gives
+// the same results, with the same scores, as the other ones.
+const char SEARCH_LIBRARY_XML[] = R"XML(<library version="1.0">
+  <book id="ray_en" path="ray_en.zim" title="Ray Charles"
+        language="eng" category="wikipedia" name="wikipedia_en_ray_charles"
+        tags="wikipedia;_pictures:no"></book>
+  <book id="ray_fr" path="ray_fr.zim" title="Ray Charles (fr)"
+        language="fra" category="wikipedia" name="wikipedia_fr_ray_charles"
+        tags="wikipedia;_pictures:yes"></book>
+  <book id="ray_jazz" path="ray_jazz.zim" title="Ray Charles (jazz)"
+        language="eng" category="jazz" name="jazz_en_ray_charles"
+        tags="jazz;_pictures:no"></book>
+</library>
+)XML";
+
+class LibrarySearchServerTest : public ::testing::Test
+{
+protected:
+  std::unique_ptr<ZimFileServer>   zfs1_;
+  std::string tmpDir_;
+
+  const int PORT = 8003;
+  const std::vector<std::string> BOOK_NAMES {"ray_en", "ray_fr", "ray_jazz"};
+
+protected:
+  void SetUp() override {
+    tmpDir_ = makeTmpDirectory();
+    for (const auto& name : BOOK_NAMES) {
+      ASSERT_TRUE(copyFile("./test/zimfile.zim", tmpDir_ + "/" + name + ".zim"));
+    }
+    ASSERT_TRUE(writeTextFile(tmpDir_ + "/library.xml", SEARCH_LIBRARY_XML));
+    zfs1_.reset(new ZimFileServer(PORT, tmpDir_ + "/library.xml"));
+  }
+
+  void TearDown() override {
+    zfs1_.reset();
+    removeDirectory(tmpDir_);
+  }
+};
+
+struct SearchPage
+{
+  // The links of the results.
+  std::vector<std::string> results;
+  // The links to the pages of results.
+  std::vector<std::string> pages;
+  unsigned int count = 0;
+};
+
+std::vector<std::string> getHrefs(const std::string& html)
+{
+  std::vector<std::string> hrefs;
+  const std::regex hrefRegex("href=\"([^\"]*)\"");
+  for (std::sregex_iterator it(html.begin(), html.end(), hrefRegex), end; it != end; ++it) {
+    std::string href = (*it)[1];
+    for (auto pos = href.find("&amp;"); pos != std::string::npos; pos = href.find("&amp;", pos + 1)) {
+      href.replace(pos, 5, "&");
+    }
+    hrefs.push_back(href);
+  }
+  return hrefs;
+}
+
+SearchPage getSearchPage(ZimFileServer& zfs, const std::string& url)
+{
+  SearchPage page;
+  const auto r = zfs.GET(url.c_str());
+  EXPECT_EQ(r->status, 200) << url;
+  const auto& body = r->body;
+  const auto resultsPos = body.find("<div class=\"results\">");
+  const auto footerPos = body.find("<div class=\"footer\">");
+  if (resultsPos == std::string::npos || footerPos == std::string::npos) {
+    ADD_FAILURE() << "Not a search result page: " << url;
+    return page;
+  }
+  page.results = getHrefs(body.substr(resultsPos, footerPos - resultsPos));
+  page.pages = getHrefs(body.substr(footerPos));
+
+  std::smatch match;
+  if (std::regex_search(body, match, std::regex("of <b>\\s*([0-9,]+)\\s*</b>"))) {
+    std::string count = match[1];
+    count.erase(std::remove(count.begin(), count.end(), ','), count.end());
+    page.count = std::stoul(count);
+  }
+  return page;
+}
+
+// The name of the book of a result link ("/<name>/<path>").
+std::string getResultBookName(const std::string& link)
+{
+  return link.substr(1, link.find('/', 1) - 1);
+}
+
+std::set<std::string> getResultBookNames(const std::vector<std::string>& links)
+{
+  std::set<std::string> names;
+  for (const auto& link : links) {
+    names.insert(getResultBookName(link));
+  }
+  return names;
+}
+
+TEST_F(LibrarySearchServerTest, search_without_content_in_scope)
+{
+  const auto bookCount = getSearchPage(*zfs1_, "/search?books=ray_en&pattern=ray&pageLength=5").count;
+  ASSERT_GE(bookCount, 10U);
+
+  const struct {
+    std::string scope;
+    // The scope arguments in the links to the other pages.
+    std::string arguments;
+    std::set<std::string> books;
+  } testCases[] = {
+    { "",                              "",                              {"ray_en", "ray_fr", "ray_jazz"} },
+    { "books=ray_fr;ray_jazz&",        "books=ray_fr%3Bray_jazz&",      {"ray_fr", "ray_jazz"} },
+    { "books=ray_en;unknown&",         "books=ray_en%3Bunknown&",       {"ray_en"} },
+    { "lang=eng&",                     "lang=eng&",                     {"ray_en", "ray_jazz"} },
+    { "category=jazz&",                "category=jazz&",                {"ray_jazz"} },
+    { "name=wikipedia_fr_ray_charles&", "name=wikipedia_fr_ray_charles&", {"ray_fr"} },
+    { "tag=wikipedia&",                "tag=wikipedia&",                {"ray_en", "ray_fr"} },
+    { "notag=jazz&",                   "notag=jazz&",                   {"ray_en", "ray_fr"} },
+    { "tag=wikipedia&lang=eng&",       "lang=eng&tag=wikipedia&",       {"ray_en"} },
+    { "lang=eng&books=ray_fr&",        "books=ray_fr&lang=eng&",        {} },
+  };
+
+  for (const auto& testCase : testCases) {
+    const auto url = "/search?" + testCase.scope + "pattern=ray&pageLength=5";
+    const auto page = getSearchPage(*zfs1_, url);
+    EXPECT_EQ(getResultBookNames(page.results), testCase.books) << url;
+    EXPECT_EQ(page.count, bookCount * testCase.books.size()) << url;
+    if (testCase.books.empty()) {
+      EXPECT_TRUE(page.results.empty()) << url;
+      EXPECT_TRUE(page.pages.empty()) << url;
+      continue;
+    }
+
+    // The links to the other pages keep the scope.
+    EXPECT_EQ(page.results.size(), 5U) << url;
+    ASSERT_FALSE(page.pages.empty()) << url;
+    const auto prefix = "/search?" + testCase.arguments + "pattern=ray&";
+    std::string nextPageLink;
+    for (const auto& link : page.pages) {
+      EXPECT_EQ(link.substr(0, prefix.size()), prefix) << url;
+      if (link.find("&start=5&pageLength=5") != std::string::npos) {
+        nextPageLink = link;
+      }
+    }
+    ASSERT_FALSE(nextPageLink.empty()) << url;
+
+    const auto nextPage = getSearchPage(*zfs1_, nextPageLink);
+    EXPECT_EQ(nextPage.results.size(), 5U) << nextPageLink;
+    for (const auto& name : getResultBookNames(nextPage.results)) {
+      EXPECT_EQ(testCase.books.count(name), 1U) << nextPageLink << ": " << name;
+    }
+    EXPECT_EQ(nextPage.count, page.count) << nextPageLink;
+  }
+}
+
+// The results of books searched alone, merged round-robin by rank in the
+// order of the books.
+std::vector<std::string> mergeByRank(const std::vector<std::vector<std::string>>& bookResults)
+{
+  std::vector<std::string> merged;
+  for (size_t rank = 0; ; rank++) {
+    const auto size = merged.size();
+    for (const auto& results : bookResults) {
+      if (rank < results.size()) {
+        merged.push_back(results[rank]);
+      }
+    }
+    if (merged.size() == size) {
+      return merged;
+    }
+  }
+}
+
+TEST_F(LibrarySearchServerTest, search_without_content_merges_the_books_by_rank)
+{
+  // The results of each book searched alone. As the books are copies of the
+  // same archive, the results of a same rank have the same score and are
+  // ordered like the books (by id).
+  std::vector<std::vector<std::string>> bookResults;
+  for (const auto& name : BOOK_NAMES) {
+    const auto page = getSearchPage(*zfs1_, "/search?books=" + name + "&pattern=ray&pageLength=4");
+    ASSERT_EQ(page.results.size(), 4U) << name;
+    for (const auto& link : page.results) {
+      EXPECT_EQ(getResultBookName(link), name);
+    }
+    bookResults.push_back(page.results);
+  }
+  const auto expected = mergeByRank(bookResults);
+  ASSERT_EQ(expected.size(), 12U);
+
+  // The pages of the library-wide search, following the link to the next
+  // page from each page.
+  std::vector<std::string> results;
+  std::string url = "/search?pattern=ray&pageLength=3";
+  for (unsigned int start = 0; start < 12; start += 3) {
+    const auto page = getSearchPage(*zfs1_, url);
+    EXPECT_EQ(page.results.size(), 3U) << url;
+    results.insert(results.end(), page.results.begin(), page.results.end());
+
+    const auto nextPage = "&start=" + std::to_string(start + 3) + "&pageLength=3";
+    url.clear();
+    for (const auto& link : page.pages) {
+      if (link.size() >= nextPage.size()
+       && link.compare(link.size() - nextPage.size(), nextPage.size(), nextPage) == 0) {
+        url = link;
+      }
+    }
+    ASSERT_FALSE(url.empty()) << "No link to the page starting at " << start + 3;
+  }
+  EXPECT_EQ(results, expected);
+
+  // A page not aligned on the number of books.
+  const auto page = getSearchPage(*zfs1_, "/search?pattern=ray&start=4&pageLength=5");
+  EXPECT_EQ(page.results,
+            std::vector<std::string>(expected.begin() + 4, expected.begin() + 9));
+
+  // The same order in a scope.
+  const auto scopedPage = getSearchPage(*zfs1_, "/search?books=ray_jazz;ray_en&pattern=ray&pageLength=8");
+  EXPECT_EQ(scopedPage.results,
+            mergeByRank({bookResults[0], bookResults[2]}));
+}
@@ -0,0 +1,430 @@
+/*
+ * Copyright (C) 2021 Kiwix <contact@kiwix.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+// End to end load benchmark of kiwix::Server.
+//
+// An in-process server is started on the test zim files and hammered by
+// N client threads, each one using its own keep-alive connection.
+// Each request mix is run separately and reported (throughput, latency
+// percentiles) as a JSON document.
+//
+// Usage:
+//   server_benchmark [--threads N] [--server-threads N] [--requests N]
+//                    [--mix content|range|search|suggest|catalog|user|all]
+//                    [--zim path.zim]... [--port N] [--output report.json]
+//
+// The ZIM files given with `--zim` are served too. They are part of the
+// catalog, of the searches without content, and of the `user` mix (their
+// main page and title suggestions). The server listens on a free port,
+// unless one is given with `--port`.
+
+#include "benchmark.h"
+
+#include "../include/library.h"
+#include "../include/manager.h"
+#include "../include/name_mapper.h"
+#include "../include/server.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+
+const char* const ADDRESS = "127.0.0.1";
+// The port of the server, set once before the clients are started.
+int serverPort = 0;
+
+struct Request
+{
+  std::string path;
+  std::string extraHeaders;
+};
+
+typedef std::vector<Request> RequestMix;
+
+// `userBookNames` are the names of the books given with `--zim`.
+std::map<std::string, RequestMix> requestMixes(const std::vector<std::string>& userBookNames)
+{
+  std::map<std::string, RequestMix> mixes;
+  mixes["content"] = {
+    {"/zimfile/A/index", ""},
+    {"/zimfile/A/Ray_Charles", ""},
+    {"/zimfile/I/m/Ray_Charles_classic_piano_pose.jpg", ""},
+    {"/skin/jquery-ui/jquery-ui.min.js", ""},
+  };
+  mixes["range"] = {
+    {"/zimfile/I/m/Ray_Charles_classic_piano_pose.jpg", "Range: bytes=0-1023\r\n"},
+    {"/zimfile/I/m/Ray_Charles_classic_piano_pose.jpg", "Range: bytes=1024-8191\r\n"},
+    {"/zimfile/I/m/Ray_Charles_classic_piano_pose.jpg", "Range: bytes=-4096\r\n"},
+  };
+  mixes["search"] = {
+    {"/search?content=zimfile&pattern=ray", ""},
+    {"/search?content=zimfile&pattern=charles&start=5&pageLength=10", ""},
+    {"/search?content=zimfile&pattern=piano", ""},
+    {"/search?pattern=ray", ""},
+  };
+  mixes["suggest"] = {
+    {"/suggest?content=zimfile&term=ray", ""},
+    {"/suggest?content=zimfile&term=cha", ""},
+    {"/suggest?content=zimfile&term=piano%20music", ""},
+  };
+  mixes["catalog"] = {
+    {"/catalog/v2/entries", ""},
+    {"/catalog/v2/entries?q=ray&count=10", ""},
+    {"/catalog/v2/entries?lang=eng&start=1&count=1", ""},
+    {"/catalog/v2/categories", ""},
+    {"/catalog/search?q=charles", ""},
+  };
+  for (const auto& name : userBookNames) {
+    mixes["user"].push_back({"/" + name + "/", ""});
+    mixes["user"].push_back({"/suggest?content=" + name + "&term=a", ""});
+  }
+  return mixes;
+}
+
+// A very small HTTP/1.1 client keeping its connection alive.
+// httplib only supports keep-alive for a batch of requests sent at once,
+// which doesn't allow to measure the latency of each request.
+class KeepAliveConnection
+{
+  public:
+    KeepAliveConnection() { connect(); }
+    ~KeepAliveConnection() { close(); }
+
+    // Send the request and read the full response.
+    // Return the http status code (or -1 on error).
+    int get(const Request& request)
+    {
+      const std::string req = "GET " + request.path + " HTTP/1.1\r\n"
+                              "Host: " + ADDRESS + "\r\n"
+                              + request.extraHeaders +
+                              "\r\n";
+      if (!sendAll(req)) {
+        // The server may have closed the idle connection. Retry once.
+        reconnect();
+        if (!sendAll(req)) {
+          return -1;
+        }
+      }
+      return readResponse();
+    }
+
+  private:
+    void connect()
+    {
+      m_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+      if (m_fd < 0) {
+        throw std::runtime_error("Cannot create socket");
+      }
+      int flag = 1;
+      setsockopt(m_fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+      sockaddr_in addr;
+      std::memset(&addr, 0, sizeof(addr));
+      addr.sin_family = AF_INET;
+      addr.sin_port = htons(serverPort);
+      inet_pton(AF_INET, ADDRESS, &addr.sin_addr);
+      if (::connect(m_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        throw std::runtime_error("Cannot connect to the server");
+      }
+      m_buffer.clear();
+    }
+
+    void close()
+    {
+      if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+      }
+    }
+
+    void reconnect() { close(); connect(); }
+
+    bool sendAll(const std::string& data)
+    {
+      size_t sent = 0;
+      while (sent < data.size()) {
+        auto n = ::send(m_fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+          return false;
+        }
+        sent += n;
+      }
+      return true;
+    }
+
+    bool fill()
+    {
+      char buf[16384];
+      auto n = ::recv(m_fd, buf, sizeof(buf), 0);
+      if (n <= 0) {
+        return false;
+      }
+      m_buffer.append(buf, n);
+      return true;
+    }
+
+    // Consume `size` bytes of body (reading from the socket as needed).
+    bool skip(size_t size)
+    {
+      while (m_buffer.size() < size) {
+        size -= m_buffer.size();
+        m_buffer.clear();
+        if (!fill()) {
+          return false;
+        }
+      }
+      m_buffer.erase(0, size);
+      return true;
+    }
+
+    bool readLine(std::string& line)
+    {
+      std::string::size_type pos;
+      while ((pos = m_buffer.find("\r\n")) == std::string::npos) {
+        if (!fill()) {
+          return false;
+        }
+      }
+      line = m_buffer.substr(0, pos);
+      m_buffer.erase(0, pos + 2);
+      return true;
+    }
+
+    int readResponse()
+    {
+      std::string line;
+      if (!readLine(line) || line.size() < 12) {
+        reconnect();
+        return -1;
+      }
+      const int status = std::atoi(line.c_str() + 9);
+      long contentLength = -1;
+      bool chunked = false;
+      bool closeConnection = false;
+      while (readLine(line) && !line.empty()) {
+        std::string lower(line);
+        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        if (lower.compare(0, 15, "content-length:") == 0) {
+          contentLength = std::atol(line.c_str() + 15);
+        } else if (lower.compare(0, 18, "transfer-encoding:") == 0
+                && lower.find("chunked") != std::string::npos) {
+          chunked = true;
+        } else if (lower.compare(0, 11, "connection:") == 0
+                && lower.find("close") != std::string::npos) {
+          closeConnection = true;
+        }
+      }
+
+      bool ok = true;
+      if (chunked) {
+        while (ok) {
+          ok = readLine(line);
+          const auto chunkSize = std::strtoul(line.c_str(), nullptr, 16);
+          ok = ok && skip(chunkSize + 2);
+          if (chunkSize == 0) {
+            break;
+          }
+        }
+      } else if (contentLength >= 0) {
+        ok = skip(contentLength);
+      } else if (status != 204 && status != 304) {
+        while (fill()) {}
+        closeConnection = true;
+      }
+
+      if (!ok || closeConnection) {
+        reconnect();
+      }
+      return ok ? status : -1;
+    }
+
+    int m_fd = -1;
+    std::string m_buffer;
+};
+
+struct MixResult
+{
+  benchmark::Samples latencies;
+  size_t errors = 0;
+  uint64_t durationNs = 0;
+};
+
+MixResult runMix(const RequestMix& mix, size_t nbThreads, size_t nbRequests)
+{
+  std::vector<benchmark::Samples> samples(nbThreads);
+  std::atomic<size_t> errors(0);
+  std::vector<std::thread> clients;
+
+  // Warm up the caches of the server with each request of the mix.
+  {
+    KeepAliveConnection connection;
+    for (const auto& request : mix) {
+      connection.get(request);
+    }
+  }
+
+  const auto start = benchmark::Clock::now();
+  for (size_t t = 0; t < nbThreads; t++) {
+    clients.emplace_back([&, t]() {
+      KeepAliveConnection connection;
+      for (size_t i = 0; i < nbRequests; i++) {
+        const auto& request = mix[(i + t) % mix.size()];
+        const auto reqStart = benchmark::Clock::now();
+        const auto status = connection.get(request);
+        samples[t].add(benchmark::elapsedNs(reqStart, benchmark::Clock::now()));
+        if (status < 200 || status >= 400) {
+          errors++;
+        }
+      }
+    });
+  }
+  for (auto& client : clients) {
+    client.join();
+  }
+
+  MixResult result;
+  result.durationNs = benchmark::elapsedNs(start, benchmark::Clock::now());
+  for (const auto& s : samples) {
+    result.latencies.merge(s);
+  }
+  result.errors = errors;
+  return result;
+}
+
+// A port on which nothing listens (the system chooses a free one).
+int findFreePort()
+{
+  const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) {
+    throw std::runtime_error("Cannot create socket");
+  }
+  sockaddr_in addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = 0;
+  inet_pton(AF_INET, ADDRESS, &addr.sin_addr);
+  socklen_t addrSize = sizeof(addr);
+  if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0
+   || ::getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &addrSize) != 0) {
+    ::close(fd);
+    throw std::runtime_error("Cannot find a free port");
+  }
+  ::close(fd);
+  return ntohs(addr.sin_port);
+}
+
+// The values of all the occurrences of the option `name`.
+std::vector<std::string> getOptions(int argc, char** argv, const std::string& name)
+{
+  std::vector<std::string> values;
+  for (int i = 1; i + 1 < argc; i++) {
+    if (name == argv[i]) {
+      values.push_back(argv[++i]);
+    }
+  }
+  return values;
+}
+
+} // unnamed namespace
+
+int main(int argc, char** argv)
+{
+  const size_t nbThreads = benchmark::getOption(argc, argv, "--threads", 4L);
+  const int nbServerThreads = benchmark::getOption(argc, argv, "--server-threads", 4L);
+  const size_t nbRequests = benchmark::getOption(argc, argv, "--requests", 1000L);
+  const std::string selectedMix = benchmark::getOption(argc, argv, "--mix", std::string("all"));
+  const std::string outputPath = benchmark::getOption(argc, argv, "--output", std::string());
+  const auto userZimPaths = getOptions(argc, argv, "--zim");
+  serverPort = benchmark::getOption(argc, argv, "--port", 0L);
+  if (serverPort == 0) {
+    serverPort = findFreePort();
+  }
+
+  kiwix::Library library;
+  kiwix::Manager manager(&library);
+  for (const auto& zimpath : {"./test/zimfile.zim", "./test/corner_cases.zim"}) {
+    if (!manager.addBookFromPath(zimpath, zimpath, "", false)) {
+      std::cerr << "Unable to add the ZIM file '" << zimpath << "'" << std::endl;
+      return 1;
+    }
+  }
+  std::vector<std::string> userBookIds;
+  for (const auto& zimpath : userZimPaths) {
+    const auto bookId = manager.addBookFromPathAndGetId(zimpath, zimpath, "", false);
+    if (bookId.empty()) {
+      std::cerr << "Unable to add the ZIM file '" << zimpath << "'" << std::endl;
+      return 1;
+    }
+    userBookIds.push_back(bookId);
+  }
+  kiwix::HumanReadableNameMapper nameMapper(library, false);
+  std::vector<std::string> userBookNames;
+  for (const auto& bookId : userBookIds) {
+    userBookNames.push_back(nameMapper.getNameForId(bookId));
+  }
+  kiwix::Server server(&library, &nameMapper);
+  server.setAddress(ADDRESS);
+  server.setPort(serverPort);
+  server.setNbThreads(nbServerThreads);
+  server.setVerbose(false);
+  if (!server.start()) {
+    std::cerr << "Unable to start the server" << std::endl;
+    return 1;
+  }
+
+  std::vector<benchmark::JsonObject> results;
+  bool hasErrors = false;
+  for (const auto& mix : requestMixes(userBookNames)) {
+    if (selectedMix != "all" && selectedMix != mix.first) {
+      continue;
+    }
+    auto r = runMix(mix.second, nbThreads, nbRequests);
+    const double seconds = r.durationNs / 1e9;
+    benchmark::JsonObject o;
+    o.add("name", mix.first)
+     .add("requests", r.latencies.size())
+     .add("errors", r.errors)
+     .add("duration_s", seconds)
+     .add("throughput_rps", seconds > 0 ? r.latencies.size() / seconds : 0)
+     .add("latency_us", benchmark::latencySummary(r.latencies));
+    results.push_back(o);
+    hasErrors = hasErrors || r.errors;
+  }
+  server.stop();
+
+  benchmark::JsonObject report;
+  report.add("benchmark", "server")
+        .add("client_threads", nbThreads)
+        .add("server_threads", nbServerThreads)
+        .add("requests_per_thread", nbRequests)
+        .add("user_zims", userZimPaths.size())
+        .add("results", results);
+  benchmark::writeReport(report, outputPath);
+  return hasErrors ? 1 : 0;
+}
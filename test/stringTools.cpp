@@ -18,12 +18,17 @@
  */
 
 #include "gtest/gtest.h"
+#include <memory>
 #include <string>
+#include <thread>
 #include <vector>
+#include <unicode/translit.h>
+#include <unicode/ucnv.h>
 
 namespace kiwix {
 std::string join(const std::vector<std::string>& list, const std::string& sep);
 std::vector<std::string> split(const std::string&  base, const std::string& sep, bool trimEmpty, bool keepDelim);
+std::string removeAccents(const std::string& text);
 };
 
 using namespace kiwix;
@@ -58,4 +63,84 @@ TEST(stringTools, split)
   ASSERT_EQ(split(";a;b=;c=d;", ";=", false, true), list6);
 }
 
+// The reference implementation of removeAccents (without any shortcut).
+std::string icuRemoveAccents(const std::string& text)
+{
+  ucnv_setDefaultName("UTF-8");
+  UErrorCode status = U_ZERO_ERROR;
+  std::unique_ptr<icu::Transliterator> trans(icu::Transliterator::createInstance(
+      "Lower; NFD; [:M:] remove; NFC", UTRANS_FORWARD, status));
+  icu::UnicodeString ustring(text.c_str());
+  trans->transliterate(ustring);
+  std::string result;
+  ustring.toUTF8String(result);
+  return result;
+}
+
+TEST(stringTools, removeAccents)
+{
+  ASSERT_EQ(removeAccents(""), "");
+  ASSERT_EQ(removeAccents("Ray Charles"), "ray charles");
+  ASSERT_EQ(removeAccents("RAY_CHARLES-1930 (Wikipedia)"), "ray_charles-1930 (wikipedia)");
+  ASSERT_EQ(removeAccents("Érdős Pál"), "erdos pal");
+  ASSERT_EQ(removeAccents("NAÏVE Café"), "naive cafe");
+  ASSERT_EQ(removeAccents("Ελληνικά"), "ελληνικα");
+  ASSERT_EQ(removeAccents("Москва"), "москва");
+  ASSERT_EQ(removeAccents("東京都"), "東京都");
+}
+
+TEST(stringTools, removeAccentsAsciiFastPath)
+{
+  // Every ascii character, alone and inside longer strings (to cover the
+  // word-at-a-time check), must give the same result than ICU.
+  for (int c = 1; c < 128; c++) {
+    const std::string s(1, char(c));
+    ASSERT_EQ(removeAccents(s), icuRemoveAccents(s)) << "char " << c;
+    const std::string longS = "Some Text " + s + " WITH 0123456789 " + s + s;
+    ASSERT_EQ(removeAccents(longS), icuRemoveAccents(longS)) << "char " << c;
+  }
+
+  // Non ascii characters at any place (word boundaries of the fast check).
+  for (size_t pos = 0; pos < 20; pos++) {
+    std::string s = "ABCDEFGHIJKLMNOPQRST";
+    s.insert(pos, "É");
+    ASSERT_EQ(removeAccents(s), icuRemoveAccents(s)) << s;
+  }
+
+  // Text is read up to the first null character.
+  const std::string withNull("ABC\0DEF", 7);
+  ASSERT_EQ(removeAccents(withNull), icuRemoveAccents(withNull));
+  ASSERT_EQ(removeAccents(withNull), "abc");
+}
+
+TEST(stringTools, removeAccentsMultiThreads)
+{
+  const std::vector<std::string> texts = {
+    "Ray Charles", "Érdős Pál", "Ελληνικά", "Москва", "NAÏVE Café"
+  };
+  std::vector<std::string> expected;
+  for (const auto& t : texts) {
+    expected.push_back(icuRemoveAccents(t));
+  }
+
+  std::vector<std::thread> threads;
+  std::vector<int> failures(4, 0);
+  for (size_t i = 0; i < failures.size(); i++) {
+    threads.emplace_back([&, i]() {
+      for (int n = 0; n < 100; n++) {
+        for (size_t t = 0; t < texts.size(); t++) {
+          failures[i] += removeAccents(texts[t]) != expected[t];
+        }
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  for (auto f : failures) {
+    ASSERT_EQ(f, 0);
+  }
+}
+
 };
+
@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) 2021 Kiwix <contact@kiwix.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#include "gtest/gtest.h"
+
+#include "../include/verifier.h"
+#include "../src/tools/md5.h"
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+namespace
+{
+
+std::string readFile(const std::string& path)
+{
+  std::ifstream in(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void writeFile(const std::string& path, const std::string& content)
+{
+  std::ofstream(path, std::ios::binary | std::ios::trunc) << content;
+}
+
+/* A file passing the checksum check (but not a real zim file). */
+std::string makeZimContent(size_t size)
+{
+  std::string content(size - 16, 'x');
+  const char header[] = "\x5a\x49\x4d\x04";
+  content.replace(0, 4, header, 4);
+  const uint64_t mimeListPos = 80;
+  const uint64_t checksumPos = size - 16;
+  for (unsigned i = 0; i < 8; i++) {
+    content[56 + i] = static_cast<char>((mimeListPos >> (8 * i)) & 0xff);
+    content[72 + i] = static_cast<char>((checksumPos >> (8 * i)) & 0xff);
+  }
+  kiwix::Md5 md5;
+  md5.update(content.data(), content.size());
+  return content + md5.digest();
+}
+
+kiwix::Verifier::Progress verify(kiwix::Verifier& verifier, const std::string& path)
+{
+  kiwix::Verifier::Progress result;
+  verifier.verify(path, [&](const kiwix::Verifier::Progress& progress) {
+    if (progress.finished) {
+      result = progress;
+    }
+  });
+  verifier.wait();
+  return result;
+}
+
+} // unnamed namespace
+
+TEST(VerifierTest, md5)
+{
+  kiwix::Md5 md5;
+  md5.update("a", 1);
+  md5.update("bc", 2);
+  EXPECT_EQ(md5.digest(), std::string("\x90\x01\x50\x98\x3c\xd2\x4f\xb0"
+                                      "\xd6\x96\x3f\x7d\x28\xe1\x7f\x72", 16));
+}
+
+TEST(VerifierTest, verify)
+{
+  kiwix::Verifier verifier;
+  auto progress = verify(verifier, "./test/example.zim");
+  EXPECT_TRUE(progress.finished);
+  EXPECT_EQ(progress.integrity.status, kiwix::Book::Integrity::VALID);
+  EXPECT_EQ(progress.integrity.fileSize, 259145U);
+  EXPECT_EQ(progress.bytesRead, progress.bytesTotal);
+  EXPECT_EQ(verifier.getIntegrity("./test/example.zim").status,
+            kiwix::Book::Integrity::VALID);
+
+  std::string content = readFile("./test/example.zim");
+  content[content.size() / 2] ^= 1;
+  writeFile("./test/verifier_corrupted.zim", content);
+  progress = verify(verifier, "./test/verifier_corrupted.zim");
+  EXPECT_EQ(progress.integrity.status, kiwix::Book::Integrity::CORRUPTED);
+
+  progress = verify(verifier, "./test/non_existent.zim");
+  EXPECT_TRUE(progress.finished);
+  EXPECT_EQ(progress.integrity.status, kiwix::Book::Integrity::UNKNOWN);
+
+  // A split zim file
+  const auto zimContent = makeZimContent(3 * 1024 * 1024 + 10);
+  writeFile("./test/verifier_split.zimaa", zimContent.substr(0, 2 * 1024 * 1024));
+  writeFile("./test/verifier_split.zimab", zimContent.substr(2 * 1024 * 1024));
+  progress = verify(verifier, "./test/verifier_split.zim");
+  EXPECT_EQ(progress.integrity.status, kiwix::Book::Integrity::VALID);
+  EXPECT_EQ(progress.integrity.fileSize, zimContent.size());
+  std::remove("./test/verifier_split.zimaa");
+  std::remove("./test/verifier_split.zimab");
+}
+
+TEST(VerifierTest, resultsAreKept)
+{
+  const std::string path = "./test/verifier_cache.zim";
+  writeFile(path, makeZimContent(1000));
+  kiwix::Verifier verifier(2);
+  EXPECT_EQ(verify(verifier, path).integrity.status, kiwix::Book::Integrity::VALID);
+
+  // The file is not read again
+  bool called = false;
+  verifier.verify(path, [&](const kiwix::Verifier::Progress& progress) {
+    called = true;
+    EXPECT_TRUE(progress.finished);
+    EXPECT_EQ(progress.integrity.status, kiwix::Book::Integrity::VALID);
+  });
+  EXPECT_TRUE(called);
+
+  kiwix::Book book;
+  book.setPath(path);
+  EXPECT_TRUE(verifier.updateIntegrity(book));
+  EXPECT_EQ(book.getIntegrity().status, kiwix::Book::Integrity::VALID);
+  EXPECT_FALSE(verifier.updateIntegrity(book));
+
+  // The result of a book is used
+  kiwix::Verifier verifier2;
+  called = false;
+  verifier2.verify(book, [&](const kiwix::Verifier::Progress& progress) {
+    called = true;
+  });
+  EXPECT_TRUE(called);
+
+  // Not once the file is modified
+  writeFile(path, makeZimContent(2000));
+  EXPECT_EQ(verifier.getIntegrity(path).status, kiwix::Book::Integrity::UNKNOWN);
+  EXPECT_TRUE(verifier.updateIntegrity(book));
+  EXPECT_EQ(book.getIntegrity().status, kiwix::Book::Integrity::UNKNOWN);
+  EXPECT_EQ(verify(verifier, path).integrity.fileSize, 2000U);
+  std::remove(path.c_str());
+}
+
+TEST(VerifierTest, throttleAndCancel)
+{
+  const std::string path = "./test/verifier_throttled.zim";
+  writeFile(path, makeZimContent(4 * 1024 * 1024));
+  kiwix::Verifier verifier;
+
+  // 3 of the 4 chunks wait for 1/8 s each
+  verifier.setMaxBytesPerSecond(8 * 1024 * 1024);
+  const auto start = std::chrono::steady_clock::now();
+  EXPECT_EQ(verify(verifier, path).integrity.status, kiwix::Book::Integrity::VALID);
+  EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(300));
+
+  writeFile(path, makeZimContent(4 * 1024 * 1024 + 1));
+  verifier.setMaxBytesPerSecond(1);
+  std::atomic<bool> finished(false);
+  kiwix::Verifier::Progress result;
+  verifier.verify(path, [&](const kiwix::Verifier::Progress& progress) {
+    if (progress.finished) {
+      result = progress;
+      finished = true;
+    }
+  });
+  // Queued behind the running check.
+  verifier.verify("./test/example.zim");
+  verifier.cancel("./test/example.zim");
+  verifier.cancel(path);
+  verifier.wait();
+  EXPECT_TRUE(finished);
+  EXPECT_EQ(result.integrity.status, kiwix::Book::Integrity::UNKNOWN);
+  EXPECT_EQ(verifier.getIntegrity(path).status, kiwix::Book::Integrity::UNKNOWN);
+  EXPECT_EQ(verifier.getIntegrity("./test/example.zim").status, kiwix::Book::Integrity::UNKNOWN);
+  std::remove(path.c_str());
+}
+
+TEST(VerifierTest, destroyWithoutCallbacks)
+{
+  const std::string path = "./test/verifier_destroyed.zim";
+  writeFile(path, makeZimContent(4 * 1024 * 1024));
+  std::atomic<int> calls(0);
+  {
+    kiwix::Verifier verifier;
+    verifier.setMaxBytesPerSecond(1);
+    verifier.verify(path, [&](const kiwix::Verifier::Progress&) { calls++; });
+    // Queued behind the running check.
+    verifier.verify("./test/example.zim", [&](const kiwix::Verifier::Progress&) { calls++; });
+  }
+  EXPECT_EQ(calls, 0);
+  std::remove(path.c_str());
+}